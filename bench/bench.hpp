@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace bench {
+    // A single-node edit applied between frames; apply() toggles, so repeated
+    // calls keep dirtying the same node.
+    struct Mutation {
+        std::string name;
+        std::function<void()> apply;
+    };
+
+    // build() populates the tree on top of tree::TreeStack and returns the
+    // mutations that make sense for that shape.
+    struct Scenario {
+        std::string name;
+        std::vector<std::pair<std::string, size_t>> params;
+        bool usesText;
+        std::function<std::vector<Mutation>()> build;
+    };
+
+    struct GeneratorOptions {
+        double scale = 1.0;
+        std::string font;
+    };
+
+    std::vector<Scenario> makeScenarios(const GeneratorOptions& options);
+
+    std::vector<Mutation> deepNesting(size_t depth);
+    std::vector<Mutation> wideSiblings(size_t count);
+    std::vector<Mutation> textParagraphs(size_t paragraphs, size_t wordsPerParagraph, const std::string& font);
+    std::vector<Mutation> flexWrapGallery(size_t cards, const std::string& font);
+    std::vector<Mutation> gridItems(size_t items, size_t columns);
+    std::vector<Mutation> scrollList(size_t rows, const std::string& font);
+    std::vector<Mutation> ellipsisTable(size_t cells, size_t columns, const std::string& font);
+    std::vector<Mutation> labelScreen(size_t labels, const std::string& font);
+    std::vector<Mutation> bidiParagraph(size_t lines, const std::string& font);
+    std::vector<Mutation> balancedTree(size_t nodes, size_t fanout);
+    std::vector<Mutation> randomTree(size_t nodes, uint64_t seed, const std::string& font);
+}
@@ -0,0 +1,519 @@
+//
+//  bench_main.cpp
+//  gui_bench
+//
+//  Headless layout/update benchmark. Builds each synthetic tree against the null
+//  GPU backend and times RenderTree::update cold, warm (nothing dirty) and after
+//  single-node mutations, then writes per-phase numbers as JSON.
+//
+
+#include "bench.hpp"
+#include "context_manager.hpp"
+#include "fonts.hpp"
+#include "gpu_headless.hpp"
+#include "instrumentation.hpp"
+#include "parallel.hpp"
+#include "render_tree.hpp"
+#include "tree_manager.hpp"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <memory>
+#include <new>
+#include <numeric>
+#include <print>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+    // every allocation made by the process; frames sample it before and after
+    std::atomic<uint64_t> allocationCount{0};
+}
+
+void* operator new(std::size_t size) {
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    if (void* ptr = std::malloc(size ? size : 1)) return ptr;
+    throw std::bad_alloc{};
+}
+
+void* operator new[](std::size_t size) {
+    return ::operator new(size);
+}
+
+void operator delete(void* ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept {
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr, std::size_t) noexcept {
+    std::free(ptr);
+}
+
+namespace {
+    using instrumentation::Phase;
+    using layout::AxisResolution;
+    using tree::LayoutMode;
+    using tree::RenderSnapshot;
+    using tree::RenderTree;
+    using tree::TextWrapPath;
+    using tree::TreeNode;
+    using tree::TreeStack;
+
+    constexpr size_t PhaseCount = static_cast<size_t>(Phase::Count);
+    constexpr size_t MaxSettleFrames = 8;
+
+#ifdef __APPLE__
+    const std::string DefaultFont = Arial;
+#else
+    const std::string DefaultFont = "/usr/share/fonts/truetype/dejavu/DejaVuSans.ttf";
+#endif
+
+    struct Options {
+        std::string filter;
+        std::string output = "bench.json";
+        std::string font = DefaultFont;
+        bool quick = false;
+        size_t threads = 0; // 0 leaves the scheduler's default
+        LayoutMode layoutMode = LayoutMode::Serial;
+        size_t checkLayoutSeeds = 0; // > 0 runs the serial/parallel layout check instead
+        size_t checkLayoutNodes = 2000;
+        size_t coldRuns = 3;
+        size_t warmIterations = 100;
+        size_t mutationIterations = 20;
+    };
+
+    struct Samples {
+        std::vector<double> updateNs;
+        std::vector<double> allocations;
+        std::vector<double> draws;
+        std::vector<double> uploadBytes;
+        std::array<std::vector<double>, PhaseCount> phaseNs;
+        std::array<std::vector<double>, PhaseCount> recomputed;
+    };
+
+    struct Stats {
+        double median{};
+        double mean{};
+        double min{};
+        double p95{};
+    };
+
+    Stats summarize(std::vector<double> values) {
+        if (values.empty()) return {};
+        std::ranges::sort(values);
+        auto at = [&](double q) {
+            return values[std::min(values.size() - 1, static_cast<size_t>(q * static_cast<double>(values.size() - 1) + 0.5))];
+        };
+        return {
+            .median = at(0.5),
+            .mean = std::accumulate(values.begin(), values.end(), 0.0) / static_cast<double>(values.size()),
+            .min = values.front(),
+            .p95 = at(0.95),
+        };
+    }
+
+    double mean(const std::vector<double>& values) {
+        if (values.empty()) return 0.0;
+        return std::accumulate(values.begin(), values.end(), 0.0) / static_cast<double>(values.size());
+    }
+
+    size_t countNodes(const TreeNode* node) {
+        size_t count = 1;
+        for (auto& child : node->children) count += countNodes(child.get());
+        return count;
+    }
+
+    struct Harness {
+        runtime::UIContext& ctx;
+        // records instead of dropping so draw calls per frame show up in the report
+        gpu::RecordingRenderEncoder encoder;
+        RenderSnapshot snapshot;
+        LayoutMode layoutMode = LayoutMode::Serial;
+
+        std::unique_ptr<RenderTree> build(const bench::Scenario& scenario, std::vector<bench::Mutation>& mutations) {
+            auto tree = std::make_unique<RenderTree>();
+            tree->setLayoutMode(layoutMode);
+
+            elements::Div rootElem{ctx};
+            rootElem.getDescriptor().color = simd_float4{0, 0, 0, 0};
+            auto* root = tree->createRoot(ctx, std::move(rootElem), runtime::getDivProcessor(ctx));
+            root->shared.width = style::Size::percent(1.0);
+            root->shared.height = style::Size::percent(1.0);
+            tree->markDirty();
+
+            TreeStack::pushTree(tree.get());
+            mutations = scenario.build();
+            TreeStack::popTree();
+            return tree;
+        }
+
+        // One frame the way Renderer::draw drives it, minus the GPU submission.
+        void frame(RenderTree& tree, Samples* samples) {
+            uint64_t frameIndex = ctx.frameIndex;
+            ctx.frameArena.beginFrame(frameIndex);
+            std::chrono::nanoseconds elapsed{};
+            uint64_t allocations = 0;
+            {
+                instrumentation::FrameTimer frameTimer{frameIndex};
+                auto allocationsBefore = allocationCount.load(std::memory_order_relaxed);
+                auto start = std::chrono::steady_clock::now();
+                {
+                    instrumentation::PhaseTimer timer{Phase::Update};
+                    tree.update(ctx.frameInfo, frameIndex);
+                }
+                elapsed = std::chrono::steady_clock::now() - start;
+                {
+                    instrumentation::PhaseTimer timer{Phase::Render};
+                    encoder.reset();
+                    tree.buildSnapshot(snapshot);
+                    snapshot.encode(&encoder, ctx.frameArena);
+                }
+                allocations = allocationCount.load(std::memory_order_relaxed) - allocationsBefore;
+            }
+            ctx.frameIndex = frameIndex + 1;
+
+            if (!samples) return;
+            samples->updateNs.push_back(static_cast<double>(elapsed.count()));
+            samples->allocations.push_back(static_cast<double>(allocations));
+            samples->draws.push_back(static_cast<double>(encoder.drawCount));
+            if constexpr (instrumentation::enabled) {
+                auto& latest = instrumentation::getDiagnostics().latestFrame();
+                auto& phases = latest.phases;
+                samples->uploadBytes.push_back(static_cast<double>(latest.render.bufferBytes));
+                for (size_t i = 0; i < PhaseCount; ++i) {
+                    samples->phaseNs[i].push_back(static_cast<double>(phases[i].elapsed.count()));
+                    samples->recomputed[i].push_back(static_cast<double>(phases[i].recomputedNodes));
+                }
+            }
+        }
+
+        // run until the tree has nothing left to do so the next measured frame starts clean
+        void settle(RenderTree& tree) {
+            for (size_t i = 0; i < MaxSettleFrames && tree.requiresFrame(ctx.frameInfo); ++i) {
+                frame(tree, nullptr);
+            }
+        }
+    };
+
+    bool sameBits(float a, float b) {
+        return std::bit_cast<uint32_t>(a) == std::bit_cast<uint32_t>(b);
+    }
+
+    // nodes whose box or atom offsets differ in any bit; both trees come from the
+    // same generator, so they match node for node
+    size_t countLayoutDifferences(const TreeNode* a, const TreeNode* b) {
+        if (a->children.size() != b->children.size() || a->layout.has_value() != b->layout.has_value()) {
+            return countNodes(a);
+        }
+
+        size_t differing = 0;
+        if (a->layout.has_value()) {
+            auto& left = *a->layout;
+            auto& right = *b->layout;
+            bool same = sameBits(left.computedBox.x, right.computedBox.x) &&
+                sameBits(left.computedBox.y, right.computedBox.y) &&
+                sameBits(left.computedBox.width, right.computedBox.width) &&
+                sameBits(left.computedBox.height, right.computedBox.height) &&
+                sameBits(left.consumedHeight, right.consumedHeight) &&
+                left.atomOffsets.size() == right.atomOffsets.size();
+            for (size_t i = 0; same && i < left.atomOffsets.size(); ++i) {
+                same = sameBits(left.atomOffsets[i].x, right.atomOffsets[i].x) &&
+                    sameBits(left.atomOffsets[i].y, right.atomOffsets[i].y);
+            }
+            if (!same) ++differing;
+        }
+
+        for (size_t i = 0; i < a->children.size(); ++i) {
+            differing += countLayoutDifferences(a->children[i].get(), b->children[i].get());
+        }
+        return differing;
+    }
+
+    // Re-wraps every laid-out text node both ways (TextWrapPath) at its width and
+    // at narrower ones, and counts the nodes whose line boxes differ at any.
+    size_t countWrapDifferences(TreeNode* root) {
+        size_t differing = 0;
+        for (auto* node : tree::collectAllNodes(root)) {
+            if (!node->layout || !node->preLayout || !node->atomized || !tree::getText(node)) continue;
+
+            bool same = true;
+            for (float scale : {1.0f, 0.8f, 0.55f, 0.3f}) {
+                const float width = node->layout->computedBox.width * scale;
+                for (auto resolution : {AxisResolution::Final, AxisResolution::MinContent, AxisResolution::MaxContent}) {
+                    auto segments = tree::wrapText(node, width, resolution, TextWrapPath::Segments);
+                    auto clusters = tree::wrapText(node, width, resolution, TextWrapPath::Clusters);
+                    same = same && segments.sameBoxes(clusters);
+                }
+            }
+            if (!same) ++differing;
+        }
+        return differing;
+    }
+
+    // Builds each seeded random tree twice, lays one out serially and one in
+    // parallel, and compares them cold and after every mutation. Every text node
+    // is also re-wrapped both ways, as are the text_paragraphs and
+    // bidi_paragraph trees, where nearly every word is a break decision.
+    size_t checkLayout(Harness& harness, const Options& options, const std::string& font) {
+        size_t mismatches = 0;
+        size_t wrapMismatches = 0;
+        for (uint64_t seed = 1; seed <= options.checkLayoutSeeds; ++seed) {
+            bench::Scenario scenario{std::format("random_tree seed {}", seed), {}, !font.empty(),
+                [=, nodes = options.checkLayoutNodes] { return bench::randomTree(nodes, seed, font); }};
+
+            std::vector<bench::Mutation> serialMutations;
+            std::vector<bench::Mutation> parallelMutations;
+            harness.layoutMode = LayoutMode::Serial;
+            auto serial = harness.build(scenario, serialMutations);
+            harness.layoutMode = LayoutMode::Parallel;
+            auto parallel = harness.build(scenario, parallelMutations);
+
+            auto compare = [&](std::string_view when) {
+                harness.frame(*serial, nullptr);
+                harness.settle(*serial);
+                harness.frame(*parallel, nullptr);
+                harness.settle(*parallel);
+                size_t differing = countLayoutDifferences(serial->getRoot(), parallel->getRoot());
+                if (differing) {
+                    std::println(stderr, "seed {} {}: {} nodes differ", seed, when, differing);
+                }
+                mismatches += differing;
+
+                size_t wrapping = countWrapDifferences(serial->getRoot());
+                if (wrapping) {
+                    std::println(stderr, "seed {} {}: {} text nodes wrap differently by segments", seed, when, wrapping);
+                }
+                wrapMismatches += wrapping;
+            };
+
+            compare("cold");
+            for (size_t i = 0; i < serialMutations.size(); ++i) {
+                serialMutations[i].apply();
+                parallelMutations[i].apply();
+                compare(serialMutations[i].name);
+            }
+        }
+
+        if (!font.empty()) {
+            const size_t paragraphs = options.quick ? 20 : 200;
+            const size_t lines = options.quick ? 125 : 1250;
+            std::vector<bench::Scenario> wrapped {
+                {"text_paragraphs", {}, true, [=] { return bench::textParagraphs(paragraphs, 60, font); }},
+                {"bidi_paragraph", {}, true, [=] { return bench::bidiParagraph(lines, font); }},
+            };
+
+            harness.layoutMode = LayoutMode::Serial;
+            for (auto& scenario : wrapped) {
+                std::vector<bench::Mutation> mutations;
+                auto tree = harness.build(scenario, mutations);
+
+                auto compare = [&](std::string_view when) {
+                    harness.frame(*tree, nullptr);
+                    harness.settle(*tree);
+                    size_t wrapping = countWrapDifferences(tree->getRoot());
+                    if (wrapping) {
+                        std::println(stderr, "{} {}: {} text nodes wrap differently by segments", scenario.name, when, wrapping);
+                    }
+                    wrapMismatches += wrapping;
+                };
+
+                compare("cold");
+                for (auto& mutation : mutations) {
+                    mutation.apply();
+                    compare(mutation.name);
+                }
+            }
+        }
+
+        std::println("layout check: {} seeds of {} nodes, {} differing nodes, {} text nodes wrapping differently",
+                     options.checkLayoutSeeds, options.checkLayoutNodes, mismatches, wrapMismatches);
+        return mismatches + wrapMismatches;
+    }
+
+    std::string statsJson(const Stats& stats) {
+        return std::format(R"({{"median_ns": {:.0f}, "mean_ns": {:.0f}, "min_ns": {:.0f}, "p95_ns": {:.0f}}})",
+                           stats.median, stats.mean, stats.min, stats.p95);
+    }
+
+    std::string samplesJson(const Samples& samples, std::string_view indent) {
+        std::string out = std::format("{{\n{}  \"frames\": {},\n{}  \"allocations_per_frame\": {:.1f},\n{}  \"draws_per_frame\": {:.1f},\n{}  \"update\": {}",
+                                      indent, samples.updateNs.size(), indent, mean(samples.allocations),
+                                      indent, mean(samples.draws), indent, statsJson(summarize(samples.updateNs)));
+        if constexpr (instrumentation::enabled) {
+            out += std::format(",\n{}  \"upload_bytes_per_frame\": {:.0f}", indent, mean(samples.uploadBytes));
+            out += std::format(",\n{}  \"phases\": {{", indent);
+            for (size_t i = 0; i < PhaseCount; ++i) {
+                auto name = instrumentation::phaseName(static_cast<Phase>(i));
+                auto stats = summarize(samples.phaseNs[i]);
+                out += std::format("{}\n{}    \"{}\": {{\"time\": {}, \"mean_recomputed_nodes\": {:.1f}}}",
+                                   i ? "," : "", indent, name, statsJson(stats), mean(samples.recomputed[i]));
+            }
+            out += std::format("\n{}  }}", indent);
+        }
+        out += std::format("\n{}}}", indent);
+        return out;
+    }
+
+    void printSummary(std::string_view scenario, std::string_view mode, const Samples& samples) {
+        auto stats = summarize(samples.updateNs);
+        std::println("{:<20} {:<18} median {:>10.1f} us  p95 {:>10.1f} us  allocs/frame {:>8.1f}  draws/frame {:>8.1f}",
+                     scenario, mode, stats.median / 1000.0, stats.p95 / 1000.0, mean(samples.allocations), mean(samples.draws));
+    }
+
+    std::string runScenario(Harness& harness, const bench::Scenario& scenario, const Options& options) {
+        Samples cold;
+        size_t nodes = 0;
+        for (size_t run = 0; run < options.coldRuns; ++run) {
+            std::vector<bench::Mutation> mutations;
+            auto tree = harness.build(scenario, mutations);
+            nodes = countNodes(tree->getRoot());
+            harness.frame(*tree, &cold);
+        }
+        printSummary(scenario.name, "cold", cold);
+
+        std::vector<bench::Mutation> mutations;
+        auto tree = harness.build(scenario, mutations);
+        harness.frame(*tree, nullptr);
+        harness.settle(*tree);
+
+        Samples warm;
+        for (size_t i = 0; i < options.warmIterations; ++i) {
+            harness.frame(*tree, &warm);
+        }
+        printSummary(scenario.name, "warm", warm);
+
+        std::vector<std::pair<std::string, Samples>> mutated;
+        for (auto& mutation : mutations) {
+            Samples samples;
+            for (size_t i = 0; i < options.mutationIterations; ++i) {
+                mutation.apply();
+                harness.frame(*tree, &samples);
+                harness.settle(*tree);
+            }
+            printSummary(scenario.name, "mutate:" + mutation.name, samples);
+            mutated.emplace_back(mutation.name, std::move(samples));
+        }
+
+        std::string params;
+        for (size_t i = 0; i < scenario.params.size(); ++i) {
+            params += std::format("{}\"{}\": {}", i ? ", " : "", scenario.params[i].first, scenario.params[i].second);
+        }
+
+        std::string out = std::format("    {{\n      \"name\": \"{}\",\n      \"params\": {{{}}},\n      \"nodes\": {},\n",
+                                      scenario.name, params, nodes);
+        out += std::format("      \"cold\": {},\n", samplesJson(cold, "      "));
+        out += std::format("      \"warm\": {},\n", samplesJson(warm, "      "));
+        out += "      \"mutations\": [";
+        for (size_t i = 0; i < mutated.size(); ++i) {
+            out += std::format("{}\n        {{\"name\": \"{}\", \"result\": {}}}",
+                               i ? "," : "", mutated[i].first, samplesJson(mutated[i].second, "        "));
+        }
+        out += "\n      ]\n    }";
+        return out;
+    }
+
+    bool parseArgs(int argc, const char* argv[], Options& options) {
+        for (int i = 1; i < argc; ++i) {
+            std::string_view arg = argv[i];
+            auto value = [&]() -> const char* {
+                return i + 1 < argc ? argv[++i] : nullptr;
+            };
+
+            if (arg == "--quick") {
+                options.quick = true;
+            } else if (arg == "--parallel-layout") {
+                options.layoutMode = LayoutMode::Parallel;
+            } else if (arg == "--filter" || arg == "--output" || arg == "--font" || arg == "--threads" ||
+                       arg == "--check-layout") {
+                auto* v = value();
+                if (!v) {
+                    std::println(stderr, "{} expects a value", arg);
+                    return false;
+                }
+                if (arg == "--filter") options.filter = v;
+                else if (arg == "--output") options.output = v;
+                else if (arg == "--font") options.font = v;
+                else if (arg == "--threads") options.threads = std::max<size_t>(1, std::stoul(v));
+                else options.checkLayoutSeeds = std::max<size_t>(1, std::stoul(v));
+            } else {
+                std::println(stderr, "usage: gui_bench [--filter substr] [--output path] [--font path] [--threads n] "
+                                     "[--parallel-layout] [--check-layout seeds] [--quick]");
+                return false;
+            }
+        }
+
+        if (options.quick) {
+            options.coldRuns = 1;
+            options.warmIterations = 10;
+            options.mutationIterations = 3;
+            options.checkLayoutNodes = 500;
+        }
+        return true;
+    }
+}
+
+int main(int argc, const char* argv[]) {
+    Options options;
+    if (!parseArgs(argc, argv, options)) return 1;
+
+    // before anything can start the shared pool
+    if (options.threads) {
+        Parallel::Scheduler::configure({.workers = options.threads - 1});
+    }
+
+    gpu::HeadlessDevice device;
+    auto& ctx = runtime::ContextManager::initContext(device, FrameInfo{1280, 800, 2});
+    Harness harness{ctx};
+
+    bool haveFont = std::filesystem::exists(options.font);
+    if (!haveFont) {
+        std::println(stderr, "font {} not found; skipping text scenarios", options.font);
+    }
+
+    if (options.checkLayoutSeeds) {
+        return checkLayout(harness, options, haveFont ? options.font : std::string{}) ? 1 : 0;
+    }
+    harness.layoutMode = options.layoutMode;
+
+    auto scenarios = bench::makeScenarios({.scale = options.quick ? 0.1 : 1.0, .font = options.font});
+
+    std::vector<std::string> results;
+    for (auto& scenario : scenarios) {
+        if (!options.filter.empty() && scenario.name.find(options.filter) == std::string::npos) continue;
+        if (scenario.usesText && !haveFont) {
+            results.push_back(std::format("    {{\"name\": \"{}\", \"skipped\": \"font not found\"}}", scenario.name));
+            continue;
+        }
+        results.push_back(runScenario(harness, scenario, options));
+    }
+
+    std::ofstream out{options.output};
+    if (!out) {
+        std::println(stderr, "could not open {}", options.output);
+        return 1;
+    }
+    out << std::format("{{\n  \"instrumentation\": {},\n  \"quick\": {},\n  \"threads\": {},\n  \"parallel_layout\": {},\n  \"scenarios\": [\n",
+                       instrumentation::enabled, options.quick, Parallel::Scheduler::shared().concurrency(),
+                       options.layoutMode == LayoutMode::Parallel);
+    for (size_t i = 0; i < results.size(); ++i) {
+        out << results[i] << (i + 1 < results.size() ? ",\n" : "\n");
+    }
+    out << "  ]\n}\n";
+
+    std::println("wrote {}", options.output);
+    return 0;
+}
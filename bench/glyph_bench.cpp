@@ -0,0 +1,223 @@
+//
+//  glyph_bench.cpp
+//  gui_bench
+//
+//  Glyph coverage on the CPU, once through every curve and once through the
+//  curve bands fragment_text uses. Each glyph is sampled at every pixel centre
+//  for a few font sizes; the two paths must agree on every sample (the run
+//  fails otherwise), and the time and curves looked at per sample go to JSON.
+//
+
+#include "fonts.hpp"
+#include "freetype.hpp"
+#include "glyph_coverage.hpp"
+#include "glyphs.hpp"
+#include "utf8.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <limits>
+#include <print>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+#ifdef __APPLE__
+    const std::string DefaultFont = Arial;
+#else
+    const std::string DefaultFont = "/usr/share/fonts/truetype/dejavu/DejaVuSans.ttf";
+#endif
+
+    struct Options {
+        std::string output = "glyph_bench.json";
+        std::string font = DefaultFont;
+        std::string text = "The quick brown fox jumps over the lazy dog 0123456789 @&%$#?!";
+        std::vector<float> sizes{12.0f, 24.0f, 48.0f, 96.0f, 192.0f};
+        size_t rounds = 3;
+    };
+
+    std::vector<Glyph> loadGlyphs(const Options& options) {
+        std::vector<Glyph> glyphs;
+        FT_Library library;
+        FT_Init_FreeType(&library);
+        FT_Face face = nullptr;
+        if (FT_New_Face(library, options.font.c_str(), 0, &face) == 0) {
+            FT_Set_Pixel_Sizes(face, 0, BASE_PIXEL_HEIGHT);
+
+            std::vector<FT_UInt> seen;
+            for (const auto& codepoint : utf8::codePoints(options.text)) {
+                FT_UInt index = FT_Get_Char_Index(face, codepoint.value);
+                if (!index || std::ranges::find(seen, index) != seen.end()) continue;
+                seen.push_back(index);
+
+                FT_Load_Glyph(face, index, FT_LOAD_DEFAULT);
+                if (face->glyph->format == FT_GLYPH_FORMAT_OUTLINE &&
+                    face->glyph->outline.n_contours > 0) {
+                    glyphs.push_back(processContours(face));
+                }
+            }
+            FT_Done_Face(face);
+        }
+        FT_Done_FreeType(library);
+        return glyphs;
+    }
+
+    // pixel centres covering each glyph's outline at one font size
+    std::vector<std::pair<const Glyph*, simd_float2>> makeSamples(const std::vector<Glyph>& glyphs, float pixelSize) {
+        std::vector<std::pair<const Glyph*, simd_float2>> samples;
+        for (const auto& glyph : glyphs) {
+            simd_float2 min{std::numeric_limits<float>::max(), std::numeric_limits<float>::max()};
+            simd_float2 max{std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest()};
+            for (auto point : glyph.points) {
+                min.x = std::min(min.x, point.x);
+                min.y = std::min(min.y, point.y);
+                max.x = std::max(max.x, point.x);
+                max.y = std::max(max.y, point.y);
+            }
+            // one pixel of border, where coverage fades out
+            for (float y = min.y - pixelSize * 0.5f; y <= max.y + pixelSize; y += pixelSize) {
+                for (float x = min.x - pixelSize * 0.5f; x <= max.x + pixelSize; x += pixelSize) {
+                    samples.push_back({&glyph, simd_float2{x, y}});
+                }
+            }
+        }
+        return samples;
+    }
+
+    struct Timing {
+        double seconds{};
+        uint64_t curves{};
+        double checksum{};
+    };
+
+    template <typename Coverage>
+    Timing timeCoverage(const std::vector<std::pair<const Glyph*, simd_float2>>& samples, float pixelSize,
+                        size_t rounds, Coverage coverage) {
+        Timing best;
+        for (size_t round = 0; round < rounds; ++round) {
+            Timing timing;
+            auto start = std::chrono::steady_clock::now();
+            for (const auto& [glyph, point] : samples) {
+                timing.checksum += coverage(*glyph, point, pixelSize, &timing.curves);
+            }
+            timing.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            if (round == 0 || timing.seconds < best.seconds) best = timing;
+        }
+        return best;
+    }
+
+    bool parseArgs(int argc, const char* argv[], Options& options) {
+        for (int i = 1; i < argc; ++i) {
+            std::string_view arg = argv[i];
+            auto value = [&]() -> const char* {
+                return i + 1 < argc ? argv[++i] : nullptr;
+            };
+
+            if (arg == "--quick") {
+                options.sizes = {16.0f, 96.0f};
+                options.rounds = 1;
+            } else if (arg == "--output" || arg == "--font" || arg == "--text") {
+                auto* v = value();
+                if (!v) {
+                    std::println(stderr, "{} expects a value", arg);
+                    return false;
+                }
+                if (arg == "--output") options.output = v;
+                else if (arg == "--font") options.font = v;
+                else options.text = v;
+            } else {
+                std::println(stderr, "usage: gui_glyph_bench [--output path] [--font path] [--text glyphs] [--quick]");
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+int main(int argc, const char* argv[]) {
+    Options options;
+    if (!parseArgs(argc, argv, options)) return 1;
+
+    if (!std::filesystem::exists(options.font)) {
+        std::println(stderr, "font {} not found", options.font);
+        return 1;
+    }
+
+    auto glyphs = loadGlyphs(options);
+    if (glyphs.empty()) {
+        std::println(stderr, "no outline glyphs for the given text in {}", options.font);
+        return 1;
+    }
+
+    size_t curveCount = 0;
+    size_t bandedCurveCount = 0;
+    auto buildStart = std::chrono::steady_clock::now();
+    for (size_t round = 0; round < options.rounds; ++round) {
+        for (auto& glyph : glyphs) {
+            glyph.bands = buildGlyphBands(glyph);
+        }
+    }
+    double buildSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - buildStart).count();
+    double buildNs = buildSeconds * 1e9 / static_cast<double>(glyphs.size() * options.rounds);
+    for (const auto& glyph : glyphs) {
+        curveCount += glyph.points.size() / (glyph.curveType == CurveType::Cubic ? 4 : 3);
+        bandedCurveCount += glyph.bands.curves.size();
+    }
+    std::println("{} glyphs, {} curves, {} band entries, build {:.0f} ns/glyph",
+                 glyphs.size(), curveCount, bandedCurveCount, buildNs);
+
+    std::string results;
+    size_t mismatches = 0;
+    for (size_t i = 0; i < options.sizes.size(); ++i) {
+        float size = options.sizes[i];
+        float pixelSize = BASE_PIXEL_HEIGHT * FT_PIXEL_CF / size;
+        auto samples = makeSamples(glyphs, pixelSize);
+
+        size_t sizeMismatches = 0;
+        for (const auto& [glyph, point] : samples) {
+            float expected = glyphCoverage(*glyph, point, pixelSize);
+            float banded = bandedGlyphCoverage(*glyph, point, pixelSize);
+            if (std::fabs(expected - banded) > 1e-6f) {
+                if (sizeMismatches == 0) {
+                    std::println(stderr, "mismatch at {}px ({}, {}): all curves {} vs bands {}",
+                                 size, point.x, point.y, expected, banded);
+                }
+                ++sizeMismatches;
+            }
+        }
+        mismatches += sizeMismatches;
+
+        auto full = timeCoverage(samples, pixelSize, options.rounds, glyphCoverage);
+        auto banded = timeCoverage(samples, pixelSize, options.rounds, bandedGlyphCoverage);
+        double count = static_cast<double>(samples.size());
+        double fullNs = full.seconds * 1e9 / count;
+        double bandedNs = banded.seconds * 1e9 / count;
+        double fullCurves = static_cast<double>(full.curves) / count;
+        double bandedCurves = static_cast<double>(banded.curves) / count;
+
+        std::println("{:>6.0f}px  {:>8} samples  all {:>7.1f} ns {:>6.1f} curves  bands {:>7.1f} ns {:>6.1f} curves  {:>5.2f}x  mismatches {}",
+                     size, samples.size(), fullNs, fullCurves, bandedNs, bandedCurves, fullNs / bandedNs, sizeMismatches);
+        results += std::format("{}\n    {{\"pixels\": {:.0f}, \"samples\": {}, \"all_ns\": {:.1f}, \"all_curves\": {:.2f}, \"banded_ns\": {:.1f}, \"banded_curves\": {:.2f}, \"speedup\": {:.3f}, \"mismatches\": {}}}",
+                               i ? "," : "", size, samples.size(), fullNs, fullCurves, bandedNs, bandedCurves,
+                               fullNs / bandedNs, sizeMismatches);
+    }
+
+    std::ofstream out{options.output};
+    if (!out) {
+        std::println(stderr, "could not open {}", options.output);
+        return 1;
+    }
+    out << std::format("{{\n  \"glyphs\": {},\n  \"curves\": {},\n  \"band_entries\": {},\n  \"build_ns_per_glyph\": {:.0f},\n  \"sizes\": [{}\n  ]\n}}\n",
+                       glyphs.size(), curveCount, bandedCurveCount, buildNs, results);
+    std::println("wrote {}", options.output);
+
+    if (mismatches) {
+        std::println(stderr, "{} samples differ between the full loop and the bands", mismatches);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,184 @@
+//
+//  scheduler_bench.cpp
+//  gui_bench
+//
+//  Parallel::Scheduler overhead and scaling. Overhead: ns per task for a
+//  fork-join tree of empty tasks, and ns per index for for_index over a loop
+//  body that does almost nothing, next to the plain loop. Scaling: a CPU-bound
+//  for_index and parallel_reduce on pools of 1, 2, 4, ... threads, reported as
+//  speedup over one thread. Runs anywhere the scheduler does; nothing here
+//  needs a GPU or fonts.
+//
+
+#include "parallel.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <format>
+#include <fstream>
+#include <print>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace {
+    struct Options {
+        std::string output = "scheduler_bench.json";
+        size_t maxThreads = std::max(1u, std::thread::hardware_concurrency());
+        size_t items = 1 << 16;
+        size_t work = 2000; // iterations of the loop body per item
+        size_t forkDepth = 16;
+        size_t rounds = 5;
+        bool pin = false;
+    };
+
+    // enough arithmetic per item that scaling isn't a memory bandwidth test
+    double itemWork(size_t item, size_t iterations) {
+        double x = static_cast<double>(item % 97) * 0.001 + 1.0;
+        for (size_t i = 0; i < iterations; ++i) {
+            x = std::sqrt(x * 1.0000001 + 0.5);
+        }
+        return x;
+    }
+
+    size_t forkJoin(Parallel::Scheduler& scheduler, size_t depth) {
+        if (depth == 0) return 1;
+        size_t left = 0;
+        size_t right = 0;
+        Parallel::TaskGroup group{scheduler};
+        group.spawn([&] { left = forkJoin(scheduler, depth - 1); });
+        right = forkJoin(scheduler, depth - 1);
+        group.sync();
+        return left + right;
+    }
+
+    template <typename Body>
+    double bestSeconds(size_t rounds, Body&& body) {
+        double best = 0.0;
+        for (size_t round = 0; round < rounds; ++round) {
+            auto start = std::chrono::steady_clock::now();
+            body();
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            if (round == 0 || seconds < best) best = seconds;
+        }
+        return best;
+    }
+
+    Parallel::SchedulerOptions poolOptions(size_t threads, const Options& options) {
+        Parallel::SchedulerOptions pool{.workers = threads - 1};
+        if (options.pin) {
+            for (size_t cpu = 0; cpu < options.maxThreads; ++cpu) {
+                pool.cpus.push_back(static_cast<int>(cpu));
+            }
+        }
+        return pool;
+    }
+
+    bool parseArgs(int argc, const char* argv[], Options& options) {
+        for (int i = 1; i < argc; ++i) {
+            std::string_view arg = argv[i];
+            auto value = [&]() -> const char* {
+                return i + 1 < argc ? argv[++i] : nullptr;
+            };
+
+            if (arg == "--quick") {
+                options.items = 1 << 13;
+                options.forkDepth = 12;
+                options.rounds = 2;
+            } else if (arg == "--pin") {
+                options.pin = true;
+            } else if (arg == "--output" || arg == "--threads") {
+                auto* v = value();
+                if (!v) {
+                    std::println(stderr, "{} expects a value", arg);
+                    return false;
+                }
+                if (arg == "--output") options.output = v;
+                else options.maxThreads = std::max<size_t>(1, std::stoul(v));
+            } else {
+                std::println(stderr, "usage: gui_scheduler_bench [--output path] [--threads max] [--pin] [--quick]");
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+int main(int argc, const char* argv[]) {
+    Options options;
+    if (!parseArgs(argc, argv, options)) return 1;
+
+    std::vector<double> values(options.items);
+
+    // overhead, on a pool of every thread
+    Parallel::Scheduler full{poolOptions(options.maxThreads, options)};
+    size_t leaves = 0;
+    double forkSeconds = bestSeconds(options.rounds, [&] { leaves = forkJoin(full, options.forkDepth); });
+    double nsPerTask = forkSeconds * 1e9 / static_cast<double>(leaves - 1);
+
+    double serialLoop = bestSeconds(options.rounds, [&] {
+        for (size_t i = 0; i < values.size(); ++i) values[i] = static_cast<double>(i) * 0.5;
+    });
+    double parallelLoop = bestSeconds(options.rounds, [&] {
+        Parallel::for_index(full, values.size(), [&](size_t i) { values[i] = static_cast<double>(i) * 0.5; });
+    });
+    double serialNs = serialLoop * 1e9 / static_cast<double>(values.size());
+    double parallelNs = parallelLoop * 1e9 / static_cast<double>(values.size());
+
+    std::println("fork-join {} tasks  {:>8.1f} ns/task", leaves - 1, nsPerTask);
+    std::println("trivial loop  serial {:>6.2f} ns/item  for_index {:>6.2f} ns/item", serialNs, parallelNs);
+
+    std::vector<size_t> threadCounts;
+    for (size_t threads = 1; threads < options.maxThreads; threads *= 2) threadCounts.push_back(threads);
+    threadCounts.push_back(options.maxThreads);
+
+    std::string results;
+    double forBaseline = 0.0;
+    double reduceBaseline = 0.0;
+    double expectedSum = 0.0;
+    for (size_t i = 0; i < threadCounts.size(); ++i) {
+        size_t threads = threadCounts[i];
+        Parallel::Scheduler pool{poolOptions(threads, options)};
+
+        double forSeconds = bestSeconds(options.rounds, [&] {
+            Parallel::for_index(pool, values.size(), [&](size_t item) {
+                values[item] = itemWork(item, options.work);
+            });
+        });
+
+        double sum = 0.0;
+        double reduceSeconds = bestSeconds(options.rounds, [&] {
+            sum = Parallel::parallel_reduce(pool, values.begin(), values.end(), 0.0,
+                [&](double value) { return itemWork(static_cast<size_t>(value * 1e6), options.work); },
+                [](double a, double b) { return a + b; });
+        });
+        // fixed chunking makes the sum bit-identical on every pool
+        if (i == 0) expectedSum = sum;
+        bool deterministic = sum == expectedSum;
+
+        if (i == 0) {
+            forBaseline = forSeconds;
+            reduceBaseline = reduceSeconds;
+        }
+        double forSpeedup = forBaseline / forSeconds;
+        double reduceSpeedup = reduceBaseline / reduceSeconds;
+
+        std::println("threads {:>3}  for_index {:>8.3f} ms {:>5.2f}x  parallel_reduce {:>8.3f} ms {:>5.2f}x{}",
+                     threads, forSeconds * 1e3, forSpeedup, reduceSeconds * 1e3, reduceSpeedup,
+                     deterministic ? "" : "  (sum differs)");
+        results += std::format("{}\n    {{\"threads\": {}, \"for_index_seconds\": {:.6f}, \"for_index_speedup\": {:.3f}, \"reduce_seconds\": {:.6f}, \"reduce_speedup\": {:.3f}, \"reduce_deterministic\": {}}}",
+                               i ? "," : "", threads, forSeconds, forSpeedup, reduceSeconds, reduceSpeedup, deterministic);
+    }
+
+    std::ofstream out{options.output};
+    if (!out) {
+        std::println(stderr, "could not open {}", options.output);
+        return 1;
+    }
+    out << std::format("{{\n  \"items\": {},\n  \"work\": {},\n  \"pinned\": {},\n  \"fork_join_tasks\": {},\n  \"ns_per_task\": {:.1f},\n  \"trivial_serial_ns_per_item\": {:.2f},\n  \"trivial_for_index_ns_per_item\": {:.2f},\n  \"threads\": [{}\n  ]\n}}\n",
+                       options.items, options.work, options.pin, leaves - 1, nsPerTask, serialNs, parallelNs, results);
+
+    std::println("wrote {}", options.output);
+    return 0;
+}
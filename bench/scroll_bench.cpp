@@ -0,0 +1,328 @@
+//
+//  scroll_bench.cpp
+//  gui_bench
+//
+//  Scroll ticks on a long list. Builds the scroll_list tree (50k rows by
+//  default) and hands it to a tree::LayoutThread, as the app does, then posts
+//  a scroll of a row at a time the way a wheel event does
+//  (RenderTree::markScrolled). Each tick times the post until its snapshot is
+//  published and the encode of that snapshot, next to the same ticks driven
+//  through the old path that dirtied the container's subtree for
+//  postLayout/place/finalize. Every compositor tick should lay out nothing and
+//  publish a snapshot that only had its layers rewritten; every tick also
+//  hit tests the top of the viewport and fails the run unless the row that
+//  scrolled under it comes back, and probes just below the viewport, where
+//  rows not yet scrolled in must not be hit. Runs headless; the rows need a
+//  font.
+//
+
+#include "bench.hpp"
+#include "context_manager.hpp"
+#include "fonts.hpp"
+#include "gpu_headless.hpp"
+#include "instrumentation.hpp"
+#include "layout_thread.hpp"
+#include "render_snapshot.hpp"
+#include "render_tree.hpp"
+#include "tree_manager.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <memory>
+#include <numeric>
+#include <print>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+    using tree::DirtyBits;
+    using tree::LayoutThread;
+    using tree::RenderSnapshot;
+    using tree::RenderTree;
+    using tree::TreeNode;
+    using tree::TreeStack;
+
+    constexpr float RowHeight = 28.0f; // bench::scrollList's rows
+    constexpr size_t MaxSettleFrames = 8;
+
+#ifdef __APPLE__
+    const std::string DefaultFont = Arial;
+#else
+    const std::string DefaultFont = "/usr/share/fonts/truetype/dejavu/DejaVuSans.ttf";
+#endif
+
+    struct Options {
+        std::string output = "scroll_bench.json";
+        std::string font = DefaultFont;
+        size_t rows = 50000;
+        size_t ticks = 600;
+        size_t rowsPerTick = 1;
+    };
+
+    struct Samples {
+        std::vector<double> tickNs; // post to published, on the layout thread
+        std::vector<double> encodeNs;
+        std::vector<double> recomputed;
+        size_t rebuiltSnapshots = 0;
+        size_t hitMisses = 0;
+        size_t clipLeaks = 0; // probes outside the viewport that hit a row
+    };
+
+    double percentile(std::vector<double> values, double q) {
+        if (values.empty()) return 0.0;
+        std::ranges::sort(values);
+        return values[std::min(values.size() - 1, static_cast<size_t>(q * static_cast<double>(values.size() - 1) + 0.5))];
+    }
+
+    double mean(const std::vector<double>& values) {
+        if (values.empty()) return 0.0;
+        return std::accumulate(values.begin(), values.end(), 0.0) / static_cast<double>(values.size());
+    }
+
+    TreeNode* findScroller(TreeNode* node) {
+        if (node->shared.overflow == style::Overflow::Scroll) return node;
+        for (auto& child : node->children) {
+            if (auto* found = findScroller(child.get())) return found;
+        }
+        return nullptr;
+    }
+
+    bool inSubtree(const TreeNode* node, uint64_t id) {
+        if (node->id == id) return true;
+        return std::ranges::any_of(node->children, [&](auto& child) { return inSubtree(child.get(), id); });
+    }
+
+    // The presenter's side of a tree::LayoutThread: every tree read and write
+    // is posted to it, and each tick encodes whatever it published.
+    struct Harness {
+        runtime::UIContext& ctx;
+        LayoutThread& producer;
+        gpu::RecordingRenderEncoder encoder;
+
+        // runs f on the layout thread and waits for it and the frame it needs
+        void run(LayoutThread::Mutation f) {
+            producer.post(std::move(f));
+            producer.flush();
+        }
+
+        void settle() {
+            for (size_t i = 0; i < MaxSettleFrames; ++i) {
+                bool pending = false;
+                run([&](RenderTree& tree) { pending = tree.requiresFrame(ctx.frameInfo); });
+                if (!pending) return;
+            }
+        }
+
+        std::shared_ptr<const RenderSnapshot> present() {
+            auto snapshot = producer.latest();
+            uint64_t frameIndex = ctx.frameIndex;
+            ctx.frameArena.beginFrame(frameIndex);
+            encoder.reset();
+            snapshot->encode(&encoder, ctx.frameArena);
+            ctx.frameIndex = frameIndex + 1;
+            return snapshot;
+        }
+    };
+
+    // Scrolls scroller down rowsPerTick rows per tick, wrapping at the end,
+    // and checks that the row now at the top of the viewport is what both the
+    // tree and the published snapshot hit.
+    Samples scroll(Harness& harness, TreeNode* scroller, const Options& options, bool relayout) {
+        float maxScroll = 0.0f;
+        simd_float2 probe;
+        simd_float2 outside;
+        harness.run([&](RenderTree& tree) {
+            scroller->scrollOffset = {0.0f, 0.0f};
+            tree.markDirty(scroller, DirtyBits::PostLayout | DirtyBits::Place | DirtyBits::Finalize);
+        });
+        harness.settle();
+        harness.run([&](RenderTree&) {
+            maxScroll = std::max(0.0f, scroller->scrollContentSize.y - scroller->scrollViewportSize.y);
+            auto& box = scroller->layout->computedBox;
+            probe = {box.x + box.width * 0.5f, box.y + RowHeight * 0.5f};
+            outside = {probe.x, box.y + box.height + RowHeight * 0.5f};
+        });
+        float step = RowHeight * static_cast<float>(options.rowsPerTick);
+
+        Samples samples;
+        for (size_t tick = 0; tick < options.ticks; ++tick) {
+            uint64_t generation = harness.producer.latest()->contentGeneration;
+            auto start = Clock::now();
+            harness.run([&](RenderTree& tree) {
+                float next = scroller->scrollOffset.y + step;
+                scroller->scrollOffset.y = next > maxScroll ? 0.0f : next;
+                if (relayout) {
+                    tree.markDirty(scroller, DirtyBits::PostLayout | DirtyBits::Place | DirtyBits::Finalize);
+                } else {
+                    tree.markScrolled(scroller);
+                }
+            });
+            auto published = Clock::now();
+            // flush() ordered the layout thread's frame before this read
+            bool rebuilt = false;
+            if constexpr (instrumentation::enabled) {
+                auto& frame = instrumentation::getDiagnostics().latestFrame();
+                uint64_t recomputed = 0;
+                for (auto& phase : frame.phases) {
+                    recomputed += phase.recomputedNodes;
+                }
+                samples.recomputed.push_back(static_cast<double>(recomputed));
+                rebuilt = frame.render.nodesEncoded != 0;
+            }
+            auto snapshot = harness.present();
+            auto encoded = Clock::now();
+
+            samples.tickNs.push_back(static_cast<double>((published - start).count()));
+            samples.encodeNs.push_back(static_cast<double>((encoded - published).count()));
+            if (rebuilt || snapshot->contentGeneration != generation) ++samples.rebuiltSnapshots;
+
+            harness.run([&](RenderTree& tree) {
+                auto row = static_cast<size_t>(std::floor(scroller->scrollOffset.y / RowHeight));
+                if (row >= scroller->children.size()) return;
+                auto* expected = scroller->children[row].get();
+                auto hits = tree.hitTestAll(probe);
+                bool treeHit = std::ranges::any_of(hits, [&](TreeNode* hit) { return hit == expected; });
+                auto snapshotHit = snapshot->hitTest(probe);
+                if (!treeHit || !snapshotHit || !inSubtree(expected, *snapshotHit)) {
+                    ++samples.hitMisses;
+                }
+
+                auto outsideHits = tree.hitTestAll(outside);
+                bool treeLeak = std::ranges::any_of(outsideHits, [&](TreeNode* hit) {
+                    return hit != scroller && inSubtree(scroller, hit->id);
+                });
+                auto outsideSnapshotHit = snapshot->hitTest(outside);
+                bool snapshotLeak = outsideSnapshotHit && *outsideSnapshotHit != scroller->id &&
+                    inSubtree(scroller, *outsideSnapshotHit);
+                if (treeLeak || snapshotLeak) {
+                    ++samples.clipLeaks;
+                }
+            });
+        }
+        return samples;
+    }
+
+    std::string samplesJson(const Samples& samples) {
+        return std::format("{{\"tick_mean_us\": {:.3f}, \"tick_p99_us\": {:.3f}, "
+                           "\"encode_mean_us\": {:.3f}, \"encode_p99_us\": {:.3f}, "
+                           "\"mean_recomputed_nodes\": {:.1f}, \"rebuilt_snapshots\": {}, \"hit_misses\": {}, "
+                           "\"clip_leaks\": {}}}",
+                           mean(samples.tickNs) / 1e3, percentile(samples.tickNs, 0.99) / 1e3,
+                           mean(samples.encodeNs) / 1e3, percentile(samples.encodeNs, 0.99) / 1e3, mean(samples.recomputed),
+                           samples.rebuiltSnapshots, samples.hitMisses, samples.clipLeaks);
+    }
+
+    void printSummary(std::string_view mode, const Samples& samples) {
+        std::println("{:<12} tick mean {:>9.2f} us  p99 {:>9.2f} us  encode mean {:>8.2f} us"
+                     "  {} snapshots rebuilt{}{}{}",
+                     mode, mean(samples.tickNs) / 1e3, percentile(samples.tickNs, 0.99) / 1e3,
+                     mean(samples.encodeNs) / 1e3, samples.rebuiltSnapshots,
+                     samples.recomputed.empty() ? "" : std::format("  {:.1f} nodes recomputed/tick", mean(samples.recomputed)),
+                     samples.hitMisses ? std::format("  ({} hit tests missed the row)", samples.hitMisses) : "",
+                     samples.clipLeaks ? std::format("  ({} probes below the viewport hit a row)", samples.clipLeaks) : "");
+    }
+
+    bool parseArgs(int argc, const char* argv[], Options& options) {
+        for (int i = 1; i < argc; ++i) {
+            std::string_view arg = argv[i];
+            auto value = [&]() -> const char* {
+                return i + 1 < argc ? argv[++i] : nullptr;
+            };
+
+            if (arg == "--quick") {
+                options.rows = 5000;
+                options.ticks = 120;
+            } else if (arg == "--output" || arg == "--font" || arg == "--rows" || arg == "--ticks" ||
+                       arg == "--rows-per-tick") {
+                auto* v = value();
+                if (!v) {
+                    std::println(stderr, "{} expects a value", arg);
+                    return false;
+                }
+                if (arg == "--output") options.output = v;
+                else if (arg == "--font") options.font = v;
+                else if (arg == "--rows") options.rows = std::max<size_t>(1, std::stoul(v));
+                else if (arg == "--ticks") options.ticks = std::stoul(v);
+                else options.rowsPerTick = std::max<size_t>(1, std::stoul(v));
+            } else {
+                std::println(stderr, "usage: gui_scroll_bench [--rows n] [--ticks n] [--rows-per-tick n] "
+                                     "[--font path] [--output path] [--quick]");
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+int main(int argc, const char* argv[]) {
+    Options options;
+    if (!parseArgs(argc, argv, options)) return 1;
+    if (!std::filesystem::exists(options.font)) {
+        std::println(stderr, "font {} not found; the rows need one", options.font);
+        return 1;
+    }
+
+    gpu::HeadlessDevice device;
+    auto& ctx = runtime::ContextManager::initContext(device, FrameInfo{1280, 800, 2});
+
+    auto tree = std::make_unique<RenderTree>();
+    elements::Div rootElem{ctx};
+    rootElem.getDescriptor().color = simd_float4{0, 0, 0, 0};
+    auto* root = tree->createRoot(ctx, std::move(rootElem), runtime::getDivProcessor(ctx));
+    root->shared.width = style::Size::percent(1.0);
+    root->shared.height = style::Size::percent(1.0);
+    tree->markDirty();
+
+    TreeStack::pushTree(tree.get());
+    bench::scrollList(options.rows, options.font);
+    TreeStack::popTree();
+
+    // from here on the tree belongs to the layout thread, which lays it out
+    // and publishes the first snapshot as soon as it starts
+    auto coldStart = Clock::now();
+    LayoutThread producer{*tree, ctx.frameInfo};
+    Harness harness{ctx, producer};
+    harness.run([](RenderTree&) {});
+    double coldMs = std::chrono::duration<double, std::milli>(Clock::now() - coldStart).count();
+    harness.settle();
+
+    TreeNode* scroller = nullptr;
+    harness.run([&](RenderTree&) {
+        scroller = findScroller(root);
+        if (scroller && !scroller->layout.has_value()) scroller = nullptr;
+    });
+
+    if (!scroller) {
+        std::println(stderr, "scroll_list built no scroll container");
+        return 1;
+    }
+
+    auto compositor = scroll(harness, scroller, options, false);
+    auto relayout = scroll(harness, scroller, options, true);
+    size_t draws = producer.latest()->draws.size();
+
+    std::println("scroll_list: {} rows, {} ticks of {} row(s), cold frame {:.1f} ms, {} draws",
+                 options.rows, options.ticks, options.rowsPerTick, coldMs, draws);
+    printSummary("compositor", compositor);
+    printSummary("relayout", relayout);
+
+    std::ofstream out{options.output};
+    if (!out) {
+        std::println(stderr, "could not open {}", options.output);
+        return 1;
+    }
+    out << std::format("{{\n  \"instrumentation\": {},\n  \"rows\": {},\n  \"ticks\": {},\n  \"rows_per_tick\": {},\n"
+                       "  \"cold_ms\": {:.3f},\n  \"draws\": {},\n  \"compositor\": {},\n  \"relayout\": {}\n}}\n",
+                       instrumentation::enabled, options.rows, options.ticks, options.rowsPerTick,
+                       coldMs, draws, samplesJson(compositor), samplesJson(relayout));
+
+    std::println("wrote {}", options.output);
+    bool ok = compositor.rebuiltSnapshots == 0 && compositor.hitMisses == 0 && relayout.hitMisses == 0 &&
+        compositor.clipLeaks == 0 && relayout.clipLeaks == 0;
+    return ok ? 0 : 1;
+}
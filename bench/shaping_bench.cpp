@@ -0,0 +1,201 @@
+//
+//  shaping_bench.cpp
+//  gui_bench
+//
+//  TextShaper throughput. Shapes a fixed set of distinct paragraphs with the
+//  shaped-run cache off, split across 1..N threads, and reports paragraphs per
+//  second and speedup over one thread as JSON. A second pass shapes single
+//  paragraphs of growing length in both directions; ns per character should
+//  stay flat if shaping is linear.
+//
+
+#include "font_registry.hpp"
+#include "fonts.hpp"
+#include "textShaper.hpp"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <print>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace {
+#ifdef __APPLE__
+    const std::string DefaultFont = Arial;
+#else
+    const std::string DefaultFont = "/usr/share/fonts/truetype/dejavu/DejaVuSans.ttf";
+#endif
+
+    constexpr uint32_t LatinScriptTag = ('L' << 24) | ('a' << 16) | ('t' << 8) | 'n';
+
+    struct Options {
+        std::string output = "shaping_bench.json";
+        std::string font = DefaultFont;
+        size_t paragraphs = 4000;
+        size_t words = 80;
+        size_t rounds = 5;
+        size_t maxThreads = std::max(1u, std::thread::hardware_concurrency());
+        std::vector<size_t> lengths{1000, 10000, 100000};
+    };
+
+    constexpr std::array<std::string_view, 16> words {
+        "lorem", "ipsum", "dolor", "sit", "amet", "consectetur", "adipiscing", "elit",
+        "sed", "do", "eiusmod", "tempor", "incididunt", "ut", "labore", "magna"
+    };
+
+    // no two paragraphs share a run, so nothing is deduplicated along the way
+    std::vector<std::string> makeParagraphs(size_t count, size_t wordCount) {
+        std::vector<std::string> out(count);
+        for (size_t p = 0; p < count; ++p) {
+            out[p] = std::format("{} ", p);
+            for (size_t i = 0; i < wordCount; ++i) {
+                if (i) out[p] += ' ';
+                out[p] += words[(p * 7 + i * 13 + i / 16) % words.size()];
+            }
+        }
+        return out;
+    }
+
+    // one unbroken paragraph of about `length` bytes
+    std::string makeParagraph(size_t length) {
+        std::string out;
+        out.reserve(length + 16);
+        for (size_t i = 0; out.size() < length; ++i) {
+            if (i) out += ' ';
+            out += words[(i * 13 + i / 16) % words.size()];
+        }
+        return out;
+    }
+
+    // best wall time over rounds for shaping one paragraph as a single run
+    double shapeOne(TextShaper& shaper, const std::string& paragraph, const Options& options,
+                    TextDirection direction) {
+        FontId font = FontRegistry::shared().intern(options.font);
+        double best = 0.0;
+        for (size_t round = 0; round < options.rounds; ++round) {
+            auto start = std::chrono::steady_clock::now();
+            shaper.shape(paragraph, 0, paragraph.size(), font, direction, LatinScriptTag);
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            if (round == 0 || seconds < best) best = seconds;
+        }
+        return best;
+    }
+
+    // best wall time over rounds for shaping every paragraph on `threads` threads
+    double shapeAll(TextShaper& shaper, const std::vector<std::string>& paragraphs,
+                    const Options& options, size_t threads) {
+        FontId font = FontRegistry::shared().intern(options.font);
+        double best = 0.0;
+        for (size_t round = 0; round < options.rounds; ++round) {
+            auto start = std::chrono::steady_clock::now();
+            {
+                std::vector<std::jthread> workers;
+                for (size_t t = 0; t < threads; ++t) {
+                    workers.emplace_back([&, t] {
+                        for (size_t p = t; p < paragraphs.size(); p += threads) {
+                            shaper.shape(paragraphs[p], 0, paragraphs[p].size(), font,
+                                         TextDirection::Ltr, LatinScriptTag);
+                        }
+                    });
+                }
+            }
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            if (round == 0 || seconds < best) best = seconds;
+        }
+        return best;
+    }
+
+    bool parseArgs(int argc, const char* argv[], Options& options) {
+        for (int i = 1; i < argc; ++i) {
+            std::string_view arg = argv[i];
+            auto value = [&]() -> const char* {
+                return i + 1 < argc ? argv[++i] : nullptr;
+            };
+
+            if (arg == "--quick") {
+                options.paragraphs = 400;
+                options.rounds = 2;
+            } else if (arg == "--output" || arg == "--font" || arg == "--threads") {
+                auto* v = value();
+                if (!v) {
+                    std::println(stderr, "{} expects a value", arg);
+                    return false;
+                }
+                if (arg == "--output") options.output = v;
+                else if (arg == "--font") options.font = v;
+                else options.maxThreads = std::max<size_t>(1, std::stoul(v));
+            } else {
+                std::println(stderr, "usage: gui_shaping_bench [--output path] [--font path] [--threads max] [--quick]");
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+int main(int argc, const char* argv[]) {
+    Options options;
+    if (!parseArgs(argc, argv, options)) return 1;
+
+    if (!std::filesystem::exists(options.font)) {
+        std::println(stderr, "font {} not found", options.font);
+        return 1;
+    }
+
+    auto paragraphs = makeParagraphs(options.paragraphs, options.words);
+    TextShaper shaper{0};
+
+    // warm every thread's font and the face before timing anything
+    Options warmup = options;
+    warmup.rounds = 1;
+    shapeAll(shaper, paragraphs, warmup, options.maxThreads);
+
+    std::vector<size_t> threadCounts;
+    for (size_t threads = 1; threads < options.maxThreads; threads *= 2) threadCounts.push_back(threads);
+    threadCounts.push_back(options.maxThreads);
+
+    std::string results;
+    double baseline = 0.0;
+    for (size_t i = 0; i < threadCounts.size(); ++i) {
+        size_t threads = threadCounts[i];
+        double seconds = shapeAll(shaper, paragraphs, options, threads);
+        if (i == 0) baseline = seconds;
+        double throughput = static_cast<double>(paragraphs.size()) / seconds;
+        double speedup = baseline / seconds;
+
+        std::println("threads {:>3}  {:>10.0f} paragraphs/s  speedup {:>5.2f}x", threads, throughput, speedup);
+        results += std::format("{}\n    {{\"threads\": {}, \"seconds\": {:.6f}, \"paragraphs_per_second\": {:.0f}, \"speedup\": {:.3f}}}",
+                               i ? "," : "", threads, seconds, throughput, speedup);
+    }
+
+    std::string lengths;
+    for (size_t i = 0; i < options.lengths.size(); ++i) {
+        auto paragraph = makeParagraph(options.lengths[i]);
+        for (auto direction : {TextDirection::Ltr, TextDirection::Rtl}) {
+            bool rtl = direction == TextDirection::Rtl;
+            double seconds = shapeOne(shaper, paragraph, options, direction);
+            double nsPerChar = seconds * 1e9 / static_cast<double>(paragraph.size());
+
+            std::println("length {:>7} {}  {:>10.3f} ms  {:>8.1f} ns/char", paragraph.size(),
+                         rtl ? "rtl" : "ltr", seconds * 1e3, nsPerChar);
+            lengths += std::format("{}\n    {{\"length\": {}, \"direction\": \"{}\", \"seconds\": {:.6f}, \"ns_per_char\": {:.1f}}}",
+                                   lengths.empty() ? "" : ",", paragraph.size(), rtl ? "rtl" : "ltr", seconds, nsPerChar);
+        }
+    }
+
+    std::ofstream out{options.output};
+    if (!out) {
+        std::println(stderr, "could not open {}", options.output);
+        return 1;
+    }
+    out << std::format("{{\n  \"paragraphs\": {},\n  \"words\": {},\n  \"threads\": [{}\n  ],\n  \"lengths\": [{}\n  ]\n}}\n",
+                       options.paragraphs, options.words, results, lengths);
+
+    std::println("wrote {}", options.output);
+    return 0;
+}
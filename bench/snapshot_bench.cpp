@@ -0,0 +1,258 @@
+//
+//  snapshot_bench.cpp
+//  gui_bench
+//
+//  Render snapshots under a fake presenter. One scenario's tree runs on a
+//  tree::LayoutThread while a mutator thread posts edits to it several times a
+//  frame and the main thread plays presenter: every vsync interval it encodes
+//  whatever snapshot is latest into a recording encoder, then stalls as long
+//  as a slow GPU frame would. Reports how often a fresh snapshot was ready,
+//  how stale repeated ones got, and how long post() took, which should stay
+//  tiny however slow layout or the "GPU" is. At the end the last published
+//  snapshot is compared with one built from the tree, so no posted edit was
+//  lost. Runs headless; text scenarios need a font.
+//
+
+#include "bench.hpp"
+#include "context_manager.hpp"
+#include "fonts.hpp"
+#include "gpu_headless.hpp"
+#include "layout_thread.hpp"
+#include "render_snapshot.hpp"
+#include "render_tree.hpp"
+#include "tree_manager.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <memory>
+#include <numeric>
+#include <print>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+    using tree::LayoutThread;
+    using tree::RenderSnapshot;
+    using tree::RenderTree;
+    using tree::TreeStack;
+
+#ifdef __APPLE__
+    const std::string DefaultFont = Arial;
+#else
+    const std::string DefaultFont = "/usr/share/fonts/truetype/dejavu/DejaVuSans.ttf";
+#endif
+
+    struct Options {
+        std::string output = "snapshot_bench.json";
+        std::string font = DefaultFont;
+        std::string scenario = "flex_wrap_gallery";
+        double scale = 1.0;
+        size_t frames = 600;
+        size_t mutationsPerFrame = 4;
+        size_t intervalUs = 16667; // one vsync
+        size_t gpuUs = 12000;      // presenter stall after each encode
+    };
+
+    double percentile(std::vector<double> values, double q) {
+        if (values.empty()) return 0.0;
+        std::ranges::sort(values);
+        return values[std::min(values.size() - 1, static_cast<size_t>(q * static_cast<double>(values.size() - 1) + 0.5))];
+    }
+
+    double mean(const std::vector<double>& values) {
+        if (values.empty()) return 0.0;
+        return std::accumulate(values.begin(), values.end(), 0.0) / static_cast<double>(values.size());
+    }
+
+    bool sameSnapshot(const RenderSnapshot& a, const RenderSnapshot& b) {
+        return a.draws.size() == b.draws.size() &&
+            a.bindings.size() == b.bindings.size() &&
+            a.hitBoxes.size() == b.hitBoxes.size() &&
+            a.hitClips.size() == b.hitClips.size() &&
+            a.atomCount == b.atomCount &&
+            a.data.size() == b.data.size() &&
+            std::memcmp(a.data.data(), b.data.data(), a.data.size()) == 0 &&
+            a.inlineData.size() == b.inlineData.size() &&
+            std::memcmp(a.inlineData.data(), b.inlineData.data(), a.inlineData.size()) == 0 &&
+            a.scrollLayers.size() == b.scrollLayers.size() &&
+            std::memcmp(a.scrollLayers.data(), b.scrollLayers.data(), a.scrollLayers.size() * sizeof(simd_float2)) == 0;
+    }
+
+    bool parseArgs(int argc, const char* argv[], Options& options) {
+        for (int i = 1; i < argc; ++i) {
+            std::string_view arg = argv[i];
+            auto value = [&]() -> const char* {
+                return i + 1 < argc ? argv[++i] : nullptr;
+            };
+
+            if (arg == "--quick") {
+                options.scale = 0.1;
+                options.frames = 120;
+            } else if (arg == "--output" || arg == "--font" || arg == "--scenario" || arg == "--frames" ||
+                       arg == "--interval-us" || arg == "--gpu-us" || arg == "--mutations") {
+                auto* v = value();
+                if (!v) {
+                    std::println(stderr, "{} expects a value", arg);
+                    return false;
+                }
+                if (arg == "--output") options.output = v;
+                else if (arg == "--font") options.font = v;
+                else if (arg == "--scenario") options.scenario = v;
+                else if (arg == "--frames") options.frames = std::stoul(v);
+                else if (arg == "--interval-us") options.intervalUs = std::stoul(v);
+                else if (arg == "--gpu-us") options.gpuUs = std::stoul(v);
+                else options.mutationsPerFrame = std::max<size_t>(1, std::stoul(v));
+            } else {
+                std::println(stderr, "usage: gui_snapshot_bench [--scenario name] [--frames n] [--mutations per-frame] "
+                                     "[--interval-us n] [--gpu-us n] [--font path] [--output path] [--quick]");
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+int main(int argc, const char* argv[]) {
+    Options options;
+    if (!parseArgs(argc, argv, options)) return 1;
+
+    gpu::HeadlessDevice device;
+    auto& ctx = runtime::ContextManager::initContext(device, FrameInfo{1280, 800, 2});
+
+    auto scenarios = bench::makeScenarios({.scale = options.scale, .font = options.font});
+    auto found = std::ranges::find(scenarios, options.scenario, &bench::Scenario::name);
+    if (found == scenarios.end()) {
+        std::println(stderr, "no scenario named {}", options.scenario);
+        return 1;
+    }
+    if (found->usesText && !std::filesystem::exists(options.font)) {
+        std::println(stderr, "font {} not found; {} needs one", options.font, found->name);
+        return 1;
+    }
+
+    auto tree = std::make_unique<RenderTree>();
+    elements::Div rootElem{ctx};
+    rootElem.getDescriptor().color = simd_float4{0, 0, 0, 0};
+    auto* root = tree->createRoot(ctx, std::move(rootElem), runtime::getDivProcessor(ctx));
+    root->shared.width = style::Size::percent(1.0);
+    root->shared.height = style::Size::percent(1.0);
+    tree->markDirty();
+
+    TreeStack::pushTree(tree.get());
+    auto mutations = found->build();
+    TreeStack::popTree();
+    if (mutations.empty()) {
+        std::println(stderr, "{} has no mutations to post", found->name);
+        return 1;
+    }
+
+    const auto interval = std::chrono::microseconds{options.intervalUs};
+    const auto gpuStall = std::chrono::microseconds{options.gpuUs};
+
+    // from here on the tree belongs to the layout thread
+    LayoutThread producer{*tree, ctx.frameInfo};
+    std::atomic<bool> presenting{true};
+    std::vector<double> postNs;
+
+    std::thread mutator([&] {
+        auto spacing = interval / options.mutationsPerFrame;
+        auto next = Clock::now();
+        for (size_t i = 0; presenting.load(std::memory_order_relaxed); ++i) {
+            next += spacing;
+            std::this_thread::sleep_until(next);
+            auto& mutation = mutations[i % mutations.size()];
+            auto start = Clock::now();
+            producer.post([&mutation](RenderTree&) { mutation.apply(); });
+            postNs.push_back(static_cast<double>((Clock::now() - start).count()));
+        }
+    });
+
+    gpu::RecordingRenderEncoder encoder;
+    size_t fresh = 0;
+    size_t repeated = 0;
+    size_t empty = 0;
+    size_t encodeMismatches = 0;
+    size_t age = 0;
+    size_t maxAge = 0;
+    uint64_t lastGeneration = 0;
+    std::vector<double> encodeNs;
+
+    auto vsync = Clock::now();
+    for (size_t frame = 0; frame < options.frames; ++frame) {
+        vsync += interval;
+        std::this_thread::sleep_until(vsync);
+
+        auto snapshot = producer.latest();
+        if (!snapshot) {
+            ++empty;
+            continue;
+        }
+        if (snapshot->generation != lastGeneration) {
+            ++fresh;
+            age = 0;
+            lastGeneration = snapshot->generation;
+        } else {
+            ++repeated;
+            maxAge = std::max(maxAge, ++age);
+        }
+
+        auto start = Clock::now();
+        ctx.frameArena.beginFrame(ctx.frameIndex);
+        encoder.reset();
+        snapshot->encode(&encoder, ctx.frameArena);
+        ctx.frameIndex = ctx.frameIndex + 1;
+        encodeNs.push_back(static_cast<double>((Clock::now() - start).count()));
+        if (encoder.drawCount != snapshot->draws.size()) ++encodeMismatches;
+
+        // a slow GPU frame holding the presenter; layout and mutations carry on
+        std::this_thread::sleep_for(gpuStall);
+    }
+
+    presenting.store(false);
+    mutator.join();
+    producer.flush();
+
+    RenderSnapshot rebuilt;
+    producer.post([&](RenderTree& tree) { tree.buildSnapshot(rebuilt); });
+    producer.flush();
+    auto published = producer.latest();
+    bool consistent = published && sameSnapshot(*published, rebuilt);
+    uint64_t updates = published ? published->generation : 0;
+
+    double postMeanUs = mean(postNs) / 1e3;
+    double postP99Us = percentile(postNs, 0.99) / 1e3;
+    double postMaxUs = percentile(postNs, 1.0) / 1e3;
+    double encodeMeanUs = mean(encodeNs) / 1e3;
+
+    std::println("{}: {} presents, {} fresh, {} repeated, {} before the first snapshot, oldest repeat {} frames",
+                 found->name, options.frames, fresh, repeated, empty, maxAge);
+    std::println("  {} posts  mean {:.2f} us  p99 {:.2f} us  max {:.2f} us", postNs.size(), postMeanUs, postP99Us, postMaxUs);
+    std::println("  {} snapshots published  encode mean {:.1f} us  {} draws in the last one{}{}",
+                 updates, encodeMeanUs, published ? published->draws.size() : 0,
+                 encodeMismatches ? std::format("  ({} encodes lost draws)", encodeMismatches) : "",
+                 consistent ? "" : "  (last snapshot doesn't match the tree)");
+
+    std::ofstream out{options.output};
+    if (!out) {
+        std::println(stderr, "could not open {}", options.output);
+        return 1;
+    }
+    out << std::format("{{\n  \"scenario\": \"{}\",\n  \"frames\": {},\n  \"interval_us\": {},\n  \"gpu_us\": {},\n"
+                       "  \"posts\": {},\n  \"post_mean_us\": {:.3f},\n  \"post_p99_us\": {:.3f},\n  \"post_max_us\": {:.3f},\n"
+                       "  \"snapshots_published\": {},\n  \"fresh_presents\": {},\n  \"repeated_presents\": {},\n"
+                       "  \"empty_presents\": {},\n  \"max_repeat_age\": {},\n  \"encode_mean_us\": {:.3f},\n"
+                       "  \"encode_mismatches\": {},\n  \"consistent\": {}\n}}\n",
+                       found->name, options.frames, options.intervalUs, options.gpuUs,
+                       postNs.size(), postMeanUs, postP99Us, postMaxUs,
+                       updates, fresh, repeated, empty, maxAge, encodeMeanUs, encodeMismatches, consistent);
+
+    std::println("wrote {}", options.output);
+    return consistent && encodeMismatches == 0 ? 0 : 1;
+}
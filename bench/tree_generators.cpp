@@ -0,0 +1,496 @@
+#include "bench.hpp"
+#include "node_builder.hpp"
+#include <array>
+#include <format>
+#include <random>
+
+namespace bench {
+    using elements::Display;
+    using elements::FlexDirection;
+    using elements::FlexWrap;
+    using elements::Overflow;
+    using elements::Position;
+    using elements::Size;
+    using elements::TextOverflow;
+    using elements::WhiteSpace;
+    using tree::RenderTree;
+    using tree::TreeNode;
+    using tree::TreeStack;
+
+    using DivNode = elements::EventNode<elements::Div<elements::DivStorage>,
+        elements::DivProcessor<elements::DivStorage, elements::DivUniforms>>;
+    using TextNode = elements::EventNode<elements::Text<elements::TextStorage>,
+        elements::TextProcessor<elements::TextStorage, elements::TextUniforms>>;
+    using DivBuilder = decltype(elements::div());
+
+    namespace {
+        constexpr std::array<const char*, 16> words {
+            "lorem", "ipsum", "dolor", "sit", "amet", "consectetur", "adipiscing", "elit",
+            "sed", "do", "eiusmod", "tempor", "incididunt", "ut", "labore", "magna"
+        };
+
+        constexpr std::array<const char*, 8> rtlWords {
+            "שלום", "עולם", "ספר", "מילה", "בית", "ירושלים", "אור", "דרך"
+        };
+
+        std::string makeSentence(size_t wordCount, size_t seed) {
+            std::string out;
+            for (size_t i = 0; i < wordCount; ++i) {
+                if (i) out += ' ';
+                out += words[(seed * 7 + i * 13) % words.size()];
+            }
+            return out;
+        }
+
+        // alternating three-word Latin and Hebrew runs, so every line mixes directions
+        std::string makeBidiSentence(size_t wordCount, size_t seed) {
+            std::string out;
+            for (size_t i = 0; i < wordCount; ++i) {
+                if (i) out += ' ';
+                if ((i / 3) % 2) out += rtlWords[(seed * 5 + i * 3) % rtlWords.size()];
+                else out += words[(seed * 7 + i * 13) % words.size()];
+            }
+            return out;
+        }
+
+        simd_float4 shade(size_t i) {
+            float t = static_cast<float>(i % 32) / 31.0f;
+            return {0.2f + 0.6f * t, 0.3f, 0.8f - 0.6f * t, 1.0f};
+        }
+
+        // toggles between two colors so every apply() actually changes the node
+        Mutation paintMutation(RenderTree& tree, TreeNode* node) {
+            return {"paint", [&tree, node, flip = false]() mutable {
+                flip = !flip;
+                DivNode{tree, node}.color(flip ? simd_float4{1, 0, 0, 1} : simd_float4{0, 0, 1, 1});
+            }};
+        }
+
+        Mutation widthMutation(RenderTree& tree, TreeNode* node, float a, float b) {
+            return {"layout", [&tree, node, a, b, flip = false]() mutable {
+                flip = !flip;
+                DivNode{tree, node}.width(Size::px(flip ? b : a));
+            }};
+        }
+
+        Mutation heightMutation(RenderTree& tree, TreeNode* node, float a, float b) {
+            return {"layout", [&tree, node, a, b, flip = false]() mutable {
+                flip = !flip;
+                DivNode{tree, node}.height(Size::px(flip ? b : a));
+            }};
+        }
+
+        Mutation textMutation(RenderTree& tree, TreeNode* node, std::string a, std::string b) {
+            return {"text", [&tree, node, a = std::move(a), b = std::move(b), flip = false]() mutable {
+                flip = !flip;
+                TextNode{tree, node}.text(flip ? b : a);
+            }};
+        }
+
+        Mutation scrollMutation(RenderTree& tree, TreeNode* node, float step) {
+            return {"scroll", [&tree, node, step, flip = false]() mutable {
+                flip = !flip;
+                node->scrollOffset.y += flip ? step : -step;
+                tree.markScrolled(node);
+            }};
+        }
+    }
+
+    std::vector<Mutation> deepNesting(size_t depth) {
+        auto& tree = *TreeStack::getCurrentTree();
+
+        // builders hold a UIContext& and can't be reassigned, so collect them first
+        // and then nest each one into its predecessor
+        std::vector<DivBuilder> chain;
+        chain.reserve(depth);
+        for (size_t i = 0; i < depth; ++i) {
+            auto node = elements::div();
+            node.padding(Size::px(1)).color(shade(i));
+            chain.push_back(node);
+        }
+        for (size_t i = 1; i < depth; ++i) {
+            chain[i - 1](chain[i]);
+        }
+
+        auto* leaf = chain.back().treeNode();
+        DivNode{tree, leaf}.width(Size::px(20)).height(Size::px(20));
+
+        return {
+            paintMutation(tree, leaf),
+            widthMutation(tree, leaf, 20, 40),
+        };
+    }
+
+    std::vector<Mutation> wideSiblings(size_t count) {
+        auto& tree = *TreeStack::getCurrentTree();
+
+        auto container = elements::div();
+        container.display(Display::Flex).flexWrap(FlexWrap::Wrap).width(Size::percent(1.0));
+
+        TreeNode* middle = nullptr;
+        for (size_t i = 0; i < count; ++i) {
+            auto cell = elements::div(Size::px(8), Size::px(8), shade(i));
+            container(cell);
+            if (i == count / 2) middle = cell.treeNode();
+        }
+
+        return {
+            paintMutation(tree, middle),
+            widthMutation(tree, middle, 8, 16),
+        };
+    }
+
+    std::vector<Mutation> textParagraphs(size_t paragraphs, size_t wordsPerParagraph, const std::string& font) {
+        auto& tree = *TreeStack::getCurrentTree();
+
+        auto column = elements::div();
+        column.width(Size::px(720)).padding(Size::px(16));
+
+        TreeNode* target = nullptr;
+        for (size_t i = 0; i < paragraphs; ++i) {
+            auto paragraph = elements::div();
+            paragraph.marginBottom(8.0f);
+            auto run = elements::text(makeSentence(wordsPerParagraph, i), Size::pt(14.0f), {1, 1, 1, 1}, font);
+            paragraph(run);
+            column(paragraph);
+            if (i == paragraphs / 2) target = run.treeNode();
+        }
+
+        // the width flip re-wraps every paragraph, as a window resize would
+        return {
+            textMutation(tree, target, makeSentence(wordsPerParagraph, paragraphs / 2),
+                         makeSentence(wordsPerParagraph + 3, paragraphs / 2 + 1)),
+            widthMutation(tree, column.treeNode(), 720, 560),
+        };
+    }
+
+    std::vector<Mutation> flexWrapGallery(size_t cards, const std::string& font) {
+        auto& tree = *TreeStack::getCurrentTree();
+
+        auto gallery = elements::div();
+        gallery.display(Display::Flex)
+            .flexWrap(FlexWrap::Wrap)
+            .flexGap(Size::px(12))
+            .width(Size::percent(1.0))
+            .padding(Size::px(12));
+
+        TreeNode* card = nullptr;
+        TreeNode* caption = nullptr;
+        for (size_t i = 0; i < cards; ++i) {
+            auto item = elements::div(Size::px(160), Size::px(120), shade(i));
+            item.display(Display::Flex).flexDirection(FlexDirection::Col).cornerRadius(Size::px(8));
+            auto label = elements::text(std::format("card {}", i), Size::pt(12.0f), {1, 1, 1, 1}, font);
+            item(label);
+            gallery(item);
+            if (i == cards / 2) {
+                card = item.treeNode();
+                caption = label.treeNode();
+            }
+        }
+
+        return {
+            paintMutation(tree, card),
+            heightMutation(tree, card, 120, 180),
+            textMutation(tree, caption, std::format("card {}", cards / 2), "renamed card"),
+        };
+    }
+
+    std::vector<Mutation> gridItems(size_t items, size_t columns) {
+        auto& tree = *TreeStack::getCurrentTree();
+        size_t rows = (items + columns - 1) / columns;
+
+        auto grid = elements::div();
+        grid.display(Display::Grid)
+            .width(Size::percent(1.0))
+            .gridTemplateColumns(std::vector<Size>(columns, Size::fr(1)))
+            .gridTemplateRows(std::vector<Size>(rows, Size::px(24)))
+            .gridColumnGap(Size::px(4))
+            .gridRowGap(Size::px(4));
+
+        TreeNode* target = nullptr;
+        for (size_t i = 0; i < items; ++i) {
+            auto cell = elements::div();
+            cell.color(shade(i));
+            grid(cell);
+            if (i == items / 2) target = cell.treeNode();
+        }
+
+        return {
+            paintMutation(tree, target),
+            heightMutation(tree, target, 16, 20),
+        };
+    }
+
+    std::vector<Mutation> scrollList(size_t rows, const std::string& font) {
+        auto& tree = *TreeStack::getCurrentTree();
+
+        auto viewport = elements::div();
+        viewport.width(Size::px(480)).height(Size::px(640)).overflow(Overflow::Scroll);
+
+        TreeNode* row = nullptr;
+        for (size_t i = 0; i < rows; ++i) {
+            auto item = elements::div(Size::percent(1.0), Size::px(28), shade(i));
+            item.paddingLeft(Size::px(8));
+            auto label = elements::text(std::format("row {}", i), Size::pt(12.0f), {1, 1, 1, 1}, font);
+            item(label);
+            viewport(item);
+            if (i == rows / 2) row = item.treeNode();
+        }
+
+        return {
+            scrollMutation(tree, viewport.treeNode(), 28.0f),
+            paintMutation(tree, row),
+        };
+    }
+
+    // Fixed-width cells whose text never fits, so every cell draws an ellipsis.
+    std::vector<Mutation> ellipsisTable(size_t cells, size_t columns, const std::string& font) {
+        auto& tree = *TreeStack::getCurrentTree();
+
+        auto table = elements::div();
+        table.display(Display::Flex).flexWrap(FlexWrap::Wrap).width(Size::px(static_cast<float>(columns) * 160.0f));
+
+        TreeNode* cell = nullptr;
+        TreeNode* label = nullptr;
+        for (size_t i = 0; i < cells; ++i) {
+            auto item = elements::div(Size::px(160), Size::px(20), shade(i));
+            item.overflow(Overflow::Hidden).textOverflow(TextOverflow::ellipsis());
+            auto run = elements::text(makeSentence(8, i), Size::pt(12.0f), {1, 1, 1, 1}, font);
+            run.whiteSpace(WhiteSpace::NoWrap);
+            item(run);
+            table(item);
+            if (i == cells / 2) {
+                cell = item.treeNode();
+                label = run.treeNode();
+            }
+        }
+
+        return {
+            widthMutation(tree, cell, 160, 120),
+            textMutation(tree, label, makeSentence(8, cells / 2), makeSentence(9, cells / 2 + 1)),
+        };
+    }
+
+    // A screen of short distinct labels; cold start is almost all text atomization.
+    std::vector<Mutation> labelScreen(size_t labels, const std::string& font) {
+        auto& tree = *TreeStack::getCurrentTree();
+
+        auto screen = elements::div();
+        screen.display(Display::Flex).flexWrap(FlexWrap::Wrap).width(Size::percent(1.0));
+
+        TreeNode* label = nullptr;
+        for (size_t i = 0; i < labels; ++i) {
+            auto cell = elements::div(Size::px(150), Size::px(18), shade(i));
+            auto run = elements::text(std::format("{} {}", i, makeSentence(3, i)), Size::pt(11.0f), {1, 1, 1, 1}, font);
+            cell(run);
+            screen(cell);
+            if (i == labels / 2) label = run.treeNode();
+        }
+
+        return {
+            textMutation(tree, label, std::format("{} {}", labels / 2, makeSentence(3, labels / 2)),
+                         std::format("{} {}", labels / 2, makeSentence(4, labels / 2 + 1))),
+        };
+    }
+
+    // One text node wrapped to roughly `lines` lines of mixed LTR/RTL runs; the
+    // bidi_paragraph_* sizes should scale linearly with the line count.
+    std::vector<Mutation> bidiParagraph(size_t lines, const std::string& font) {
+        auto& tree = *TreeStack::getCurrentTree();
+        constexpr size_t wordsPerLine = 8;
+
+        auto column = elements::div();
+        column.width(Size::px(360)).padding(Size::px(8));
+
+        auto run = elements::text(makeBidiSentence(lines * wordsPerLine, lines), Size::pt(12.0f), {1, 1, 1, 1}, font);
+        column(run);
+
+        return {
+            widthMutation(tree, column.treeNode(), 360, 320),
+            textMutation(tree, run.treeNode(), makeBidiSentence(lines * wordsPerLine, lines),
+                         makeBidiSentence(lines * wordsPerLine + 3, lines + 1)),
+        };
+    }
+
+    // Same shape at every size so leaf_mutation_* results can be compared directly:
+    // an O(dirty) update keeps the mutation rows flat as the node count grows.
+    std::vector<Mutation> balancedTree(size_t nodes, size_t fanout) {
+        auto& tree = *TreeStack::getCurrentTree();
+
+        auto top = elements::div();
+        top.display(Display::Flex).flexWrap(FlexWrap::Wrap).width(Size::percent(1.0));
+
+        std::vector<TreeNode*> frontier{top.treeNode()};
+        size_t created = 1;
+        while (created < nodes) {
+            std::vector<TreeNode*> next;
+            for (auto* parent : frontier) {
+                for (size_t i = 0; i < fanout && created < nodes; ++i, ++created) {
+                    auto child = elements::div();
+                    child.padding(Size::px(1)).color(shade(created));
+                    DivBuilder::reparent(parent, child.treeNode());
+                    next.push_back(child.treeNode());
+                }
+            }
+            frontier = std::move(next);
+        }
+        auto* leaf = frontier[frontier.size() / 2];
+        DivNode{tree, leaf}.width(Size::px(4)).height(Size::px(4));
+
+        return {
+            paintMutation(tree, leaf),
+            widthMutation(tree, leaf, 4, 8),
+        };
+    }
+
+    // A seeded mix of block, flex, grid and absolutely positioned containers with
+    // fixed boxes and text leaves, for checking layout on shapes nobody wrote by
+    // hand. The same seed always builds the same tree; an empty font leaves out text.
+    std::vector<Mutation> randomTree(size_t nodes, uint64_t seed, const std::string& font) {
+        auto& tree = *TreeStack::getCurrentTree();
+        std::mt19937_64 rng{seed};
+        auto pick = [&](size_t n) { return static_cast<size_t>(rng() % n); };
+        auto px = [&](size_t lo, size_t hi) { return Size::px(static_cast<float>(lo + pick(hi - lo + 1))); };
+
+        auto top = elements::div();
+        top.width(Size::percent(1.0)).padding(Size::px(4));
+
+        std::vector<TreeNode*> containers{top.treeNode()};
+        TreeNode* box = nullptr;
+        TreeNode* label = nullptr;
+        std::string labelText;
+
+        size_t created = 1;
+        while (created < nodes) {
+            auto* parent = containers[pick(containers.size())];
+            auto attach = [&](auto& child) {
+                DivBuilder::reparent(parent, child.treeNode());
+                ++created;
+            };
+
+            switch (pick(font.empty() ? 6 : 7)) {
+                case 0: {
+                    auto block = elements::div();
+                    block.padding(px(0, 6)).marginBottom(static_cast<float>(pick(4))).color(shade(created));
+                    attach(block);
+                    containers.push_back(block.treeNode());
+                    break;
+                }
+                case 1: {
+                    auto row = elements::div();
+                    row.display(Display::Flex).flexWrap(FlexWrap::Wrap).flexGap(px(0, 8)).padding(px(0, 4));
+                    attach(row);
+                    containers.push_back(row.treeNode());
+                    break;
+                }
+                case 2: {
+                    auto column = elements::div();
+                    column.display(Display::Flex).flexDirection(FlexDirection::Col).width(px(80, 400));
+                    attach(column);
+                    containers.push_back(column.treeNode());
+                    break;
+                }
+                case 3: {
+                    // the cells come with the grid, so every item has a track
+                    size_t columns = 1 + pick(4);
+                    size_t rows = 1 + pick(3);
+                    auto grid = elements::div();
+                    grid.display(Display::Grid)
+                        .width(px(120, 600))
+                        .gridTemplateColumns(std::vector<Size>(columns, Size::fr(1)))
+                        .gridTemplateRows(std::vector<Size>(rows, px(16, 48)))
+                        .gridColumnGap(px(0, 6))
+                        .gridRowGap(px(0, 6));
+                    attach(grid);
+                    for (size_t i = 0; i < columns * rows && created < nodes; ++i) {
+                        auto cell = elements::div();
+                        cell.color(shade(created)).padding(px(0, 3));
+                        DivBuilder::reparent(grid.treeNode(), cell.treeNode());
+                        ++created;
+                        containers.push_back(cell.treeNode());
+                    }
+                    break;
+                }
+                case 4: {
+                    auto overlay = elements::div(px(20, 160), px(12, 80), shade(created));
+                    overlay.position(Position::Absolute).top(px(0, 200)).left(px(0, 300)).padding(px(0, 4));
+                    attach(overlay);
+                    containers.push_back(overlay.treeNode());
+                    break;
+                }
+                case 5: {
+                    auto leaf = elements::div(px(4, 120), px(4, 60), shade(created));
+                    attach(leaf);
+                    if (!box) box = leaf.treeNode();
+                    break;
+                }
+                default: {
+                    auto text = makeSentence(2 + pick(12), seed + created);
+                    auto run = elements::text(text, Size::pt(static_cast<float>(10 + pick(8))), {1, 1, 1, 1}, font);
+                    attach(run);
+                    if (!label) {
+                        label = run.treeNode();
+                        labelText = std::move(text);
+                    }
+                    break;
+                }
+            }
+        }
+
+        std::vector<Mutation> mutations;
+        if (box) mutations.push_back(widthMutation(tree, box, 40, 90));
+        if (label) mutations.push_back(textMutation(tree, label, labelText, labelText + " " + makeSentence(4, seed)));
+        return mutations;
+    }
+
+    std::vector<Scenario> makeScenarios(const GeneratorOptions& options) {
+        auto scaled = [&](size_t n) {
+            return std::max<size_t>(1, static_cast<size_t>(static_cast<double>(n) * options.scale));
+        };
+        auto font = options.font;
+
+        size_t depth = scaled(256);
+        size_t siblings = scaled(10000);
+        size_t paragraphs = scaled(200);
+        size_t cards = scaled(2000);
+        size_t gridCount = scaled(4096);
+        size_t rows = scaled(5000);
+        size_t cells = scaled(2000);
+        size_t labels = scaled(5000);
+        size_t randomNodes = scaled(20000);
+
+        std::vector<Scenario> scenarios {
+            {"deep_nesting", {{"depth", depth}}, false,
+                [=] { return deepNesting(depth); }},
+            {"wide_siblings", {{"count", siblings}}, false,
+                [=] { return wideSiblings(siblings); }},
+            {"text_paragraphs", {{"paragraphs", paragraphs}, {"words", 60}}, true,
+                [=] { return textParagraphs(paragraphs, 60, font); }},
+            {"flex_wrap_gallery", {{"cards", cards}}, true,
+                [=] { return flexWrapGallery(cards, font); }},
+            {"grid", {{"items", gridCount}, {"columns", 16}}, false,
+                [=] { return gridItems(gridCount, 16); }},
+            {"scroll_list", {{"rows", rows}}, true,
+                [=] { return scrollList(rows, font); }},
+            {"ellipsis_table", {{"cells", cells}, {"columns", 8}}, true,
+                [=] { return ellipsisTable(cells, 8, font); }},
+            {"label_screen", {{"labels", labels}}, true,
+                [=] { return labelScreen(labels, font); }},
+            {"random_tree", {{"nodes", randomNodes}, {"seed", 1}}, true,
+                [=] { return randomTree(randomNodes, 1, font); }},
+        };
+
+        for (size_t size : {1250, 2500, 5000}) {
+            size_t lines = scaled(size);
+            scenarios.push_back({std::format("bidi_paragraph_{}", size), {{"lines", lines}}, true,
+                [=] { return bidiParagraph(lines, font); }});
+        }
+
+        for (size_t size : {1000, 4000, 16000, 64000}) {
+            size_t nodes = scaled(size);
+            scenarios.push_back({std::format("leaf_mutation_{}", size), {{"nodes", nodes}, {"fanout", 8}}, false,
+                [=] { return balancedTree(nodes, 8); }});
+        }
+        return scenarios;
+    }
+}
@@ -6,46 +6,43 @@
 //
 
 #include "buffer_allocator.hpp"
+#include <algorithm>
+#include <cstring>
 
-DrawableBuffer::DrawableBuffer(MTL::Device* device, uint64_t bufferId, uint64_t size):
+DrawableBuffer::DrawableBuffer(gpu::Device* device, uint64_t bufferId, uint64_t size):
     bufferId{bufferId}
 {
-    buffer = device->newBuffer(size, MTL::ResourceStorageModeShared);
+    buffer = device->newBuffer(size);
 }
 
 BufferHandle DrawableBuffer::handle() {
     return bufferId;
 }
 
-MTL::Buffer* DrawableBuffer::get() {
-    return buffer;
+gpu::Buffer* DrawableBuffer::get() {
+    return buffer.get();
 }
 
 DrawableBuffer::DrawableBuffer(DrawableBuffer&& other) {
-    this->buffer = other.buffer;
+    this->buffer = std::move(other.buffer);
     this->bufferId = other.bufferId;
     
     other.bufferId = -1;
-    other.buffer = nullptr;
 }
 
 DrawableBuffer& DrawableBuffer::operator=(DrawableBuffer&& other) {
-    this->buffer = other.buffer;
+    this->buffer = std::move(other.buffer);
     this->bufferId = other.bufferId;
     
     other.bufferId = -1;
-    other.buffer = nullptr;
     
     return *this;
 }
 
-DrawableBuffer::~DrawableBuffer() {
-    if (buffer) {
-        buffer->release();
-    }
-}
+DrawableBuffer::~DrawableBuffer() = default;
 
-DrawableBufferAllocator::DrawableBufferAllocator(MTL::Device* device):
+DrawableBufferAllocator::DrawableBufferAllocator(gpu::Device* device):
+    nextId{0},
     device{device}
 {}
 
@@ -58,19 +55,18 @@ DrawableBuffer DrawableBufferAllocator::allocate(size_t size) {
 void DrawableBufferAllocator::resize(DrawableBuffer& db, size_t newSize) {
     auto& rawBuffer = db.buffer;
     
-    unsigned long oldSize = rawBuffer->length();
+    size_t oldSize = rawBuffer->length();
 
     if (newSize < oldSize)
         return;
 
-    MTL::Buffer* newBuffer = device->newBuffer(std::max(oldSize*2, newSize), MTL::StorageModeShared);
+    auto newBuffer = device->newBuffer(std::max(oldSize*2, newSize));
     
-    if (rawBuffer && oldSize > 0) {
+    if (!newBuffer) return;
+
+    if (oldSize > 0) {
         std::memcpy(newBuffer->contents(), rawBuffer->contents(), oldSize);
     }
     
-    if (!newBuffer) return;
-    
-    rawBuffer->release();
-    rawBuffer = newBuffer;
+    rawBuffer = std::move(newBuffer);
 }
@@ -6,19 +6,21 @@
 //
 
 #pragma once
-#include "metal_imports.hpp"
+#include "gpu.hpp"
+#include <memory>
 #include <print>
 
 using BufferHandle = uint64_t;
 
 struct DrawableBuffer {
     BufferHandle bufferId;
-    MTL::Buffer* buffer;
+    // shared so a render snapshot keeps the buffer it recorded alive across a resize
+    std::shared_ptr<gpu::Buffer> buffer;
     
     BufferHandle handle();
-    MTL::Buffer* get();
+    gpu::Buffer* get();
     
-    DrawableBuffer(MTL::Device* device, uint64_t bufferId, uint64_t size);
+    DrawableBuffer(gpu::Device* device, uint64_t bufferId, uint64_t size);
     DrawableBuffer(DrawableBuffer&&);
     DrawableBuffer& operator=(DrawableBuffer&& other);
     
@@ -30,9 +32,9 @@ struct DrawableBuffer {
 
 struct DrawableBufferAllocator{
     BufferHandle nextId;
-    MTL::Device* device;
+    gpu::Device* device;
     
-    DrawableBufferAllocator(MTL::Device* device);
+    DrawableBufferAllocator(gpu::Device* device);
     
     DrawableBuffer allocate(size_t size);
     void resize(DrawableBuffer& buffer, size_t newSize);
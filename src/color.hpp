@@ -7,7 +7,7 @@
 
 #pragma once
 #include <variant>
-#include "metal_imports.hpp"
+#include "simd_types.hpp"
 #include <string>
 #include <concepts>
 #include <algorithm>
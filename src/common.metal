@@ -27,6 +27,7 @@ struct ClipUniform {
     float2 rectCenter;
     float2 halfExtent;
     float2 cornerRadius;
+    uint scrollLayer;
 };
 
 inline float2 toNDC(const float2 pt, float width = 512.0f, float height = 512.0f) {
@@ -53,12 +54,15 @@ inline float rounded_rect_sdf(float2 pt, float2 halfExtent, float2 r) {
     return distOutside + distInside;
 }
 
-inline bool outside_clips(float2 p, constant ClipUniform* clips, uint count) {
+// p is in window space; each clip sits in its own scroll layer, moved by that
+// layer's entry in scrollLayers
+inline bool outside_clips(float2 p, constant ClipUniform* clips, uint count, constant float2* scrollLayers) {
     float d = -1e20;
 
     for (uint i = 0; i < count; ++i) {
         ClipUniform clip = clips[i];
-        d = max(d, rounded_rect_sdf(p - clip.rectCenter, clip.halfExtent, clip.cornerRadius));
+        float2 center = clip.rectCenter + scrollLayers[clip.scrollLayer];
+        d = max(d, rounded_rect_sdf(p - center, clip.halfExtent, clip.cornerRadius));
     }
 
     return d > 0.0;
@@ -22,7 +22,7 @@ namespace runtime {
     using elements::TextUniforms;
 
     struct ContextManager {
-        static UIContext& initContext(MTL::Device* device, MTK::View* view);
+        static UIContext& initContext(gpu::Device& device, FrameInfo frameInfo);
         static UIContext& getContext();
 
         static std::once_flag initFlag;
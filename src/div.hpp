@@ -12,14 +12,15 @@
 #include <mutex>
 #include <optional>
 #include <print>
+#include <span>
 #include "element.hpp"
 #include "events.hpp"
 #include "new_arch.hpp"
-#include "frame_buffered_buffer.hpp"
+#include "frame_arena.hpp"
 #include "renderer_constants.hpp"
 #include "sizing.hpp"
 #include <any>
-#include <simd/vector_types.h>
+#include "simd_types.hpp"
 #include "overloaded.hpp"
 #include "sdf_helpers.hpp"
 
@@ -90,6 +91,7 @@ namespace elements {
         simd_float2 rectCenter;
         simd_float2 halfExtent;
         uint32_t numClips;
+        uint32_t scrollLayer; // see LayoutResult::scrollLayer
     };
 
     struct DivUniforms {
@@ -97,18 +99,20 @@ namespace elements {
         DivGeometryUniforms geometry;
     };
 
+    // one div in an instanced batch; clips for all instances are packed into a
+    // single array and each instance reads numClips of them from clipStart
+    struct DivInstance {
+        DivUniforms uniforms;
+        uint32_t clipStart;
+    };
+
     struct DivStorage {
-        DivStorage(UIContext& ctx):
-            atomsBuffer{ctx.allocator, 6*sizeof(DivPoint), MaxOutstandingFrameCount},
-            placementsBuffer{ctx.allocator, sizeof(simd_float2), MaxOutstandingFrameCount},
-            uniformsBuffer{ctx.allocator, sizeof(DivUniforms), MaxOutstandingFrameCount},
-            clipsBuffer{ctx.allocator, sizeof(ClipUniform) * 4, MaxOutstandingFrameCount}
-        {}
+        DivStorage(UIContext&) {}
 
-        FrameBufferedBuffer<DivPoint> atomsBuffer;
-        FrameBufferedBuffer<simd_float2> placementsBuffer;
-        FrameBufferedBuffer<DivUniforms> uniformsBuffer;
-        FrameBufferedBuffer<ClipUniform> clipsBuffer;
+        FrameData<DivPoint> atomsBuffer;
+        FrameData<simd_float2> placementsBuffer;
+        FrameData<DivUniforms> uniformsBuffer;
+        FrameData<ClipUniform> clipsBuffer;
     };
 
     template <typename S = DivStorage>
@@ -157,70 +161,63 @@ namespace elements {
         {}
         
         // pipeline specific
-        void buildPipeline(MTL::RenderPipelineState*& pipeline) {
-            MTL::Library* defaultLibrary = ctx.device->newDefaultLibrary();
-            MTL::RenderPipelineDescriptor* renderPipelineDescriptor = MTL::RenderPipelineDescriptor::alloc()->init();
-            
-            // set up vertex descriptor
-            MTL::VertexDescriptor* vertexDescriptor = MTL::VertexDescriptor::alloc()->init();
-            vertexDescriptor->attributes()->object(0)->setFormat(MTL::VertexFormat::VertexFormatFloat2);
-            vertexDescriptor->attributes()->object(0)->setOffset(0);
-            vertexDescriptor->attributes()->object(0)->setBufferIndex(0);
-            
-            vertexDescriptor->attributes()->object(1)->setFormat(MTL::VertexFormat::VertexFormatUInt);
-            vertexDescriptor->attributes()->object(1)->setOffset(sizeof(simd_float2));
-            vertexDescriptor->attributes()->object(1)->setBufferIndex(0);
-            
-            vertexDescriptor->layouts()->object(0)->setStride(sizeof(DivPoint));
-            
-            renderPipelineDescriptor->setVertexDescriptor(vertexDescriptor);
-            
-            
-            // set up vertex function
-            MTL::Function* vertexFunction = defaultLibrary->newFunction(NS::String::string("vertex_div", NS::UTF8StringEncoding));
-            renderPipelineDescriptor->setVertexFunction(vertexFunction);
-            
-            // color attachments
-            renderPipelineDescriptor->colorAttachments()->object(0)->setPixelFormat(ctx.view->colorPixelFormat());
-            renderPipelineDescriptor->colorAttachments()->object(0)->setBlendingEnabled(true);
-            renderPipelineDescriptor->colorAttachments()->object(0)->setAlphaBlendOperation(MTL::BlendOperationAdd);
-            renderPipelineDescriptor->colorAttachments()->object(0)->setSourceRGBBlendFactor(MTL::BlendFactorSourceAlpha);
-            renderPipelineDescriptor->colorAttachments()->object(0)->setDestinationRGBBlendFactor(MTL::BlendFactorOneMinusSourceAlpha);
-            renderPipelineDescriptor->colorAttachments()->object(0)->setSourceAlphaBlendFactor(MTL::BlendFactorSourceAlpha);
-            renderPipelineDescriptor->colorAttachments()->object(0)->setDestinationAlphaBlendFactor(MTL::BlendFactorOneMinusSourceAlpha);
-            
-            
-            renderPipelineDescriptor->setDepthAttachmentPixelFormat(ctx.view->depthStencilPixelFormat());
-            
-            
-            // set up fragment function
-            MTL::Function* fragmentFunction = defaultLibrary->newFunction(NS::String::string("fragment_div", NS::UTF8StringEncoding));
-            renderPipelineDescriptor->setFragmentFunction(fragmentFunction);
-            
-            
-            NS::Error* error = nullptr;
-            pipeline = ctx.device->newRenderPipelineState(renderPipelineDescriptor, &error);
-            
-            if (error != nullptr)
-                std::println("error in pipeline creation: {}", error->localizedDescription()->utf8String());
-            
-            
-            defaultLibrary->release();
-            renderPipelineDescriptor->release();
-            vertexDescriptor->release();
-            vertexFunction->release();
+        std::unique_ptr<gpu::RenderPipeline> buildPipeline() {
+            gpu::RenderPipelineDescriptor descriptor {
+                .label = "div",
+                .vertexFunction = "vertex_div",
+                .fragmentFunction = "fragment_div",
+                .attributes = {
+                    {gpu::VertexFormat::Float2, 0, 0},
+                    {gpu::VertexFormat::UInt, sizeof(simd_float2), 0},
+                },
+                .stride = sizeof(DivPoint),
+                .blend = {}
+            };
+
+            return ctx.device->newRenderPipeline(descriptor);
         }
         
         
-        MTL::RenderPipelineState* getPipeline() {
+        gpu::RenderPipeline* getPipeline() {
             static std::once_flag initFlag;
-            static MTL::RenderPipelineState* pipeline = nullptr;
+            static std::unique_ptr<gpu::RenderPipeline> pipeline;
         
             std::call_once(initFlag, [&](){
-                buildPipeline(pipeline);
+                pipeline = buildPipeline();
             });
         
-            return pipeline;
+            return pipeline.get();
+        }
+
+        // quads come from the instance record, so no vertex descriptor
+        gpu::RenderPipeline* getBatchPipeline() {
+            static std::once_flag initFlag;
+            static std::unique_ptr<gpu::RenderPipeline> pipeline;
+
+            std::call_once(initFlag, [&](){
+                pipeline = ctx.device->newRenderPipeline({
+                    .label = "div_instanced",
+                    .vertexFunction = "vertex_div_instanced",
+                    .fragmentFunction = "fragment_div_instanced",
+                    .attributes = {},
+                    .stride = 0,
+                    .blend = {}
+                });
+            });
+
+            return pipeline.get();
+        }
+
+        // packing scratch for recordBatch; per thread, since snapshots can be
+        // built off the main thread
+        struct BatchState {
+            std::vector<DivInstance> instances;
+            std::vector<ClipUniform> clips;
+        };
+
+        BatchState& batchState() {
+            thread_local BatchState state;
+            return state;
         }
         
         Measured measure(Fragment<S>& fragment, Constraints& constraints, SharedDescriptor& shared, DivDescriptor& desc) {
@@ -273,11 +270,10 @@ namespace elements {
             }};
             
             // std::memcpy(atomsBuffer->contents(), atomPoints.data(), bufferLen);
-            fragment.fragmentStorage.atomsBuffer.write(ctx.frameIndex, atomPoints.data(), bufferLen);
+            fragment.fragmentStorage.atomsBuffer.write(atomPoints.data(), bufferLen);
             
             // finish allocating atom
             Atom atom;
-            atom.atomBufferHandle = fragment.fragmentStorage.atomsBuffer.getBufferHandle(0);
             atom.offset = 0;
             atom.length = bufferLen;
             atom.width = width;
@@ -318,11 +314,10 @@ namespace elements {
                 {{width,height}, 0},
             }};
             
-            fragment.fragmentStorage.atomsBuffer.write(ctx.frameIndex, atomPoints.data(), bufferLen);
+            fragment.fragmentStorage.atomsBuffer.write(atomPoints.data(), bufferLen);
             
             // finish allocating atom
             Atom atom;
-            atom.atomBufferHandle = fragment.fragmentStorage.atomsBuffer.getBufferHandle(0);
             atom.offset = 0;
             atom.length = bufferLen;
             atom.width = width;
@@ -344,12 +339,11 @@ namespace elements {
             
             // copy placements into buffer
             size_t bufferLen = offsets.size()*sizeof(simd_float2);
-            fragment.fragmentStorage.placementsBuffer.write(ctx.frameIndex, offsets.data(), bufferLen);
+            fragment.fragmentStorage.placementsBuffer.write(offsets.data(), bufferLen);
             
             // make the actual placement
             for (int i = 0; i < offsets.size(); ++i) {
                 placements.push_back({
-                    .placementBufferHandle = fragment.fragmentStorage.placementsBuffer.getBufferHandle(0),
                     .x = offsets[i].x,
                     .y = offsets[i].y
                 });
@@ -396,15 +390,15 @@ namespace elements {
             }
 
             geometryUniforms.numClips = static_cast<uint32_t>(layout.clipUniforms.size());
+            geometryUniforms.scrollLayer = layout.scrollLayer;
             
             DivUniforms uniforms {
                 .style = styleUniforms,
                 .geometry = geometryUniforms
             };
 
-            fragment.fragmentStorage.uniformsBuffer.write(ctx.frameIndex, &uniforms, sizeof(DivUniforms));
+            fragment.fragmentStorage.uniformsBuffer.write(&uniforms, sizeof(DivUniforms));
             fragment.fragmentStorage.clipsBuffer.write(
-                ctx.frameIndex,
                 layout.clipUniforms.data(),
                 sizeof(ClipUniform) * layout.clipUniforms.size()
             );
@@ -417,27 +411,55 @@ namespace elements {
             };
         }
         
-        void encode(MTL::RenderCommandEncoder* encoder, Fragment<S>& fragment, Finalized<U>& finalized) {
-            auto pipeline = getPipeline();
-            encoder->setRenderPipelineState(pipeline);
+        void record(DrawRecorder& recorder, Fragment<S>& fragment, const Finalized<U>& finalized) {
+            recorder.setRenderPipeline(getPipeline());
             
             // vertex buffers
-            auto atomBuf = fragment.fragmentStorage.atomsBuffer.getBuffer(ctx.frameIndex);
-            auto atomPlacementBuf = fragment.fragmentStorage.placementsBuffer.getBuffer(ctx.frameIndex);
-            auto frameInfoBuf = ctx.frameInfoBuffer.get();
+            auto atoms = recorder.copy(fragment.fragmentStorage.atomsBuffer);
+            auto atomPlacements = recorder.copy(fragment.fragmentStorage.placementsBuffer);
             
             // fragment buffers
-            auto uniformsBuf = fragment.fragmentStorage.uniformsBuffer.getBuffer(ctx.frameIndex);
-            auto clipsBuf = fragment.fragmentStorage.clipsBuffer.getBuffer(ctx.frameIndex);
+            auto uniforms = recorder.copy(fragment.fragmentStorage.uniformsBuffer);
+            auto clips = recorder.copy(fragment.fragmentStorage.clipsBuffer);
             
-            encoder->setVertexBuffer(atomBuf, 0, 0);
-            encoder->setVertexBuffer(atomPlacementBuf, 0, 1);
-            encoder->setVertexBuffer(frameInfoBuf, 0, 2);
+            recorder.setVertexData(atoms, 0);
+            recorder.setVertexData(atomPlacements, 1);
+            recorder.setVertexFrameInfo(2);
+            recorder.setVertexData(uniforms, 3);
+            recorder.setVertexScrollLayers(4);
             
-            encoder->setFragmentBuffer(uniformsBuf, 0, 0);
-            encoder->setFragmentBuffer(clipsBuf, 0, 1);
+            recorder.setFragmentData(uniforms, 0);
+            recorder.setFragmentData(clips, 1);
+            recorder.setFragmentScrollLayers(2);
             
-            encoder->drawPrimitives(MTL::PrimitiveTypeTriangle, NS::UInteger(0), 6);
+            recorder.drawPrimitives(6);
+        }
+
+        // a run of divs adjacent in paint order as one instanced draw
+        void recordBatch(DrawRecorder& recorder, std::span<const BatchItem<S, U>> batch) {
+            auto& state = batchState();
+            state.instances.clear();
+            state.clips.clear();
+            for (auto& item : batch) {
+                auto& clips = item.fragment->fragmentStorage.clipsBuffer.items;
+                state.instances.push_back({
+                    .uniforms = item.finalized->uniforms,
+                    .clipStart = static_cast<uint32_t>(state.clips.size())
+                });
+                state.clips.insert(state.clips.end(), clips.begin(), clips.end());
+            }
+
+            auto instances = recorder.copy(state.instances.data(), sizeof(DivInstance) * state.instances.size());
+            auto clips = recorder.copy(state.clips.data(), sizeof(ClipUniform) * state.clips.size());
+
+            recorder.setRenderPipeline(getBatchPipeline());
+            recorder.setVertexData(instances, 0);
+            recorder.setVertexFrameInfo(2);
+            recorder.setVertexScrollLayers(4);
+            recorder.setFragmentData(instances, 0);
+            recorder.setFragmentData(clips, 1);
+            recorder.setFragmentScrollLayers(2);
+            recorder.drawInstancedPrimitives(6, batch.size());
         }
 
         std::function<bool(HitTestContext<U>& context, simd_float2 testPoint)> setupHitTestFunction() {
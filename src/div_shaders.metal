@@ -17,7 +17,8 @@ struct DivVertexIn {
 
 struct DivVertexOut {
     float4 position [[position]];
-    float4 worldPosition;
+    float4 worldPosition; // in the div's scroll layer
+    float2 screenPosition;
 };
 
 struct DivStyleUniforms {
@@ -31,6 +32,7 @@ struct DivGeometryUniforms {
     simd_float2 rectCenter;
     simd_float2 halfExtent;
     uint numClips;
+    uint scrollLayer;
 };
 
 struct DivUniforms {
@@ -41,44 +43,41 @@ struct DivUniforms {
 vertex DivVertexOut vertex_div(
    DivVertexIn in [[stage_in]],
    constant float2* offsets [[buffer(1)]],
-   constant FrameInfo* frameInfo [[buffer(2)]]
+   constant FrameInfo* frameInfo [[buffer(2)]],
+   constant DivUniforms* uniforms [[buffer(3)]],
+   constant float2* scrollLayers [[buffer(4)]]
 )
 {
     DivVertexOut out;
     
     in.position += offsets[in.atom_id];
+    float2 screenPosition = in.position + scrollLayers[uniforms->geometry.scrollLayer];
     
-    float2 adjustedPosition = toNDC(in.position, frameInfo->width, frameInfo->height);
+    float2 adjustedPosition = toNDC(screenPosition, frameInfo->width, frameInfo->height);
     out.position = float4(adjustedPosition, 0.0, 1.0);
     out.worldPosition = float4(in.position, 0.0, 1.0);
+    out.screenPosition = screenPosition;
     return out;
 }
 
-fragment float4 fragment_div(
-    DivVertexOut in [[stage_in]],
-    constant DivUniforms* uniforms [[buffer(0)]],
-    constant ClipUniform* clips [[buffer(1)]]
-)
+// shared by the per-node and instanced paths
+inline float4 shade_div(float2 worldPosition, constant DivUniforms& uniforms)
 {
-    if (outside_clips(in.worldPosition.xy, clips, uniforms->geometry.numClips)) {
-        discard_fragment();
-    }
-
-    float2 localPosition = in.worldPosition.xy - uniforms->geometry.rectCenter;
-    float d = rounded_rect_sdf(localPosition, uniforms->geometry.halfExtent, uniforms->style.cornerRadius);
+    float2 localPosition = worldPosition - uniforms.geometry.rectCenter;
+    float d = rounded_rect_sdf(localPosition, uniforms.geometry.halfExtent, uniforms.style.cornerRadius);
 
     float px = fwidth(d);
 
     float outerMask = clamp(0.5 - d/px, 0.0, 1.0);
     
-    float innerD = d + uniforms->style.borderWidth;
+    float innerD = d + uniforms.style.borderWidth;
     float innerMask = clamp(0.5 - innerD/px, 0.0, 1.0);
     
     float borderMask = outerMask - innerMask;
     float fillMask = innerMask;
     
-    float4 fillColor = uniforms->style.color;
-    float4 borderColor = uniforms->style.borderColor;
+    float4 fillColor = uniforms.style.color;
+    float4 borderColor = uniforms.style.borderColor;
     
     float3 premulFill = fillColor.rgb * fillColor.a * fillMask;
     float3 premulBorder = borderColor.rgb * borderColor.a * borderMask;
@@ -92,3 +91,70 @@ fragment float4 fragment_div(
     
     return float4(rgb, alpha);
 }
+
+fragment float4 fragment_div(
+    DivVertexOut in [[stage_in]],
+    constant DivUniforms* uniforms [[buffer(0)]],
+    constant ClipUniform* clips [[buffer(1)]],
+    constant float2* scrollLayers [[buffer(2)]]
+)
+{
+    if (outside_clips(in.screenPosition, clips, uniforms->geometry.numClips, scrollLayers)) {
+        discard_fragment();
+    }
+
+    return shade_div(in.worldPosition.xy, *uniforms);
+}
+
+struct DivInstance {
+    DivUniforms uniforms;
+    uint clipStart;
+};
+
+struct DivInstancedVertexOut {
+    float4 position [[position]];
+    float4 worldPosition; // in the instance's scroll layer
+    float2 screenPosition;
+    uint instance [[flat]];
+};
+
+// six vertices per instance; the quad is the div's own box, so no vertex buffer
+vertex DivInstancedVertexOut vertex_div_instanced(
+    uint vertexId [[vertex_id]],
+    uint instanceId [[instance_id]],
+    constant DivInstance* instances [[buffer(0)]],
+    constant FrameInfo* frameInfo [[buffer(2)]],
+    constant float2* scrollLayers [[buffer(4)]]
+)
+{
+    const float2 corners[6] = {
+        float2(-1, -1), float2(1, -1), float2(-1, 1),
+        float2(-1, 1), float2(1, -1), float2(1, 1)
+    };
+
+    constant DivGeometryUniforms& geometry = instances[instanceId].uniforms.geometry;
+    float2 position = geometry.rectCenter + corners[vertexId] * geometry.halfExtent;
+    float2 screenPosition = position + scrollLayers[geometry.scrollLayer];
+
+    DivInstancedVertexOut out;
+    out.position = float4(toNDC(screenPosition, frameInfo->width, frameInfo->height), 0.0, 1.0);
+    out.worldPosition = float4(position, 0.0, 1.0);
+    out.screenPosition = screenPosition;
+    out.instance = instanceId;
+    return out;
+}
+
+fragment float4 fragment_div_instanced(
+    DivInstancedVertexOut in [[stage_in]],
+    constant DivInstance* instances [[buffer(0)]],
+    constant ClipUniform* clips [[buffer(1)]],
+    constant float2* scrollLayers [[buffer(2)]]
+)
+{
+    constant DivInstance& instance = instances[in.instance];
+    if (outside_clips(in.screenPosition, clips + instance.clipStart, instance.uniforms.geometry.numClips, scrollLayers)) {
+        discard_fragment();
+    }
+
+    return shade_div(in.worldPosition.xy, instance.uniforms);
+}
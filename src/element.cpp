@@ -4,12 +4,15 @@
 #include "new_arch.hpp"
 #include "utf8.hpp"
 #include "textShaper.hpp"
+#include "text_breaks.hpp"
 #include <algorithm>
 #include <any>
+#include <atomic>
 #include <cstdint>
 #include <cstdlib>
 #include <memory>
-#include <simd/vector_types.h>
+#include "simd_types.hpp"
+#include <span>
 #include <string>
 #include <unordered_map>
 
@@ -22,7 +25,6 @@ namespace tree {
     using elements::DescriptorPayload;
     using elements::GetField;
     using elements::RequestTarget;
-    using elements::isTextWhitespace;
     using layout::Constraints;
     using layout::LayoutEngine;
     using layout::LayoutInput;
@@ -35,6 +37,30 @@ namespace tree {
     using style::WhiteSpace;
     using style::WordBreak;
 
+    uint64_t nextLayoutGeneration() {
+        static std::atomic<uint64_t> generation{0};
+        return generation.fetch_add(1, std::memory_order_relaxed) + 1;
+    }
+
+    std::shared_ptr<const layout::InlineFormattingContext> retainInlineFormatting(
+        TreeNode* node,
+        std::shared_ptr<layout::InlineFormattingContext> context
+    ) {
+        // a node can hold several live contexts (speculative flex/grid measures at
+        // different widths), so look through a few before minting a new generation
+        for (auto& retained : node->inlineFormattingHistory) {
+            if (retained && retained->sameBoxes(*context)) {
+                return retained;
+            }
+        }
+
+        context->generation = nextLayoutGeneration();
+        auto& slot = node->inlineFormattingHistory[node->inlineFormattingHistoryNext];
+        node->inlineFormattingHistoryNext = (node->inlineFormattingHistoryNext + 1) % node->inlineFormattingHistory.size();
+        slot = std::move(context);
+        return slot;
+    }
+
     // Element-specific requests still use the request system
     std::optional<std::string> getText(TreeNode* node) {
         std::any request{DescriptorPayload{GetField{.name = "text"}}};
@@ -142,6 +168,12 @@ namespace tree {
         auto response = node->element->request(RequestTarget::TextShaping, request);
         return std::any_cast<ShapedRun*>(response);
     }
+
+    const TextBreaks* getTextBreaks(TreeNode* node) {
+        std::any request;
+        auto response = node->element->request(RequestTarget::TextBreaks, request);
+        return std::any_cast<const TextBreaks*>(response);
+    }
     
 
     uint64_t TreeNode::nextId = 0;
@@ -159,66 +191,24 @@ namespace tree {
         return nodes;
     }
 
-    void pushRunFragments(
-        const ShapedRun& shapedRun,
-        const std::vector<Atom>& atoms,
-        size_t clusterStart,
-        size_t clusterEnd,
+    void pushRunPieces(
+        std::span<const TextRunPiece> pieces,
+        float glyphWidth,
         float totalWidth,
         std::vector<LineFragment>& fragments,
         LineBox& lineBox,
         size_t lineBoxIndex
     ) {
-        if (clusterStart == clusterEnd) return;
-
-        float glyphWidth = 0.0f;
-        for (size_t i = clusterStart; i < clusterEnd; ++i) {
-            const auto& cluster = shapedRun.clusters[i];
-            for (size_t glyph = 0; glyph < cluster.glyphCount; ++glyph) {
-                glyphWidth += atoms[cluster.glyphStart + glyph].width;
-            }
-        }
         const float trailingWidth = totalWidth - glyphWidth;
-        const auto& finalCluster = shapedRun.clusters[clusterEnd - 1];
-        const size_t finalByteEnd = finalCluster.byteOffset + finalCluster.byteLength;
-
-        for (const auto& run : shapedRun.runs) {
-            const size_t runEnd = run.byteStart + run.byteLength;
-            size_t atomStart = atoms.size();
-            size_t atomEnd = 0;
-            size_t byteStart = 0;
-            size_t byteEnd = 0;
-            float width = 0.0f;
-            bool foundCluster = false;
-
-            for (size_t i = clusterStart; i < clusterEnd; ++i) {
-                const auto& cluster = shapedRun.clusters[i];
-                if (cluster.byteOffset < run.byteStart || cluster.byteOffset >= runEnd) {
-                    continue;
-                }
-
-                if (!foundCluster) {
-                    byteStart = cluster.byteOffset;
-                    foundCluster = true;
-                }
-                byteEnd = cluster.byteOffset + cluster.byteLength;
-                atomStart = std::min(atomStart, cluster.glyphStart);
-                atomEnd = std::max(atomEnd, cluster.glyphStart + cluster.glyphCount);
-                for (size_t glyph = 0; glyph < cluster.glyphCount; ++glyph) {
-                    width += atoms[cluster.glyphStart + glyph].width;
-                }
-            }
-
-            if (!foundCluster) continue;
-            if (byteEnd == finalByteEnd) width += trailingWidth;
 
+        for (const auto& piece : pieces) {
             LineFragment fragment{
-                .width = width,
-                .atomStart = atomStart,
-                .atomCount = atomEnd - atomStart,
-                .textByteStart = byteStart,
-                .textByteLength = byteEnd - byteStart,
-                .bidiLevel = run.bidiLevel,
+                .width = piece.holdsRangeEnd ? piece.width + trailingWidth : piece.width,
+                .atomStart = piece.atomStart,
+                .atomCount = piece.atomCount,
+                .textByteStart = piece.byteStart,
+                .textByteLength = piece.byteLength,
+                .bidiLevel = piece.bidiLevel,
                 .lineBoxIndex = lineBoxIndex,
                 .fragmentIndex = lineBox.fragmentCount
             };
@@ -227,20 +217,73 @@ namespace tree {
         }
     }
 
+    void pushRunFragments(
+        const ShapedRun& shapedRun,
+        const std::vector<Atom>& atoms,
+        size_t clusterStart,
+        size_t clusterEnd,
+        float totalWidth,
+        std::vector<LineFragment>& fragments,
+        LineBox& lineBox,
+        size_t lineBoxIndex
+    ) {
+        if (clusterStart == clusterEnd) return;
+
+        thread_local std::vector<TextRunPiece> pieces;
+        pieces.clear();
+        collectRunPieces(shapedRun, atoms, clusterStart, clusterEnd, pieces);
+        pushRunPieces(
+            pieces,
+            sumGlyphAdvances(shapedRun, atoms, clusterStart, clusterEnd),
+            totalWidth,
+            fragments,
+            lineBox,
+            lineBoxIndex
+        );
+    }
+
     void reorderLineFragments(layout::InlineFormattingContext& context) {
-        for (size_t lineIndex = 0; lineIndex < context.lineBoxes.size(); ++lineIndex) {
+        const size_t lineCount = context.lineBoxes.size();
+        if (lineCount == 0) return;
+
+        // bucket fragments by line (counting pass, then fill in logical order) so a
+        // long paragraph is one sweep over its fragments, not one per line; the
+        // scratch is kept per thread so lines don't allocate
+        thread_local std::vector<size_t> lineStarts;
+        thread_local std::vector<size_t> cursor;
+        thread_local std::vector<LineFragment*> ordered;
+
+        // fragments whose lineBoxIndex names no line box are left where they are
+        lineStarts.assign(lineCount + 1, 0);
+        for (const auto& fragment : context.fragments) {
+            if (fragment.lineBoxIndex >= lineCount) continue;
+            lineStarts[fragment.lineBoxIndex + 1]++;
+        }
+        for (size_t line = 0; line < lineCount; ++line) {
+            lineStarts[line + 1] += lineStarts[line];
+        }
+
+        ordered.resize(lineStarts[lineCount]);
+        cursor.assign(lineStarts.begin(), lineStarts.end() - 1);
+        for (auto& fragment : context.fragments) {
+            if (fragment.lineBoxIndex >= lineCount) continue;
+            ordered[cursor[fragment.lineBoxIndex]++] = &fragment;
+        }
+
+        for (size_t lineIndex = 0; lineIndex < lineCount; ++lineIndex) {
             auto& lineBox = context.lineBoxes[lineIndex];
-            std::vector<LineFragment*> fragments;
+            std::span<LineFragment*> fragments{
+                ordered.data() + lineStarts[lineIndex],
+                lineStarts[lineIndex + 1] - lineStarts[lineIndex]
+            };
             int maximumLevel = 0;
             int minimumOddLevel = -1;
 
-            for (auto& fragment : context.fragments) {
-                if (fragment.lineBoxIndex != lineIndex) continue;
-                fragments.push_back(&fragment);
-                maximumLevel = std::max(maximumLevel, static_cast<int>(fragment.bidiLevel));
-                if ((fragment.bidiLevel & 1u) != 0 &&
-                    (minimumOddLevel == -1 || fragment.bidiLevel < minimumOddLevel)) {
-                    minimumOddLevel = fragment.bidiLevel;
+            for (const auto* fragment : fragments) {
+                maximumLevel = std::max(maximumLevel, static_cast<int>(fragment->bidiLevel));
+                if ((fragment->bidiLevel & 1u) != 0 &&
+                    (minimumOddLevel == -1 || fragment->bidiLevel < minimumOddLevel)) {
+                    minimumOddLevel = fragment->bidiLevel;
                 }
             }
 
@@ -290,8 +333,58 @@ namespace tree {
         return prospectiveWidth > availableWidth;
     }
 
+    // Without preserved line feeds or break-all, lines only break between
+    // segments, so the walk goes a segment at a time on the widths cached at
+    // atomization instead of a cluster at a time. It adds widths up in the
+    // cluster walk's order, so both break at the same places bit for bit.
+    void appendSegmentLineFragments(
+        const TextBreaks& breaks,
+        const ShapedRun& shapedRun,
+        const std::vector<Atom>& atoms,
+        bool allowSoftWrap,
+        ResolvedMargins margins,
+        float availableWidth,
+        layout::AxisResolution widthResolution,
+        std::vector<LineFragment>& fragments,
+        std::vector<LineBox>& lineBoxes,
+        LineBox& currentLineBox,
+        size_t& currentLineBoxIndex,
+        bool& lastFragmentHasBreakOpportunity
+    ) {
+        for (size_t idx = 0; idx < breaks.segments.size(); ++idx) {
+            const auto& segment = breaks.segments[idx];
+            // the text's first segment is added up from the left margin, the rest from zero
+            float width = idx == 0
+                ? addSegmentWidth(margins.left, breaks, shapedRun, atoms, segment)
+                : segment.width;
+            width += margins.right;
+
+            if (allowSoftWrap && shouldTakeSoftBreak(
+                    widthResolution,
+                    lastFragmentHasBreakOpportunity,
+                    currentLineBox.fragmentCount > 0,
+                    currentLineBox.width + width,
+                    availableWidth
+                )) {
+                lineBoxes.push_back(currentLineBox);
+                currentLineBox = {};
+                currentLineBoxIndex++;
+            }
+
+            pushRunPieces(
+                std::span{breaks.pieces}.subspan(segment.pieceStart, segment.pieceCount),
+                segment.glyphWidth,
+                width,
+                fragments,
+                currentLineBox,
+                currentLineBoxIndex
+            );
+            lastFragmentHasBreakOpportunity = segment.breakAfter;
+        }
+    }
+
     void appendTextLineFragments(
-        const std::string& text,
+        const TextBreaks& breaks,
         const ShapedRun& shapedRun,
         const std::vector<Atom>& atoms,
         WhiteSpace whiteSpace,
@@ -303,7 +396,8 @@ namespace tree {
         std::vector<LineBox>& lineBoxes,
         LineBox& currentLineBox,
         size_t& currentLineBoxIndex,
-        bool& lastFragmentHasBreakOpportunity
+        bool& lastFragmentHasBreakOpportunity,
+        TextWrapPath path
     ) {
         const bool preserveLineFeeds =
             whiteSpace == WhiteSpace::Pre ||
@@ -314,6 +408,24 @@ namespace tree {
         const bool breakInsideWords =
             allowSoftWrap && wordBreak == WordBreak::BreakAll;
 
+        if (!preserveLineFeeds && !breakInsideWords && path == TextWrapPath::Segments) {
+            appendSegmentLineFragments(
+                breaks,
+                shapedRun,
+                atoms,
+                allowSoftWrap,
+                margins,
+                availableWidth,
+                widthResolution,
+                fragments,
+                lineBoxes,
+                currentLineBox,
+                currentLineBoxIndex,
+                lastFragmentHasBreakOpportunity
+            );
+            return;
+        }
+
         float runningWidth = margins.left;
         size_t runningAtomCount = 0;
         size_t runningClusterStart = 0;
@@ -321,12 +433,9 @@ namespace tree {
 
         while (idx < shapedRun.clusters.size()) {
             const auto& cluster = shapedRun.clusters[idx];
-            char32_t ch = cluster.codepoint();
+            const bool whitespace = breaks.clusterWhitespace[idx];
             const auto& firstAtom = atoms[cluster.glyphStart];
-            float width = 0.0f;
-            for (size_t i = 0; i < cluster.glyphCount; ++i) {
-                width += atoms[cluster.glyphStart + i].width;
-            }
+            const float width = breaks.clusterWidths[idx];
 
             if (preserveLineFeeds && firstAtom.placeOnNewLine) {
                 runningWidth += width + margins.right;
@@ -367,7 +476,7 @@ namespace tree {
                 continue;
             }
 
-            if (breakInsideWords && !isTextWhitespace(ch)) {
+            if (breakInsideWords && !whitespace) {
                 float prospectiveWidth = currentLineBox.width + runningWidth + width;
 
                 if (shouldTakeSoftBreak(
@@ -406,15 +515,14 @@ namespace tree {
                 continue;
             }
 
-            if (!isTextWhitespace(ch)) {
+            if (!whitespace) {
                 runningWidth += width;
                 runningAtomCount += cluster.glyphCount;
                 idx++;
                 continue;
             }
 
-            while (idx < shapedRun.clusters.size() &&
-                   isTextWhitespace(shapedRun.clusters[idx].codepoint())) {
+            while (idx < shapedRun.clusters.size() && breaks.clusterWhitespace[idx]) {
                 const auto& whitespace = shapedRun.clusters[idx];
                 for (size_t i = 0; i < whitespace.glyphCount; ++i) {
                     runningWidth += atoms[whitespace.glyphStart + i].width;
@@ -570,14 +678,13 @@ namespace tree {
         }
     }
 
-    layout::InlineFormattingInput buildIsolatedInlineBoxes(
+    layout::InlineFormattingContext wrapText(
         TreeNode* node,
         float maxWidth,
-        layout::AxisResolution widthResolution
+        layout::AxisResolution widthResolution,
+        TextWrapPath path
     ) {
-        auto context = std::make_shared<layout::InlineFormattingContext>();
-        auto& fragments = context->fragments;
-        auto& lineBoxes = context->lineBoxes;
+        layout::InlineFormattingContext context;
         LineBox currentLineBox{};
         size_t currentLineBoxIndex = 0;
         bool lastFragmentHasBreakOpportunity = false;
@@ -585,11 +692,11 @@ namespace tree {
         auto textResp = getText(node);
         if (textResp.has_value()) {
             auto shapedRun = getShapedRun(node);
+            auto breaks = getTextBreaks(node);
             auto margins = node->preLayout->resolvedMargins;
-            auto text = *textResp;
             auto& atoms = node->atomized->atoms;
             appendTextLineFragments(
-                text,
+                *breaks,
                 *shapedRun,
                 atoms,
                 getWhiteSpace(node).value_or(WhiteSpace::Normal),
@@ -597,27 +704,39 @@ namespace tree {
                 margins,
                 maxWidth,
                 widthResolution,
-                fragments,
-                lineBoxes,
+                context.fragments,
+                context.lineBoxes,
                 currentLineBox,
                 currentLineBoxIndex,
-                lastFragmentHasBreakOpportunity
+                lastFragmentHasBreakOpportunity,
+                path
             );
         }
 
         if (currentLineBox.fragmentCount > 0)
-            lineBoxes.push_back(currentLineBox);
+            context.lineBoxes.push_back(currentLineBox);
 
-        reorderLineFragments(*context);
+        reorderLineFragments(context);
+        return context;
+    }
 
-        const size_t fragmentCount = fragments.size();
+    layout::InlineFormattingInput buildIsolatedInlineBoxes(
+        TreeNode* node,
+        float maxWidth,
+        layout::AxisResolution widthResolution
+    ) {
+        auto context = std::make_shared<layout::InlineFormattingContext>(
+            wrapText(node, maxWidth, widthResolution, TextWrapPath::Segments)
+        );
+
+        const size_t fragmentCount = context->fragments.size();
         return {
-            .context = std::move(context),
+            .context = retainInlineFormatting(node, std::move(context)),
             .fragments = {.start = 0, .count = fragmentCount}
         };
     }
 
-    std::shared_ptr<layout::InlineFormattingContext> buildInlineBoxes(TreeNode* node, Constraints& childConstraints) {
+    std::shared_ptr<const layout::InlineFormattingContext> buildInlineBoxes(TreeNode* node, Constraints& childConstraints) {
         bool prevInline = false;
         auto context = std::make_shared<layout::InlineFormattingContext>();
         auto& childrenLineBoxes = context->lineBoxes;
@@ -637,8 +756,8 @@ namespace tree {
 
             if (textResp.has_value()) {
                 auto shapedRun = getShapedRun(child.get());
+                auto breaks = getTextBreaks(child.get());
                 auto margins = child->preLayout->resolvedMargins;
-                auto text = *textResp;
 
                 auto& atoms = child->atomized->atoms;
 
@@ -649,7 +768,7 @@ namespace tree {
                 }
 
                 appendTextLineFragments(
-                    text,
+                    *breaks,
                     *shapedRun,
                     atoms,
                     getWhiteSpace(child.get()).value_or(WhiteSpace::Normal),
@@ -661,7 +780,8 @@ namespace tree {
                     childrenLineBoxes,
                     currentLineBox,
                     currentLineBoxIndex,
-                    lastFragmentHasBreakOpportunity
+                    lastFragmentHasBreakOpportunity,
+                    TextWrapPath::Segments
                 );
 
                 prevInline = true;
@@ -681,6 +801,6 @@ namespace tree {
 
         reorderLineFragments(*context);
 
-        return context;
+        return retainInlineFormatting(node, std::move(context));
     }
 }
@@ -1,22 +1,26 @@
 #pragma once
 
 #include "sdf_helpers.hpp"
-#include "metal_imports.hpp"
+#include "simd_types.hpp"
 #include "new_arch.hpp"
 #include <concepts>
 #include <any>
+#include <array>
+#include <bit>
 #include <cstdint>
 #include <algorithm>
 #include <unordered_map>
 #include "frame_info.hpp"
+#include "hash_combine.hpp"
 #include "instrumentation.hpp"
 #include <optional>
 #include <print>
-#include <simd/vector_types.h>
+#include <span>
 #include <string_view>
 #include "parallel.hpp"
 #include "events.hpp"
 #include "printers.hpp"
+#include "render_snapshot.hpp"
 #include <numeric> 
 
 namespace elements {
@@ -29,6 +33,7 @@ namespace elements {
     using runtime::HitTestContext;
     using runtime::UIContext;
     using style::SharedDescriptor;
+    using tree::DrawRecorder;
 
     constexpr bool isTextWhitespace(char32_t codepoint) noexcept {
         return codepoint == U' '  ||
@@ -40,6 +45,7 @@ namespace elements {
     enum class RequestTarget {
         Descriptor,
         TextShaping,
+        TextBreaks,
     };
 
     template<typename E>
@@ -63,9 +69,9 @@ namespace elements {
         Measured& measured,
         Atomized& atomized,
         Placed& placed,
-        Finalized<U>& finalized,
+        const Finalized<U>& finalized,
         LayoutResult layout,
-        MTL::RenderCommandEncoder* encoder
+        DrawRecorder& recorder
     ) {
         { proc.measure(fragment, constraints, shared, desc) } -> std::same_as<Measured>;
         { proc.atomize(fragment, constraints, shared, desc, measured) } -> std::same_as<Atomized>;
@@ -77,20 +83,63 @@ namespace elements {
 
         { proc.finalize(fragment, constraints, shared, desc, measured, atomized, layout, placed) } -> std::same_as<Finalized<U>>;
         { proc.setupHitTestFunction() } -> std::same_as<std::function<bool(HitTestContext<U>&, simd_float2)>>;
-        proc.encode(encoder, fragment, finalized);
+        proc.record(recorder, fragment, finalized);
+    };
+
+    // one node of a run handed to a processor's recordBatch
+    template <typename S, typename U>
+    struct BatchItem {
+        Fragment<S>* fragment;
+        const Finalized<U>* finalized;
+    };
+
+    template <typename P, typename S, typename U>
+    concept BatchingProcessor = requires(P& proc, DrawRecorder& recorder, std::span<const BatchItem<S, U>> batch) {
+        proc.recordBatch(recorder, batch);
+    };
+
+    // Processors whose atomize splits into a compute half that may run on any
+    // thread alongside other nodes' (prepareAtoms) and a serial half that writes
+    // shared state and buffers (commitAtoms).
+    template <typename P, typename S, typename D>
+    concept ParallelAtomizingProcessor = requires(
+        P& proc,
+        Fragment<S>& fragment,
+        Constraints& constraints,
+        SharedDescriptor& shared,
+        D& desc,
+        Measured& measured
+    ) {
+        proc.prepareAtoms(fragment, constraints, shared, desc, measured);
+        { proc.commitAtoms(fragment, constraints, shared, desc, measured) } -> std::same_as<Atomized>;
     };
 
     struct ElementBase {
         virtual Measured measure(Constraints& constraints, SharedDescriptor& shared) = 0;
         virtual Atomized atomize(Constraints& constraints, SharedDescriptor& shared, Measured& measured) = 0;
+        // atomize in two calls: prepareAtomize is safe to run concurrently with
+        // other nodes', commitAtomize runs serially afterwards. Elements without a
+        // split do all of it in commit.
+        virtual void prepareAtomize(Constraints& constraints, SharedDescriptor& shared, Measured& measured) {}
+        virtual Atomized commitAtomize(Constraints& constraints, SharedDescriptor& shared, Measured& measured) {
+            return atomize(constraints, shared, measured);
+        }
         virtual LayoutResult layout(Constraints& constraints, SharedDescriptor& shared, Measured& measured, Atomized& atomized) = 0;
         virtual Atomized postLayout(Constraints& constraints, SharedDescriptor& shared, Measured& measured, Atomized& atomized, LayoutResult& layout) = 0;
         virtual Placed place(Constraints& constraints, SharedDescriptor& shared, Measured& measured, Atomized& atomized, LayoutResult& layout) = 0;
-        virtual std::any finalize(Constraints& constraints, SharedDescriptor& shared, Measured& measured, Atomized& atomized, LayoutResult& layout, Placed& placed) = 0;
+        // finalized results live in the typed element; record and hit testing read them in place
+        virtual void finalize(Constraints& constraints, SharedDescriptor& shared, Measured& measured, Atomized& atomized, LayoutResult& layout, Placed& placed) = 0;
+        virtual bool isFinalized() const = 0;
         virtual std::any request(RequestTarget target, std::any& payload) = 0;
-        virtual void encode(MTL::RenderCommandEncoder* encoder, std::any& finalized) = 0;
+        virtual void record(DrawRecorder& recorder) = 0;
+        // Consecutive nodes in paint order with the same non-null key can be recorded
+        // by one recordBatch call on any of them. The key is per element type.
+        virtual const void* batchKey() const {
+            return nullptr;
+        }
+        virtual void recordBatch(DrawRecorder& recorder, std::span<ElementBase* const> batch) {}
         virtual std::string_view elementTypeName() const = 0;
-        virtual bool preciseHitTest(simd_float2 point, const LayoutResult& layout, const std::any& finalized) {
+        virtual bool preciseHitTest(simd_float2 point, const LayoutResult& layout) const {
             return true;
         }
 
@@ -114,6 +163,19 @@ namespace elements {
             return processor.atomize(element.getFragment(), constraints, shared, element.getDescriptor(), measured);
         }
 
+        void prepareAtomize(Constraints& constraints, SharedDescriptor& shared, Measured& measured) override {
+            if constexpr (ParallelAtomizingProcessor<P, S, D>) {
+                processor.prepareAtoms(element.getFragment(), constraints, shared, element.getDescriptor(), measured);
+            }
+        }
+
+        Atomized commitAtomize(Constraints& constraints, SharedDescriptor& shared, Measured& measured) override {
+            if constexpr (ParallelAtomizingProcessor<P, S, D>) {
+                return processor.commitAtoms(element.getFragment(), constraints, shared, element.getDescriptor(), measured);
+            }
+            return atomize(constraints, shared, measured);
+        }
+
         LayoutResult layout(Constraints& constraints, SharedDescriptor& shared, Measured& measured, Atomized& atomized) override {
             return processor.layout(element.getFragment(), constraints, shared, element.getDescriptor(), measured, atomized);
         }
@@ -126,19 +188,43 @@ namespace elements {
             return processor.place(element.getFragment(), constraints, shared, element.getDescriptor(), measured, atomized, layout);
         }
 
-        std::any finalize(Constraints& constraints, SharedDescriptor& shared, Measured& measured, Atomized& atomized, LayoutResult& layout, Placed& placed) override {
-            auto finalized = processor.finalize(element.getFragment(), constraints, shared, element.getDescriptor(), measured, atomized, layout, placed);
-            auto finalizedErased = finalized;
-            return finalizedErased;
+        void finalize(Constraints& constraints, SharedDescriptor& shared, Measured& measured, Atomized& atomized, LayoutResult& layout, Placed& placed) override {
+            finalized = processor.finalize(element.getFragment(), constraints, shared, element.getDescriptor(), measured, atomized, layout, placed);
+        }
+
+        bool isFinalized() const override {
+            return finalized.has_value();
         }
 
         std::any request(RequestTarget target, std::any& payload) override {
             return element.request(target, payload);
         };
 
-        void encode(MTL::RenderCommandEncoder* encoder, std::any& finalizedErased) override {
-            auto finalized = std::any_cast<Finalized<typename E::UniformsType>>(finalizedErased);
-            return processor.encode(encoder, element.getFragment(), finalized);
+        void record(DrawRecorder& recorder) override {
+            if (!finalized) return;
+            processor.record(recorder, element.getFragment(), *finalized);
+        }
+
+        const void* batchKey() const override {
+            if constexpr (BatchingProcessor<P, S, U>) {
+                static constexpr char tag{};
+                return finalized ? &tag : nullptr;
+            }
+            return nullptr;
+        }
+
+        void recordBatch(DrawRecorder& recorder, std::span<ElementBase* const> batch) override {
+            if constexpr (BatchingProcessor<P, S, U>) {
+                // one snapshot is built serially, but not always on the same thread
+                thread_local std::vector<BatchItem<S, U>> items;
+                items.clear();
+                for (auto* base : batch) {
+                    // same key means same Element instantiation
+                    auto* elem = static_cast<Element*>(base);
+                    items.push_back({&elem->element.getFragment(), &*elem->finalized});
+                }
+                processor.recordBatch(recorder, std::span<const BatchItem<S, U>>{items});
+            }
         }
 
         std::string_view elementTypeName() const override {
@@ -149,10 +235,10 @@ namespace elements {
             return "Unknown";
         }
 
-        bool preciseHitTest(simd_float2 point, const LayoutResult& layout, const std::any& finalized) override {
-            if (hitTestFunction) {
+        bool preciseHitTest(simd_float2 point, const LayoutResult& layout) const override {
+            if (hitTestFunction && finalized) {
                 HitTestContext<U> ctx {
-                    .finalized = std::any_cast<Finalized<U>>(finalized),
+                    .finalized = *finalized,
                     .layout = layout
                 };
 
@@ -167,6 +253,7 @@ namespace elements {
         std::function<bool(HitTestContext<U>& context, simd_float2 testPoint)> hitTestFunction;
         E element;
         P& processor;
+        std::optional<Finalized<U>> finalized;
     };
 }
 
@@ -247,13 +334,78 @@ namespace tree {
             DirtyBits::PostLayout | DirtyBits::Place | DirtyBits::Finalize | DirtyBits::PaintOrder;
     }
 
+    // Exact, fixed-size fingerprint of what a phase reads from its constraints.
+    // Variable-length inputs are represented by version: the inline formatting
+    // context and bidi input by generation, the clip stack by its interned chain.
     struct ConstraintsKey {
-        std::size_t value{};
+        float originX{}, originY{};
+        float cursorX{}, cursorY{};
+        float availableWidth{}, availableHeight{};
+        layout::Direction direction{};
+        style::TextAlign textAlign{};
+        float frameWidth{}, frameHeight{}, frameScale{};
+        float containingBlockX{}, containingBlockY{};
+        float containingBlockWidth{}, containingBlockHeight{};
+        style::Display edgeDisplayMode{};
+        float edgeIntent{};
+        bool edgeCollapsable{};
+        float prevInlineHeight{};
+        std::optional<style::Size> replacedMarginTop;
+        std::optional<style::Size> replacedMarginBottom;
+        bool shrinkWidthToFit{}, shrinkHeightToFit{};
+        layout::AxisResolution widthResolution{}, heightResolution{};
+        uint64_t inlineFormattingGeneration{};
+        size_t fragmentStart{}, fragmentCount{};
+        uint64_t textBidiGeneration{};
+        uint64_t clipChainId{};
+        uint32_t textOverflowId{}; // 0 = none, else RenderTree::internTextOverflow
+        float extraOriginAX{}, extraOriginAY{};
+        float extraOriginBX{}, extraOriginBY{};
+        uint32_t scrollLayerA{}, scrollLayerB{}; // postLayout only: the layers those origins are in
+
+        // speculative/layout keys only
+        uint64_t nodeId{};
+        std::expected<float, style::SizeResolveFailure> explicitWidth{};
+        std::expected<float, style::SizeResolveFailure> explicitHeight{};
+
+        bool operator==(const ConstraintsKey&) const = default;
+    };
+}
 
-        bool operator==(const ConstraintsKey& other) const {
-            return value == other.value;
+namespace std {
+    template<>
+    struct hash<tree::ConstraintsKey> {
+        size_t operator()(const tree::ConstraintsKey& key) const noexcept {
+            std::size_t hash = 0;
+            hash_combine(hash, key.nodeId);
+            hash_combine(hash, key.originX);
+            hash_combine(hash, key.originY);
+            hash_combine(hash, key.cursorX);
+            hash_combine(hash, key.cursorY);
+            hash_combine(hash, key.availableWidth);
+            hash_combine(hash, key.availableHeight);
+            hash_combine(hash, key.inlineFormattingGeneration);
+            hash_combine(hash, key.fragmentStart);
+            hash_combine(hash, key.clipChainId);
+            hash_combine(hash, static_cast<int>(key.widthResolution));
+            hash_combine(hash, static_cast<int>(key.heightResolution));
+            hash_combine(hash, key.explicitWidth.value_or(-1.0f));
+            hash_combine(hash, key.explicitHeight.value_or(-1.0f));
+            return hash;
         }
     };
+}
+
+namespace tree {
+    // source of InlineFormattingContext and TextBidiInput generations; 0 means "none"
+    uint64_t nextLayoutGeneration();
+
+    // each phase sees different constraints, so each keeps its own key (Measure..Finalize)
+    inline constexpr std::size_t PhaseKeyCount = 6;
+
+    constexpr std::size_t phaseKeyIndex(DirtyBits bit) {
+        return static_cast<std::size_t>(std::countr_zero(std::to_underlying(bit)));
+    }
 
     struct CollapsedChain {
         ChainID id;
@@ -264,6 +416,11 @@ namespace tree {
     
     using EventHandler = std::function<void(Event&)>;
 
+    // translation of layer, or none for a layer the span doesn't cover
+    inline simd_float2 scrollTranslation(std::span<const simd_float2> translations, uint32_t layer) {
+        return layer < translations.size() ? translations[layer] : simd_float2{0.0f, 0.0f};
+    }
+
     struct TreeNode {
         template<ElementType E, typename P>
             requires ProcessorType<P, typename E::StorageType, typename E::DescriptorType, typename E::UniformsType>
@@ -333,24 +490,29 @@ namespace tree {
             children.push_back(std::move(child));
         }
 
-        bool contains(simd_float2 point) const {
+        // point is in window space; scrollTranslations (RenderTree::scrollTranslations)
+        // moves the box and each clip into place, and leaving it empty treats
+        // every scroll layer as unscrolled
+        bool contains(simd_float2 point, std::span<const simd_float2> scrollTranslations = {}) const {
             if (shared.pointerEvents == PointerEvents::None) return false;
             if (!layout.has_value()) return false;
             
             auto& box = layout->computedBox;
+            simd_float2 local = point - scrollTranslation(scrollTranslations, layout->scrollLayer);
 
-            if (point.x < box.x || point.x > box.x + box.width ||
-                point.y < box.y || point.y > box.y + box.height) {
+            if (local.x < box.x || local.x > box.x + box.width ||
+                local.y < box.y || local.y > box.y + box.height) {
                 return false;
             }
 
             for (auto& clip : layout->clipUniforms) {
-                if (rounded_rect_sdf(point - clip.rectCenter, clip.halfExtent, clip.cornerRadius) > 0.0f) {
+                simd_float2 clipPoint = point - scrollTranslation(scrollTranslations, clip.scrollLayer);
+                if (rounded_rect_sdf(clipPoint - clip.rectCenter, clip.halfExtent, clip.cornerRadius) > 0.0f) {
                     return false;
                 }
             }
 
-            return element->preciseHitTest(point, layout.value(), finalized);
+            return element->preciseHitTest(local, layout.value());
         }
 
         Position getPosition() const { return shared.position; }
@@ -396,15 +558,36 @@ namespace tree {
         std::optional<bidi::TextBidiInput> textBidiInput;
         std::optional<Placed> placed;
         std::unordered_map<EventType, std::vector<EventHandler>> eventHandlers;
-        std::any finalized;
         simd_float2 globalOffset {0.0f, 0.0f};
         simd_float2 scrollOffset {0.0f, 0.0f};
         simd_float2 scrollContentSize {0.0f, 0.0f};
         simd_float2 scrollViewportSize {0.0f, 0.0f};
+        // scroll layer this container's content is laid out in, allocated by
+        // RenderTree the first time it lays the node out as a scroll container
+        uint32_t contentScrollLayer{};
         SharedDescriptor shared;
         DirtyBits dirtySelf{~DirtyBits::None};
         DirtyBits dirtySubtree{~DirtyBits::None};
-        std::optional<ConstraintsKey> constraintsKey;
+        std::array<std::optional<ConstraintsKey>, PhaseKeyCount> constraintsKeys;
+        // recently built inline contexts (own children, or isolated as a flex/grid item)
+        std::array<std::shared_ptr<const layout::InlineFormattingContext>, 4> inlineFormattingHistory;
+        size_t inlineFormattingHistoryNext{};
+        // flex/grid speculative layouts of this node, kept across frames until a
+        // Measure/Atomize/Layout dirty reaches this node or its subtree
+        std::unordered_map<ConstraintsKey, layout::LayoutOutput> speculativeLayouts;
+        uint64_t speculativeLayoutsPass{};
+        // set while this node is a relayout root: the inputs its parent last laid it
+        // out with, so a dirty subtree can be laid out again from here
+        struct LayoutBoundaryInputs {
+            Constraints constraints;
+            Measured measured;
+        };
+        std::optional<LayoutBoundaryInputs> layoutBoundary;
+        uint64_t layoutPass{}; // RenderTree layout pass that last recomputed this node
+
+        std::optional<ConstraintsKey>& constraintsKey(DirtyBits phase) {
+            return constraintsKeys[phaseKeyIndex(phase)];
+        }
 
     private:
         static uint64_t nextId;
@@ -421,8 +604,33 @@ namespace tree {
 
     void precomputeMargins(TreeNode* node, Constraints& constraints, std::unordered_map<ChainID, CollapsedChain>& collapsedChainMap);
     
+    // Stamps a freshly built context with a generation, or hands back the node's
+    // retained context when the boxes came out identical.
+    std::shared_ptr<const layout::InlineFormattingContext> retainInlineFormatting(
+        TreeNode* node,
+        std::shared_ptr<layout::InlineFormattingContext> context
+    );
+
     // full blown inline context
-    std::shared_ptr<layout::InlineFormattingContext> buildInlineBoxes(TreeNode* node, Constraints& childConstraints);
+    std::shared_ptr<const layout::InlineFormattingContext> buildInlineBoxes(TreeNode* node, Constraints& childConstraints);
+
+    // How line breaking finds line ends in text that only breaks between words
+    // (no preserved line feeds, no break-all): Segments walks the TextBreaks
+    // segments cached at atomization, Clusters walks every cluster the way pre,
+    // pre-wrap and break-all text always does. Both give the same boxes bit for
+    // bit; layout uses Segments and gui_bench --check-layout compares the two.
+    enum class TextWrapPath : uint8_t {
+        Segments,
+        Clusters
+    };
+
+    // one text node's line boxes at maxWidth, reordered for display
+    layout::InlineFormattingContext wrapText(
+        TreeNode* node,
+        float maxWidth,
+        layout::AxisResolution widthResolution,
+        TextWrapPath path
+    );
 
     // inline context calculated for a single child, independently of other siblings
     layout::InlineFormattingInput buildIsolatedInlineBoxes(
@@ -432,12 +640,3 @@ namespace tree {
     );
 
 }
-
-namespace std {
-    template<>
-    struct hash<tree::ConstraintsKey> {
-        size_t operator()(const tree::ConstraintsKey& key) const noexcept {
-            return key.value;
-        }
-    };
-}
@@ -382,7 +382,9 @@ namespace layout {
             resolvedGap
         );
 
-        for (size_t pi = 0; pi < inFlowIndices.size(); ++pi) {
+        // every item's box is fixed by now, so each subtree lays out on its own
+        std::vector<Bounds> itemBounds(inFlowIndices.size());
+        tree.layoutIndependent(inFlowIndices.size(), [&](size_t pi) {
             size_t i = inFlowIndices[pi];
             auto childNode = node->children[i].get();
             auto& p = placements[pi];
@@ -445,8 +447,15 @@ namespace layout {
             }
             const auto& childLayout = childOutput->layout;
 
-            maxX = std::max(maxX, childLayout.computedBox.x + childLayout.computedBox.width);
-            maxY = std::max(maxY, childLayout.computedBox.y + childLayout.consumedHeight);
+            itemBounds[pi] = {
+                childLayout.computedBox.x + childLayout.computedBox.width,
+                childLayout.computedBox.y + childLayout.consumedHeight
+            };
+        });
+
+        for (const auto& bounds : itemBounds) {
+            maxX = std::max(maxX, bounds.maxX);
+            maxY = std::max(maxY, bounds.maxY);
         }
 
         return {maxX, maxY};
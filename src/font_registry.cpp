@@ -0,0 +1,83 @@
+#include "font_registry.hpp"
+#include <hb.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+FontRegistry& FontRegistry::shared() {
+    // never destroyed: faces in other statics may still point into the mappings
+    // while those are torn down
+    static auto* registry = new FontRegistry;
+    return *registry;
+}
+
+FontRegistry::~FontRegistry() {
+    for (auto& font : fonts) {
+        hb_blob_destroy(font.blob);
+        if (font.data) {
+            munmap(const_cast<std::byte*>(font.data), font.size);
+        }
+    }
+}
+
+FontId FontRegistry::intern(std::string_view path) {
+    {
+        std::shared_lock lock(mutex);
+        if (auto found = ids.find(path); found != ids.end()) {
+            return found->second;
+        }
+    }
+
+    std::unique_lock lock(mutex);
+    if (auto found = ids.find(path); found != ids.end()) {
+        return found->second;
+    }
+
+    Font font{.path = std::string{path}};
+    if (int fd = open(font.path.c_str(), O_RDONLY); fd >= 0) {
+        struct stat info{};
+        if (fstat(fd, &info) == 0 && info.st_size > 0) {
+            auto size = static_cast<size_t>(info.st_size);
+            void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapping != MAP_FAILED) {
+                font.data = static_cast<const std::byte*>(mapping);
+                font.size = size;
+            }
+        }
+        close(fd);
+    }
+    // the mapping outlives every blob, so HarfBuzz never has to copy or free it
+    font.blob = hb_blob_create(
+        reinterpret_cast<const char*>(font.data),
+        static_cast<unsigned int>(font.size),
+        HB_MEMORY_MODE_READONLY,
+        nullptr,
+        nullptr
+    );
+
+    auto id = static_cast<FontId>(fonts.size());
+    fonts.push_back(std::move(font));
+    ids.emplace(fonts.back().path, id);
+    return id;
+}
+
+const FontRegistry::Font& FontRegistry::entry(FontId id) const {
+    return fonts[id];
+}
+
+std::span<const std::byte> FontRegistry::data(FontId id) const {
+    std::shared_lock lock(mutex);
+    auto& font = entry(id);
+    return {font.data, font.size};
+}
+
+hb_blob_t* FontRegistry::blob(FontId id) const {
+    std::shared_lock lock(mutex);
+    return entry(id).blob;
+}
+
+std::string FontRegistry::path(FontId id) const {
+    std::shared_lock lock(mutex);
+    return entry(id).path;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <shared_mutex>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+struct hb_blob_t;
+
+// Small integer handle for a font file; what glyph, face and shaping caches key on.
+using FontId = uint32_t;
+
+// Process-wide table of font files. Each file is memory-mapped once on first use
+// and stays mapped, so FreeType (FT_New_Memory_Face) and HarfBuzz (hb_blob_t)
+// parse the same bytes instead of each opening the file. Interning a path hashes
+// the string once per lookup; everything downstream uses the FontId.
+class FontRegistry {
+public:
+    static FontRegistry& shared();
+
+    FontRegistry() = default;
+    ~FontRegistry();
+
+    FontRegistry(const FontRegistry&) = delete;
+    FontRegistry& operator=(const FontRegistry&) = delete;
+
+    FontId intern(std::string_view path);
+
+    // empty if the file couldn't be mapped
+    std::span<const std::byte> data(FontId font) const;
+    // a blob over data(); callers that keep it take their own reference
+    hb_blob_t* blob(FontId font) const;
+    std::string path(FontId font) const;
+
+private:
+    struct Font {
+        std::string path;
+        const std::byte* data{};
+        size_t size{};
+        hb_blob_t* blob{};
+    };
+
+    struct PathHash {
+        using is_transparent = void;
+        size_t operator()(std::string_view path) const {
+            return std::hash<std::string_view>{}(path);
+        }
+    };
+
+    const Font& entry(FontId id) const;
+
+    std::deque<Font> fonts; // indexed by FontId
+    std::unordered_map<std::string, FontId, PathHash, std::equal_to<>> ids;
+    mutable std::shared_mutex mutex;
+};
@@ -0,0 +1,72 @@
+#include "frame_arena.hpp"
+#include "instrumentation.hpp"
+#include <algorithm>
+
+FrameArena::FrameArena(gpu::Device* device, uint64_t numFrames):
+    device{device},
+    frames(numFrames)
+{}
+
+void FrameArena::beginFrame(uint64_t frameIndex) {
+    if (frameIndex == activeFrameIndex) return;
+    activeFrameIndex = frameIndex;
+
+    auto& frame = frames[frameIndex % frames.size()];
+    frame.chunk = 0;
+    frame.offset = 0;
+}
+
+ArenaSlice FrameArena::push(const void* data, size_t length) {
+    auto& frame = frames[activeFrameIndex % frames.size()];
+    // empty slices still get a real buffer to bind
+    size_t size = std::max<size_t>(length, 1);
+
+    while (true) {
+        if (frame.chunk == frame.chunks.size()) {
+            frame.chunks.push_back(device->newBuffer(std::max(ChunkSize, size)));
+        }
+
+        auto* buffer = frame.chunks[frame.chunk].get();
+        size_t offset = (frame.offset + Alignment - 1) & ~(Alignment - 1);
+        if (offset + size <= buffer->length()) {
+            if (length) {
+                std::memcpy(static_cast<std::byte*>(buffer->contents()) + offset, data, length);
+            }
+            frame.offset = offset + size;
+            instrumentation::recordBufferWrite(length);
+            return {buffer, offset};
+        }
+
+        frame.chunk++;
+        frame.offset = 0;
+    }
+}
+
+ArenaSlice FrameArena::pushRetained(uint64_t key, const void* data, size_t length) {
+    for (auto& entry : retained) {
+        if (entry.key == key) {
+            entry.lastFrameIndex = activeFrameIndex;
+            return {entry.buffer.get(), 0};
+        }
+    }
+
+    // the oldest buffer no frame in flight still reads, or a new one
+    Retained* slot = nullptr;
+    for (auto& entry : retained) {
+        if (entry.lastFrameIndex + frames.size() > activeFrameIndex) continue;
+        if (!slot || entry.lastFrameIndex < slot->lastFrameIndex) slot = &entry;
+    }
+    if (!slot) slot = &retained.emplace_back();
+
+    size_t size = std::max<size_t>(length, 1);
+    if (!slot->buffer || slot->buffer->length() < size) {
+        slot->buffer = device->newBuffer(size);
+    }
+    if (length) {
+        std::memcpy(slot->buffer->contents(), data, length);
+    }
+    slot->key = key;
+    slot->lastFrameIndex = activeFrameIndex;
+    instrumentation::recordBufferWrite(length);
+    return {slot->buffer.get(), 0};
+}
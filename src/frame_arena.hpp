@@ -0,0 +1,81 @@
+#pragma once
+
+#include "gpu.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+// Where an upload landed; bind buffer at offset.
+struct ArenaSlice {
+    gpu::Buffer* buffer;
+    size_t offset;
+};
+
+// Linear allocator for per-frame GPU data. Each in-flight frame owns a few large
+// chunks that are rewound when that frame index comes around again, so nothing a
+// previous frame's command buffer may still read is overwritten. A full chunk
+// moves on to the next one instead of reallocating, so slices handed out earlier
+// in the frame stay valid.
+class FrameArena {
+public:
+    // constant address space buffers on macOS need 256-byte aligned offsets
+    static constexpr size_t Alignment = 256;
+    static constexpr size_t ChunkSize = 1 << 20;
+
+    FrameArena(gpu::Device* device, uint64_t numFrames);
+
+    // rewinds the frame's chunks; calling it again for the same index is a no-op
+    void beginFrame(uint64_t frameIndex);
+    ArenaSlice push(const void* data, size_t length);
+    // Like push, but the upload outlives the frame: while key stays the same
+    // it hands back the same slice without copying. A buffer a new key
+    // replaced is only rewritten once every frame that bound it is done.
+    ArenaSlice pushRetained(uint64_t key, const void* data, size_t length);
+
+private:
+    struct Frame {
+        std::vector<std::unique_ptr<gpu::Buffer>> chunks;
+        size_t chunk{};
+        size_t offset{};
+    };
+
+    struct Retained {
+        std::unique_ptr<gpu::Buffer> buffer;
+        uint64_t key{};
+        uint64_t lastFrameIndex{}; // last frame that bound it
+    };
+
+    gpu::Device* device;
+    std::vector<Frame> frames;
+    std::vector<Retained> retained;
+    uint64_t activeFrameIndex{0};
+};
+
+// A node's CPU copy of one kind of draw data. It survives across frames and is
+// only rewritten when the phase that produces it reruns; building a render
+// snapshot copies the current contents out.
+template <typename T>
+struct FrameData {
+    void write(const T* data, size_t length, size_t offset = 0) {
+        items.resize((offset + length) / sizeof(T));
+        if (length) {
+            std::memcpy(reinterpret_cast<std::byte*>(items.data()) + offset, data, length);
+        }
+    }
+
+    const T* data() const {
+        return items.data();
+    }
+
+    size_t size() const {
+        return items.size();
+    }
+
+    ArenaSlice upload(FrameArena& arena) const {
+        return arena.push(items.data(), items.size() * sizeof(T));
+    }
+
+    std::vector<T> items;
+};
@@ -11,4 +11,6 @@ struct FrameInfo {
     float width;
     float height;
     float scale;
+
+    bool operator==(const FrameInfo&) const = default;
 };
@@ -8,18 +8,9 @@
 #include "glyphCache.hpp"
 #include <print>
 
-std::size_t GlyphFaceHash::operator()(const FontName& fontName) const
-{
-    std::size_t hv = 0;
-    
-    hash_combine(hv, fontName);
-    
-    return hv;
-}
-
 bool GlyphQuery::operator==(const GlyphQuery& other) const {
     return glyphId == other.glyphId
-        && fontName == other.fontName;
+        && fontId == other.fontId;
 }
 
 
@@ -29,7 +20,7 @@ std::size_t GlyphQueryHash::operator()(const GlyphQuery& queryKey) const
     std::size_t hv = 0;
     
     hash_combine(hv, queryKey.glyphId);
-    hash_combine(hv, queryKey.fontName);
+    hash_combine(hv, queryKey.fontId);
     
     return hv;
 }
@@ -50,28 +41,45 @@ GlyphCache::~GlyphCache() {
 }
 
 const Glyph& GlyphCache::retrieve(GlyphQuery glyphQuery) {
-    return GlyphCache::retrieve(glyphQuery.fontName, glyphQuery.glyphId);
+    return GlyphCache::retrieve(glyphQuery.fontId, glyphQuery.glyphId);
 }
                                   
-FT_Face GlyphCache::getFace(const FontName& font)
+FT_Face GlyphCache::getFace(FontId font)
 {
     if (auto found = fontFaces.find(font); found != fontFaces.end()) {
         return found->second;
     }
 
+    // the shared registry never unmaps, so the face can read the mapping directly
+    auto data = FontRegistry::shared().data(font);
     FT_Face face = nullptr;
-    FT_New_Face(ft, font.c_str(), 0, &face);
+    FT_New_Memory_Face(
+        ft,
+        reinterpret_cast<const FT_Byte*>(data.data()),
+        static_cast<FT_Long>(data.size()),
+        0,
+        &face
+    );
     FT_Set_Pixel_Sizes(face, 0, BASE_PIXEL_HEIGHT);
     fontFaces[font] = face;
     return face;
 }
 
-float GlyphCache::lineHeight(const FontName& font) {
-    std::unique_lock<std::shared_mutex> lock(cacheMutex);
+float GlyphCache::lineHeight(FontId font) {
+    // every appendTextAtoms asks, so the common case only reads; a face's
+    // size metrics never change once it's open
+    {
+        std::shared_lock<std::shared_mutex> readLock(cacheMutex);
+        if (auto found = fontFaces.find(font); found != fontFaces.end()) {
+            return found->second->size->metrics.height;
+        }
+    }
+
+    std::unique_lock<std::shared_mutex> writeLock(cacheMutex);
     return getFace(font)->size->metrics.height;
 }
 
-const Glyph& GlyphCache::retrieve(const FontName& font, uint32_t glyphId)
+const Glyph& GlyphCache::retrieve(FontId font, uint32_t glyphId)
 {
     GlyphQuery query{glyphId, font};
 
@@ -1,18 +1,13 @@
 #pragma once
 
+#include "font_registry.hpp"
 #include "hash_combine.hpp"
 #include "glyphs.hpp"
 #include <shared_mutex>
 
-using FontName = std::string;
-
-struct GlyphFaceHash {
-    std::size_t operator()(const FontName& fontName) const;
-};
-
 struct GlyphQuery {
     uint32_t glyphId;
-    FontName fontName;
+    FontId fontId;
     
     bool operator==(const GlyphQuery& other) const;
 };
@@ -28,14 +23,14 @@ struct GlyphCache {
     ~GlyphCache();
     
     const Glyph& retrieve(GlyphQuery glyphQuery);
-    const Glyph& retrieve(const FontName& font, uint32_t glyphId);
-    float lineHeight(const FontName& font);
+    const Glyph& retrieve(FontId font, uint32_t glyphId);
+    float lineHeight(FontId font);
     
     std::shared_mutex cacheMutex;
     FT_Library ft;
-    std::unordered_map<FontName, FT_Face, GlyphFaceHash> fontFaces;
+    std::unordered_map<FontId, FT_Face> fontFaces;
     std::unordered_map<GlyphQuery, Glyph, GlyphQueryHash> cache;
 
 private:
-    FT_Face getFace(const FontName& font);
+    FT_Face getFace(FontId font);
 };
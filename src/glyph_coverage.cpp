@@ -0,0 +1,265 @@
+#include "glyph_coverage.hpp"
+#include <algorithm>
+#include <cmath>
+
+// Mirrors text_shaders.metal line for line, in float, so the two stay easy to
+// compare; keep them in sync.
+namespace {
+    float dot(simd_float2 a, simd_float2 b) {
+        return a.x * b.x + a.y * b.y;
+    }
+
+    float distance(simd_float2 a, simd_float2 b) {
+        simd_float2 d = a - b;
+        return std::sqrt(dot(d, d));
+    }
+
+    simd_float2 evaluateQuadratic(simd_float2 p0, simd_float2 p1, simd_float2 p2, float t) {
+        float u = 1.0f - t;
+        return u * u * p0 + 2.0f * u * t * p1 + t * t * p2;
+    }
+
+    simd_float2 quadraticDerivative(simd_float2 p0, simd_float2 p1, simd_float2 p2, float t) {
+        return 2.0f * ((1.0f - t) * (p1 - p0) + t * (p2 - p1));
+    }
+
+    simd_float2 quadraticSecondDerivative(simd_float2 p0, simd_float2 p1, simd_float2 p2) {
+        return 2.0f * (p2 - 2.0f * p1 + p0);
+    }
+
+    simd_float2 evaluateCubic(simd_float2 p0, simd_float2 p1, simd_float2 p2, simd_float2 p3, float t) {
+        float u = 1.0f - t;
+        return u * u * u * p0
+            + 3.0f * u * u * t * p1
+            + 3.0f * u * t * t * p2
+            + t * t * t * p3;
+    }
+
+    simd_float2 cubicDerivative(simd_float2 p0, simd_float2 p1, simd_float2 p2, simd_float2 p3, float t) {
+        float u = 1.0f - t;
+        return 3.0f * u * u * (p1 - p0)
+            + 6.0f * u * t * (p2 - p1)
+            + 3.0f * t * t * (p3 - p2);
+    }
+
+    simd_float2 cubicSecondDerivative(simd_float2 p0, simd_float2 p1, simd_float2 p2, simd_float2 p3, float t) {
+        return 6.0f * (1.0f - t) * (p2 - 2.0f * p1 + p0)
+            + 6.0f * t * (p3 - 2.0f * p2 + p1);
+    }
+
+    int countQuadraticIntersections(simd_float2 p0, simd_float2 p1, simd_float2 p2, float fragX, float fragY) {
+        float eps = 1e-5f;
+
+        float minY = std::min(std::min(p0.y, p1.y), p2.y);
+        float maxY = std::max(std::max(p0.y, p1.y), p2.y);
+        if (fragY < minY || fragY >= maxY) return 0;
+
+        float a = p0.y - 2.0f * p1.y + p2.y;
+        float b = 2.0f * (p1.y - p0.y);
+        float c = p0.y - fragY;
+
+        int intersections = 0;
+
+        if (std::fabs(a) < eps) {
+            if (std::fabs(b) < eps) return 0;
+
+            float t = -c / b;
+
+            if (std::fabs(t) < eps) t = 0.0f;
+            if (std::fabs(1.0f - t) < eps) t = 1.0f;
+
+            if (t >= 0.0f && t <= 1.0f) {
+                float x = evaluateQuadratic(p0, p1, p2, t).x;
+                if (x > fragX) ++intersections;
+            }
+        } else {
+            float discrim = b * b - 4.0f * a * c;
+            if (discrim >= 0.0f) {
+                float sqDiscrim = std::sqrt(discrim);
+                float inv = 1.0f / (2.0f * a);
+                float t1 = (-b + sqDiscrim) * inv;
+                float t2 = (-b - sqDiscrim) * inv;
+
+                if (std::fabs(t1) < eps) t1 = 0.0f;
+                if (std::fabs(1.0f - t1) < eps) t1 = 1.0f;
+
+                if (std::fabs(t2) < eps) t2 = 0.0f;
+                if (std::fabs(1.0f - t2) < eps) t2 = 1.0f;
+
+                if (t1 >= 0.0f && t1 <= 1.0f) {
+                    float x = evaluateQuadratic(p0, p1, p2, t1).x;
+                    if (x > fragX) ++intersections;
+                }
+
+                if (t2 >= 0.0f && t2 <= 1.0f) {
+                    float x = evaluateQuadratic(p0, p1, p2, t2).x;
+                    if (x > fragX) ++intersections;
+                }
+            }
+        }
+
+        return intersections;
+    }
+
+    float approximateQuadraticDistance(simd_float2 p0, simd_float2 p1, simd_float2 p2, simd_float2 q) {
+        simd_float2 chord = p2 - p0;
+        float chordLengthSquared = dot(chord, chord);
+        float t = chordLengthSquared > 1e-6f
+            ? std::clamp(dot(q - p0, chord) / chordLengthSquared, 0.0f, 1.0f)
+            : 0.5f;
+
+        for (int i = 0; i < 2; ++i) {
+            simd_float2 point = evaluateQuadratic(p0, p1, p2, t);
+            simd_float2 first = quadraticDerivative(p0, p1, p2, t);
+            simd_float2 second = quadraticSecondDerivative(p0, p1, p2);
+            simd_float2 residual = point - q;
+            float denominator = dot(first, first) + dot(residual, second);
+            if (std::fabs(denominator) < 1e-6f) break;
+            t = std::clamp(t - dot(residual, first) / denominator, 0.0f, 1.0f);
+        }
+
+        return std::min(
+            distance(q, evaluateQuadratic(p0, p1, p2, t)),
+            std::min(distance(q, p0), distance(q, p2))
+        );
+    }
+
+    float approximateCubicDistance(simd_float2 p0, simd_float2 p1, simd_float2 p2, simd_float2 p3, simd_float2 q) {
+        simd_float2 chord = p3 - p0;
+        float chordLengthSquared = dot(chord, chord);
+        float t = chordLengthSquared > 1e-6f
+            ? std::clamp(dot(q - p0, chord) / chordLengthSquared, 0.0f, 1.0f)
+            : 0.5f;
+
+        for (int i = 0; i < 2; ++i) {
+            simd_float2 point = evaluateCubic(p0, p1, p2, p3, t);
+            simd_float2 first = cubicDerivative(p0, p1, p2, p3, t);
+            simd_float2 second = cubicSecondDerivative(p0, p1, p2, p3, t);
+            simd_float2 residual = point - q;
+            float denominator = dot(first, first) + dot(residual, second);
+            if (std::fabs(denominator) < 1e-6f) break;
+            t = std::clamp(t - dot(residual, first) / denominator, 0.0f, 1.0f);
+        }
+
+        return std::min(
+            distance(q, evaluateCubic(p0, p1, p2, p3, t)),
+            std::min(distance(q, p0), distance(q, p3))
+        );
+    }
+
+    int countCubicIntersections(
+        simd_float2 p0,
+        simd_float2 p1,
+        simd_float2 p2,
+        simd_float2 p3,
+        float fragX,
+        float fragY
+    ) {
+        float bounds[4] = {0.0f, 1.0f, 1.0f, 1.0f};
+        int boundCount = 1;
+        float a = -p0.y + 3.0f * p1.y - 3.0f * p2.y + p3.y;
+        float b = 2.0f * (p0.y - 2.0f * p1.y + p2.y);
+        float c = p1.y - p0.y;
+        constexpr float epsilon = 1e-6f;
+
+        if (std::fabs(a) < epsilon) {
+            if (std::fabs(b) >= epsilon) {
+                float root = -c / b;
+                if (root > 0.0f && root < 1.0f) bounds[boundCount++] = root;
+            }
+        } else {
+            float discriminant = b * b - 4.0f * a * c;
+            if (discriminant >= 0.0f) {
+                float rootDiscriminant = std::sqrt(discriminant);
+                float root1 = (-b - rootDiscriminant) / (2.0f * a);
+                float root2 = (-b + rootDiscriminant) / (2.0f * a);
+                if (root1 > 0.0f && root1 < 1.0f) bounds[boundCount++] = root1;
+                if (root2 > 0.0f && root2 < 1.0f && std::fabs(root2 - root1) >= epsilon) {
+                    bounds[boundCount++] = root2;
+                }
+            }
+        }
+
+        bounds[boundCount++] = 1.0f;
+        std::sort(bounds, bounds + boundCount);
+
+        int intersections = 0;
+        for (int interval = 0; interval < boundCount - 1; ++interval) {
+            float lower = bounds[interval];
+            float upper = bounds[interval + 1];
+            float lowerY = evaluateCubic(p0, p1, p2, p3, lower).y;
+            float upperY = evaluateCubic(p0, p1, p2, p3, upper).y;
+            if (fragY < std::min(lowerY, upperY) || fragY >= std::max(lowerY, upperY)) continue;
+
+            bool increasing = upperY > lowerY;
+            for (int iteration = 0; iteration < 8; ++iteration) {
+                float midpoint = (lower + upper) * 0.5f;
+                float midpointY = evaluateCubic(p0, p1, p2, p3, midpoint).y;
+                if ((midpointY < fragY) == increasing) lower = midpoint;
+                else upper = midpoint;
+            }
+
+            float root = (lower + upper) * 0.5f;
+            if (evaluateCubic(p0, p1, p2, p3, root).x > fragX) ++intersections;
+        }
+
+        return intersections;
+    }
+
+    struct CurveAccumulator {
+        const Glyph& glyph;
+        simd_float2 point;
+        float minDist = 1e20f;
+        int intersections = 0;
+        uint64_t curves = 0;
+
+        void add(size_t offset) {
+            const auto* p = glyph.points.data() + offset;
+            if (glyph.curveType == CurveType::Cubic) {
+                minDist = std::min(minDist, approximateCubicDistance(p[0], p[1], p[2], p[3], point));
+                intersections += countCubicIntersections(p[0], p[1], p[2], p[3], point.x, point.y);
+            } else {
+                minDist = std::min(minDist, approximateQuadraticDistance(p[0], p[1], p[2], point));
+                intersections += countQuadraticIntersections(p[0], p[1], p[2], point.x, point.y);
+            }
+            ++curves;
+        }
+
+        float coverage(float pixelSize, uint64_t* curvesEvaluated) const {
+            if (curvesEvaluated) *curvesEvaluated += curves;
+            bool inside = intersections & 1;
+            float sd = inside ? -minDist : minDist;
+            return std::clamp(0.5f - sd / pixelSize, 0.0f, 1.0f);
+        }
+    };
+}
+
+float glyphCoverage(const Glyph& glyph, simd_float2 point, float pixelSize, uint64_t* curvesEvaluated) {
+    CurveAccumulator accumulator{glyph, point};
+    const size_t pointStride = glyph.curveType == CurveType::Cubic ? 4 : 3;
+    size_t offset = 0;
+    for (size_t contourSize : glyph.contourSizes) {
+        for (size_t p = 0; p < contourSize; p += pointStride, offset += pointStride) {
+            if (offset + pointStride > glyph.points.size()) break;
+            accumulator.add(offset);
+        }
+    }
+    return accumulator.coverage(pixelSize, curvesEvaluated);
+}
+
+float bandedGlyphCoverage(const Glyph& glyph, simd_float2 point, float pixelSize, uint64_t* curvesEvaluated) {
+    const auto& bands = glyph.bands;
+    if (bands.bands.empty() || pixelSize > 2.0f * bands.margin) {
+        return glyphCoverage(glyph, point, pixelSize, curvesEvaluated);
+    }
+
+    CurveAccumulator accumulator{glyph, point};
+    const auto& band = bands.bands[glyphBandIndex(bands, point.y)];
+    for (uint32_t i = 0; i < band.curveCount; ++i) {
+        const auto& curve = bands.curves[band.curveStart + i];
+        // every curve from here on is more than margin to the left
+        if (curve.maxX + bands.margin < point.x) break;
+        accumulator.add(curve.pointOffset);
+    }
+    return accumulator.coverage(pixelSize, curvesEvaluated);
+}
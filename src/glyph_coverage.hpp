@@ -0,0 +1,15 @@
+#pragma once
+
+#include "glyphs.hpp"
+#include <cstdint>
+
+// CPU port of the coverage fragment_text computes, for checking the band
+// structure against the full curve loop and timing both off the GPU. point is
+// in glyph units (the shader's worldPosition), pixelSize is the width of one
+// screen pixel in glyph units (fwidth there). curvesEvaluated, when given, is
+// incremented once per curve looked at.
+float glyphCoverage(const Glyph& glyph, simd_float2 point, float pixelSize, uint64_t* curvesEvaluated = nullptr);
+
+// Same result through glyph.bands, falling back to every curve when a pixel is
+// wider than the bands can answer for, as fragment_text does.
+float bandedGlyphCoverage(const Glyph& glyph, simd_float2 point, float pixelSize, uint64_t* curvesEvaluated = nullptr);
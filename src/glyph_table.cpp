@@ -0,0 +1,89 @@
+#include "glyph_table.hpp"
+#include <bit>
+#include <cstring>
+#include <vector>
+
+GlyphTable::GlyphTable(DrawableBufferAllocator& allocator):
+    allocator{allocator},
+    glyphBuffer{allocator.allocate(4096)}
+{
+    append(nullptr);
+}
+
+uint32_t GlyphTable::intern(GlyphQuery query, const Glyph& glyph) {
+    std::lock_guard lock(mutex);
+    if (auto found = entries.find(query); found != entries.end()) {
+        return found->second;
+    }
+
+    uint32_t index = append(&glyph);
+    entries.emplace(query, index);
+    return index;
+}
+
+std::shared_ptr<gpu::Buffer> GlyphTable::buffer() {
+    std::lock_guard lock(mutex);
+    return glyphBuffer.buffer;
+}
+
+uint32_t GlyphTable::append(const Glyph* glyph) {
+    size_t contourCount = glyph ? glyph->contourSizes.size() : 0;
+    size_t pointsBytes = glyph ? glyph->points.size() * sizeof(simd_float2) : 0;
+    size_t headerInts = 4 + contourCount;
+    headerInts += headerInts % 2;
+
+    size_t entryStart = usedBytes / sizeof(int);
+    size_t pointsStart = entryStart + headerInts;
+    size_t bandsStart = pointsStart + pointsBytes / sizeof(int);
+
+    std::vector<int> header(headerInts, 0);
+    header[0] = static_cast<int>(pointsStart * sizeof(int) / sizeof(simd_float2));
+    header[3] = -1;
+    if (glyph) {
+        header[1] = static_cast<int>(glyph->curveType);
+        header[2] = static_cast<int>(contourCount);
+        for (size_t c = 0; c < contourCount; ++c) {
+            header[4 + c] = static_cast<int>(glyph->contourSizes[c]);
+        }
+    }
+
+    std::vector<int> bandBlock;
+    if (glyph && !glyph->bands.bands.empty()) {
+        const auto& bands = glyph->bands;
+        size_t curvesStart = bandsStart + 4 + bands.bands.size() * 2;
+        header[3] = static_cast<int>(bandsStart);
+
+        bandBlock.reserve(4 + bands.bands.size() * 2 + bands.curves.size() * 2);
+        bandBlock.push_back(static_cast<int>(bands.bands.size()));
+        bandBlock.push_back(std::bit_cast<int>(bands.minY));
+        bandBlock.push_back(std::bit_cast<int>(bands.bandHeight));
+        bandBlock.push_back(std::bit_cast<int>(bands.margin));
+        for (const auto& band : bands.bands) {
+            bandBlock.push_back(static_cast<int>(curvesStart + band.curveStart * 2));
+            bandBlock.push_back(static_cast<int>(band.curveCount));
+        }
+        for (const auto& curve : bands.curves) {
+            bandBlock.push_back(static_cast<int>(curve.pointOffset));
+            bandBlock.push_back(std::bit_cast<int>(curve.maxX));
+        }
+    }
+
+    size_t requiredSize = (bandsStart + bandBlock.size()) * sizeof(int);
+    // keep the next entry's points 8-byte aligned
+    requiredSize += requiredSize % sizeof(simd_float2);
+    if (requiredSize > glyphBuffer.get()->length()) {
+        allocator.resize(glyphBuffer, requiredSize);
+    }
+
+    auto* contents = reinterpret_cast<int*>(glyphBuffer.get()->contents());
+    std::memcpy(contents + entryStart, header.data(), header.size() * sizeof(int));
+    if (pointsBytes) {
+        std::memcpy(contents + pointsStart, glyph->points.data(), pointsBytes);
+    }
+    if (!bandBlock.empty()) {
+        std::memcpy(contents + bandsStart, bandBlock.data(), bandBlock.size() * sizeof(int));
+    }
+
+    usedBytes = requiredSize;
+    return static_cast<uint32_t>(entryStart);
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "buffer_allocator.hpp"
+#include "glyphCache.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+// Every glyph drawn so far, packed once into one GPU buffer shared by all text
+// nodes. An entry is an int header, the glyph's curve points, then its bands:
+//
+//   [pointIndex, curveType, numContours, bandsIndex, contourSize..., pad] [points...]
+//   [bandCount, minY, bandHeight, margin, (curveStart, curveCount)...] [(pointOffset, maxX)...]
+//
+// pointIndex counts float2s from the start of the buffer; bandsIndex and
+// curveStart count ints, and bandsIndex is -1 for a glyph without bands. Floats
+// in the band block are stored bit for bit. The header is padded so the points
+// stay 8-byte aligned. Atoms name a glyph by the int index of its header, so
+// text nodes upload no per-glyph metadata of their own.
+class GlyphTable {
+public:
+    // entry with no contours, for atoms that draw nothing (line feeds)
+    static constexpr uint32_t EmptyGlyph = 0;
+
+    explicit GlyphTable(DrawableBufferAllocator& allocator);
+
+    uint32_t intern(GlyphQuery query, const Glyph& glyph);
+    // the current buffer; a later resize swaps in a new one and leaves this intact
+    std::shared_ptr<gpu::Buffer> buffer();
+
+private:
+    uint32_t append(const Glyph* glyph);
+
+    DrawableBufferAllocator& allocator;
+    DrawableBuffer glyphBuffer;
+    size_t usedBytes{};
+    std::unordered_map<GlyphQuery, uint32_t, GlyphQueryHash> entries;
+    std::mutex mutex;
+};
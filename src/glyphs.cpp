@@ -7,6 +7,7 @@
 
 #include "glyphs.hpp"
 #include "freetype/ftglyph.h"
+#include <algorithm>
 #include <limits>
 #include "freetype/ftbbox.h"
 
@@ -236,11 +237,102 @@ Glyph processContours(FT_Face face)
         contourStart = contours[c] + 1;
     }
 
-    return {
+    Glyph glyph {
         .quad = quad,
         .curveType = curveType,
         .points = points,
         .numContours = numContours,
         .contourSizes = contourSizes
     };
+    glyph.bands = buildGlyphBands(glyph);
+    return glyph;
+}
+
+size_t glyphBandIndex(const GlyphBands& bands, float y) {
+    float band = std::floor((y - bands.minY) / bands.bandHeight);
+    return static_cast<size_t>(std::clamp(band, 0.0f, static_cast<float>(bands.bands.size() - 1)));
+}
+
+GlyphBands buildGlyphBands(const Glyph& glyph) {
+    struct CurveBounds {
+        uint32_t pointOffset;
+        float minY;
+        float maxY;
+        float maxX;
+    };
+
+    // walk the curves the way fragment_text does: contour by contour, one
+    // curve per stride points
+    const size_t pointStride = glyph.curveType == CurveType::Cubic ? 4 : 3;
+    std::vector<CurveBounds> curves;
+    size_t offset = 0;
+    for (size_t contourSize : glyph.contourSizes) {
+        for (size_t p = 0; p < contourSize; p += pointStride, offset += pointStride) {
+            if (offset + pointStride > glyph.points.size()) break;
+            CurveBounds bounds {
+                .pointOffset = static_cast<uint32_t>(offset),
+                .minY = std::numeric_limits<float>::max(),
+                .maxY = std::numeric_limits<float>::lowest(),
+                .maxX = std::numeric_limits<float>::lowest()
+            };
+            // a curve stays inside the hull of its control points
+            for (size_t i = 0; i < pointStride; ++i) {
+                auto point = glyph.points[offset + i];
+                bounds.minY = std::min(bounds.minY, point.y);
+                bounds.maxY = std::max(bounds.maxY, point.y);
+                bounds.maxX = std::max(bounds.maxX, point.x);
+            }
+            curves.push_back(bounds);
+        }
+    }
+
+    GlyphBands result{.margin = GlyphBandMargin};
+    if (curves.empty()) return result;
+
+    float minY = std::numeric_limits<float>::max();
+    float maxY = std::numeric_limits<float>::lowest();
+    for (const auto& curve : curves) {
+        minY = std::min(minY, curve.minY);
+        maxY = std::max(maxY, curve.maxY);
+    }
+
+    size_t bandCount = std::clamp<size_t>(
+        static_cast<size_t>(std::ceil(std::sqrt(static_cast<double>(curves.size())))),
+        1,
+        MaxGlyphBands
+    );
+    if (!(maxY > minY)) bandCount = 1;
+    result.minY = minY;
+    result.bandHeight = maxY > minY ? (maxY - minY) / static_cast<float>(bandCount) : 1.0f;
+    result.bands.resize(bandCount);
+
+    // counting pass, then fill
+    std::vector<uint32_t> starts(bandCount + 1, 0);
+    for (const auto& curve : curves) {
+        size_t first = glyphBandIndex(result, curve.minY - result.margin);
+        size_t last = glyphBandIndex(result, curve.maxY + result.margin);
+        for (size_t band = first; band <= last; ++band) starts[band + 1]++;
+    }
+    for (size_t band = 0; band < bandCount; ++band) starts[band + 1] += starts[band];
+
+    result.curves.resize(starts[bandCount]);
+    std::vector<uint32_t> cursor(starts.begin(), starts.end() - 1);
+    for (const auto& curve : curves) {
+        size_t first = glyphBandIndex(result, curve.minY - result.margin);
+        size_t last = glyphBandIndex(result, curve.maxY + result.margin);
+        for (size_t band = first; band <= last; ++band) {
+            result.curves[cursor[band]++] = {.pointOffset = curve.pointOffset, .maxX = curve.maxX};
+        }
+    }
+
+    for (size_t band = 0; band < bandCount; ++band) {
+        result.bands[band] = {.curveStart = starts[band], .curveCount = starts[band + 1] - starts[band]};
+        std::sort(
+            result.curves.begin() + starts[band],
+            result.curves.begin() + starts[band + 1],
+            [](const BandCurve& a, const BandCurve& b) { return a.maxX > b.maxX; }
+        );
+    }
+
+    return result;
 }
@@ -11,7 +11,7 @@
 #include <cmath>
 #include "freetype.hpp"
 #include "printers.hpp"
-#include "metal_imports.hpp"
+#include "simd_types.hpp"
 #include <vector>
 #include <cstdint>
 
@@ -38,12 +38,44 @@ struct Contour {
     std::vector<simd_float2> points;
 };
 
+// A curve as listed in a band: where its control points start in Glyph::points,
+// and its rightmost control point.
+struct BandCurve {
+    uint32_t pointOffset;
+    float maxX;
+};
+
+struct GlyphBand {
+    uint32_t curveStart; // into GlyphBands::curves
+    uint32_t curveCount;
+};
+
+// The glyph's curves bucketed into horizontal bands of equal height, so coverage
+// at a point only looks at the curves near its row. A curve is listed in every
+// band its control-point bounds overlap once grown by margin, so any curve within
+// margin of a point is in the point's band. Each band is sorted by maxX,
+// descending, which lets the +x ray stop at the first curve that lies wholly
+// left of the point.
+struct GlyphBands {
+    float minY{};
+    float bandHeight{};
+    float margin{};
+    std::vector<GlyphBand> bands;
+    std::vector<BandCurve> curves;
+};
+
+constexpr size_t MaxGlyphBands = 16;
+// 1/16 em in glyph units; the bands give exact coverage while a screen pixel
+// spans at most twice this
+constexpr float GlyphBandMargin = BASE_PIXEL_HEIGHT * FT_PIXEL_CF / 16.0f;
+
 struct Glyph {
     Quad quad;
     CurveType curveType{CurveType::Quadratic};
     std::vector<simd_float2> points;
     int numContours;
     std::vector<size_t> contourSizes;
+    GlyphBands bands;
     FT_Glyph_Metrics metrics;
     float lineHeight{};
 };
@@ -57,3 +89,6 @@ Contour processContour(
     CurveType curveType
 );
 Glyph processContours(FT_Face glyphMeta);
+GlyphBands buildGlyphBands(const Glyph& glyph);
+// band whose rows contain y, clamped to the first or last; bands must not be empty
+size_t glyphBandIndex(const GlyphBands& bands, float y);
@@ -0,0 +1,129 @@
+//
+//  gpu.hpp
+//  gui
+//
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Backend-neutral slice of the GPU API the elements actually use. Metal
+// implements it in gpu_metal.*, the headless null/recording backend lives in
+// gpu_headless.* so the whole update pipeline can run without a GPU.
+namespace gpu {
+    enum class PrimitiveType {
+        Triangle
+    };
+
+    enum class VertexFormat {
+        Float2,
+        Int,
+        UInt
+    };
+
+    enum class BlendFactor {
+        One,
+        SourceAlpha,
+        OneMinusSourceAlpha
+    };
+
+    enum class SamplerFilter {
+        Nearest,
+        Linear
+    };
+
+    enum class SamplerAddressMode {
+        ClampToEdge,
+        ClampToZero
+    };
+
+    struct VertexAttribute {
+        VertexFormat format;
+        size_t offset;
+        size_t bufferIndex;
+    };
+
+    struct BlendState {
+        BlendFactor sourceRGB = BlendFactor::SourceAlpha;
+        BlendFactor destinationRGB = BlendFactor::OneMinusSourceAlpha;
+        BlendFactor sourceAlpha = BlendFactor::SourceAlpha;
+        BlendFactor destinationAlpha = BlendFactor::OneMinusSourceAlpha;
+    };
+
+    struct RenderPipelineDescriptor {
+        std::string label;
+        std::string vertexFunction;
+        std::string fragmentFunction;
+        std::vector<VertexAttribute> attributes;
+        size_t stride;
+        BlendState blend;
+    };
+
+    struct SamplerDescriptor {
+        SamplerFilter filter = SamplerFilter::Linear;
+        SamplerAddressMode addressMode = SamplerAddressMode::ClampToZero;
+    };
+
+    // always RGBA8 unorm for now; that's all images and svgs upload
+    struct TextureDescriptor {
+        uint32_t width;
+        uint32_t height;
+    };
+
+    struct Buffer {
+        virtual ~Buffer() = default;
+
+        virtual void* contents() = 0;
+        virtual size_t length() const = 0;
+    };
+
+    struct RenderPipeline {
+        virtual ~RenderPipeline() = default;
+    };
+
+    struct Sampler {
+        virtual ~Sampler() = default;
+    };
+
+    struct Texture {
+        virtual ~Texture() = default;
+
+        virtual uint32_t width() const = 0;
+        virtual uint32_t height() const = 0;
+    };
+
+    // Metal's limit for set*Bytes
+    inline constexpr size_t MaxInlineBytes = 4096;
+
+    struct RenderEncoder {
+        virtual ~RenderEncoder() = default;
+
+        virtual void setRenderPipeline(RenderPipeline* pipeline) = 0;
+        virtual void setVertexBuffer(Buffer* buffer, size_t offset, size_t index) = 0;
+        virtual void setFragmentBuffer(Buffer* buffer, size_t offset, size_t index) = 0;
+        // copies length bytes (at most MaxInlineBytes) into the command stream
+        // instead of binding a buffer
+        virtual void setVertexBytes(const void* bytes, size_t length, size_t index) = 0;
+        virtual void setFragmentBytes(const void* bytes, size_t length, size_t index) = 0;
+        virtual void setFragmentTexture(Texture* texture, size_t index) = 0;
+        virtual void setFragmentSampler(Sampler* sampler, size_t index) = 0;
+        virtual void drawPrimitives(PrimitiveType type, size_t vertexStart, size_t vertexCount) = 0;
+        // instanceCount copies of the vertex range; shaders tell them apart by instance id
+        virtual void drawInstancedPrimitives(PrimitiveType type, size_t vertexStart, size_t vertexCount, size_t instanceCount) = 0;
+    };
+
+    struct Device {
+        virtual ~Device() = default;
+
+        virtual std::unique_ptr<Buffer> newBuffer(size_t length) = 0;
+        virtual std::unique_ptr<RenderPipeline> newRenderPipeline(const RenderPipelineDescriptor& descriptor) = 0;
+        virtual std::unique_ptr<Sampler> newSampler(const SamplerDescriptor& descriptor) = 0;
+        virtual std::shared_ptr<Texture> newTexture(const TextureDescriptor& descriptor, const void* pixels, size_t bytesPerRow) = 0;
+
+        // decodes the image at path, downsampled to width x height
+        virtual std::shared_ptr<Texture> loadTexture(const std::string& path, uint32_t width, uint32_t height) = 0;
+    };
+}
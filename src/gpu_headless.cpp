@@ -0,0 +1,116 @@
+#include "gpu_headless.hpp"
+
+namespace gpu {
+    HeapBuffer::HeapBuffer(size_t length):
+        storage{std::make_unique<std::byte[]>(length)},
+        size{length}
+    {}
+
+    void* HeapBuffer::contents() {
+        return storage.get();
+    }
+
+    size_t HeapBuffer::length() const {
+        return size;
+    }
+
+    HeadlessTexture::HeadlessTexture(uint32_t width, uint32_t height):
+        w{width},
+        h{height}
+    {}
+
+    uint32_t HeadlessTexture::width() const {
+        return w;
+    }
+
+    uint32_t HeadlessTexture::height() const {
+        return h;
+    }
+
+    std::unique_ptr<Buffer> HeadlessDevice::newBuffer(size_t length) {
+        buffersAllocated += 1;
+        bytesAllocated += length;
+        return std::make_unique<HeapBuffer>(length);
+    }
+
+    std::unique_ptr<RenderPipeline> HeadlessDevice::newRenderPipeline(const RenderPipelineDescriptor& descriptor) {
+        auto pipeline = std::make_unique<HeadlessRenderPipeline>();
+        pipeline->descriptor = descriptor;
+        return pipeline;
+    }
+
+    std::unique_ptr<Sampler> HeadlessDevice::newSampler(const SamplerDescriptor& descriptor) {
+        auto sampler = std::make_unique<HeadlessSampler>();
+        sampler->descriptor = descriptor;
+        return sampler;
+    }
+
+    std::shared_ptr<Texture> HeadlessDevice::newTexture(const TextureDescriptor& descriptor, const void*, size_t) {
+        return std::make_shared<HeadlessTexture>(descriptor.width, descriptor.height);
+    }
+
+    // no decoding headless; the element only cares that a texture of the requested size exists
+    std::shared_ptr<Texture> HeadlessDevice::loadTexture(const std::string&, uint32_t width, uint32_t height) {
+        return std::make_shared<HeadlessTexture>(width, height);
+    }
+
+    void RecordingRenderEncoder::setRenderPipeline(RenderPipeline* pipeline) {
+        if (pipeline != lastPipeline) {
+            pipelineChanges += 1;
+            lastPipeline = pipeline;
+        }
+        commands.push_back({.type = CommandType::SetRenderPipeline, .object = pipeline});
+    }
+
+    void RecordingRenderEncoder::setVertexBuffer(Buffer* buffer, size_t offset, size_t index) {
+        commands.push_back({.type = CommandType::SetVertexBuffer, .object = buffer, .offset = offset, .index = index});
+    }
+
+    void RecordingRenderEncoder::setFragmentBuffer(Buffer* buffer, size_t offset, size_t index) {
+        commands.push_back({.type = CommandType::SetFragmentBuffer, .object = buffer, .offset = offset, .index = index});
+    }
+
+    void RecordingRenderEncoder::setVertexBytes(const void* bytes, size_t length, size_t index) {
+        commands.push_back({.type = CommandType::SetVertexBytes, .object = bytes, .offset = length, .index = index});
+    }
+
+    void RecordingRenderEncoder::setFragmentBytes(const void* bytes, size_t length, size_t index) {
+        commands.push_back({.type = CommandType::SetFragmentBytes, .object = bytes, .offset = length, .index = index});
+    }
+
+    void RecordingRenderEncoder::setFragmentTexture(Texture* texture, size_t index) {
+        commands.push_back({.type = CommandType::SetFragmentTexture, .object = texture, .index = index});
+    }
+
+    void RecordingRenderEncoder::setFragmentSampler(Sampler* sampler, size_t index) {
+        commands.push_back({.type = CommandType::SetFragmentSampler, .object = sampler, .index = index});
+    }
+
+    void RecordingRenderEncoder::drawPrimitives(PrimitiveType, size_t vertexStart, size_t vertexCount) {
+        drawCount += 1;
+        this->vertexCount += vertexCount;
+        this->instanceCount += 1;
+        commands.push_back({.type = CommandType::DrawPrimitives, .vertexStart = vertexStart, .vertexCount = vertexCount, .instanceCount = 1});
+    }
+
+    void RecordingRenderEncoder::drawInstancedPrimitives(PrimitiveType, size_t vertexStart, size_t vertexCount, size_t instanceCount) {
+        drawCount += 1;
+        this->vertexCount += vertexCount * instanceCount;
+        this->instanceCount += instanceCount;
+        commands.push_back({
+            .type = CommandType::DrawPrimitives,
+            .vertexStart = vertexStart,
+            .vertexCount = vertexCount,
+            .instanceCount = instanceCount
+        });
+    }
+
+    void RecordingRenderEncoder::reset() {
+        commands.clear();
+        drawCount = 0;
+        vertexCount = 0;
+        instanceCount = 0;
+        pipelineChanges = 0;
+        lastPipeline = nullptr;
+    }
+}
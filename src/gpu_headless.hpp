@@ -0,0 +1,111 @@
+//
+//  gpu_headless.hpp
+//  gui
+//
+
+#pragma once
+#include "gpu.hpp"
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+// Null backend: buffers and textures are plain heap memory, pipelines and
+// samplers are empty handles. Good enough to run every phase without a GPU.
+namespace gpu {
+    struct HeapBuffer : Buffer {
+        HeapBuffer(size_t length);
+
+        void* contents() override;
+        size_t length() const override;
+
+        std::unique_ptr<std::byte[]> storage;
+        size_t size;
+    };
+
+    struct HeadlessRenderPipeline : RenderPipeline {
+        RenderPipelineDescriptor descriptor;
+    };
+
+    struct HeadlessSampler : Sampler {
+        SamplerDescriptor descriptor;
+    };
+
+    struct HeadlessTexture : Texture {
+        HeadlessTexture(uint32_t width, uint32_t height);
+
+        uint32_t width() const override;
+        uint32_t height() const override;
+
+        uint32_t w;
+        uint32_t h;
+    };
+
+    struct HeadlessDevice : Device {
+        std::unique_ptr<Buffer> newBuffer(size_t length) override;
+        std::unique_ptr<RenderPipeline> newRenderPipeline(const RenderPipelineDescriptor& descriptor) override;
+        std::unique_ptr<Sampler> newSampler(const SamplerDescriptor& descriptor) override;
+        std::shared_ptr<Texture> newTexture(const TextureDescriptor& descriptor, const void* pixels, size_t bytesPerRow) override;
+        std::shared_ptr<Texture> loadTexture(const std::string& path, uint32_t width, uint32_t height) override;
+
+        size_t buffersAllocated = 0;
+        size_t bytesAllocated = 0;
+    };
+
+    struct NullRenderEncoder : RenderEncoder {
+        void setRenderPipeline(RenderPipeline*) override {}
+        void setVertexBuffer(Buffer*, size_t, size_t) override {}
+        void setFragmentBuffer(Buffer*, size_t, size_t) override {}
+        void setVertexBytes(const void*, size_t, size_t) override {}
+        void setFragmentBytes(const void*, size_t, size_t) override {}
+        void setFragmentTexture(Texture*, size_t) override {}
+        void setFragmentSampler(Sampler*, size_t) override {}
+        void drawPrimitives(PrimitiveType, size_t, size_t) override {}
+        void drawInstancedPrimitives(PrimitiveType, size_t, size_t, size_t) override {}
+    };
+
+    enum class CommandType {
+        SetRenderPipeline,
+        SetVertexBuffer,
+        SetFragmentBuffer,
+        SetVertexBytes,
+        SetFragmentBytes,
+        SetFragmentTexture,
+        SetFragmentSampler,
+        DrawPrimitives
+    };
+
+    struct RecordedCommand {
+        CommandType type;
+        const void* object;
+        size_t offset; // byte count for Set*Bytes
+        size_t index;
+        size_t vertexStart;
+        size_t vertexCount;
+        size_t instanceCount;
+    };
+
+    // Keeps every command so tests/benchmarks can inspect the encoded stream
+    // (draw counts, pipeline switches, bound buffers) without a GPU.
+    struct RecordingRenderEncoder : RenderEncoder {
+        void setRenderPipeline(RenderPipeline* pipeline) override;
+        void setVertexBuffer(Buffer* buffer, size_t offset, size_t index) override;
+        void setFragmentBuffer(Buffer* buffer, size_t offset, size_t index) override;
+        void setVertexBytes(const void* bytes, size_t length, size_t index) override;
+        void setFragmentBytes(const void* bytes, size_t length, size_t index) override;
+        void setFragmentTexture(Texture* texture, size_t index) override;
+        void setFragmentSampler(Sampler* sampler, size_t index) override;
+        void drawPrimitives(PrimitiveType type, size_t vertexStart, size_t vertexCount) override;
+        void drawInstancedPrimitives(PrimitiveType type, size_t vertexStart, size_t vertexCount, size_t instanceCount) override;
+
+        void reset();
+
+        std::vector<RecordedCommand> commands;
+        size_t drawCount = 0;
+        size_t vertexCount = 0; // summed over instances
+        size_t instanceCount = 0;
+        size_t pipelineChanges = 0;
+
+    private:
+        const RenderPipeline* lastPipeline = nullptr;
+    };
+}
@@ -0,0 +1,234 @@
+#include "gpu_metal.hpp"
+#include <print>
+
+namespace gpu {
+    namespace {
+        MTL::VertexFormat toMetal(VertexFormat format) {
+            switch (format) {
+                case VertexFormat::Float2: return MTL::VertexFormatFloat2;
+                case VertexFormat::Int: return MTL::VertexFormatInt;
+                case VertexFormat::UInt: return MTL::VertexFormatUInt;
+            }
+            return MTL::VertexFormatInvalid;
+        }
+
+        MTL::BlendFactor toMetal(BlendFactor factor) {
+            switch (factor) {
+                case BlendFactor::One: return MTL::BlendFactorOne;
+                case BlendFactor::SourceAlpha: return MTL::BlendFactorSourceAlpha;
+                case BlendFactor::OneMinusSourceAlpha: return MTL::BlendFactorOneMinusSourceAlpha;
+            }
+            return MTL::BlendFactorOne;
+        }
+
+        MTL::Buffer* native(Buffer* buffer) {
+            return buffer ? static_cast<MetalBuffer*>(buffer)->buffer : nullptr;
+        }
+    }
+
+    MetalBuffer::MetalBuffer(MTL::Buffer* buffer):
+        buffer{buffer}
+    {}
+
+    MetalBuffer::~MetalBuffer() {
+        if (buffer) {
+            buffer->release();
+        }
+    }
+
+    void* MetalBuffer::contents() {
+        return buffer->contents();
+    }
+
+    size_t MetalBuffer::length() const {
+        return buffer->length();
+    }
+
+    MetalRenderPipeline::MetalRenderPipeline(MTL::RenderPipelineState* state):
+        state{state}
+    {}
+
+    MetalRenderPipeline::~MetalRenderPipeline() {
+        if (state) {
+            state->release();
+        }
+    }
+
+    MetalSampler::MetalSampler(MTL::SamplerState* state):
+        state{state}
+    {}
+
+    MetalSampler::~MetalSampler() {
+        if (state) {
+            state->release();
+        }
+    }
+
+    MetalTexture::MetalTexture(NS::SharedPtr<MTL::Texture> texture):
+        texture{std::move(texture)}
+    {}
+
+    uint32_t MetalTexture::width() const {
+        return static_cast<uint32_t>(texture->width());
+    }
+
+    uint32_t MetalTexture::height() const {
+        return static_cast<uint32_t>(texture->height());
+    }
+
+    MetalDevice::MetalDevice(MTL::Device* device, MTK::View* view):
+        device{device},
+        view{view}
+    {}
+
+    std::unique_ptr<Buffer> MetalDevice::newBuffer(size_t length) {
+        return std::make_unique<MetalBuffer>(device->newBuffer(length, MTL::ResourceStorageModeShared));
+    }
+
+    std::unique_ptr<RenderPipeline> MetalDevice::newRenderPipeline(const RenderPipelineDescriptor& descriptor) {
+        MTL::Library* defaultLibrary = device->newDefaultLibrary();
+        MTL::RenderPipelineDescriptor* renderPipelineDescriptor = MTL::RenderPipelineDescriptor::alloc()->init();
+
+        // set up vertex descriptor; pipelines without attributes fetch their own vertices
+        MTL::VertexDescriptor* vertexDescriptor = MTL::VertexDescriptor::alloc()->init();
+        if (!descriptor.attributes.empty()) {
+            for (size_t i = 0; i < descriptor.attributes.size(); ++i) {
+                auto& attribute = descriptor.attributes[i];
+                vertexDescriptor->attributes()->object(i)->setFormat(toMetal(attribute.format));
+                vertexDescriptor->attributes()->object(i)->setOffset(attribute.offset);
+                vertexDescriptor->attributes()->object(i)->setBufferIndex(attribute.bufferIndex);
+            }
+            vertexDescriptor->layouts()->object(0)->setStride(descriptor.stride);
+            renderPipelineDescriptor->setVertexDescriptor(vertexDescriptor);
+        }
+
+        MTL::Function* vertexFunction = defaultLibrary->newFunction(NS::String::string(descriptor.vertexFunction.c_str(), NS::UTF8StringEncoding));
+        renderPipelineDescriptor->setVertexFunction(vertexFunction);
+
+        MTL::Function* fragmentFunction = defaultLibrary->newFunction(NS::String::string(descriptor.fragmentFunction.c_str(), NS::UTF8StringEncoding));
+        renderPipelineDescriptor->setFragmentFunction(fragmentFunction);
+
+        // color attachments
+        auto* colorAttachment = renderPipelineDescriptor->colorAttachments()->object(0);
+        colorAttachment->setPixelFormat(view->colorPixelFormat());
+        colorAttachment->setBlendingEnabled(true);
+        colorAttachment->setAlphaBlendOperation(MTL::BlendOperationAdd);
+        colorAttachment->setSourceRGBBlendFactor(toMetal(descriptor.blend.sourceRGB));
+        colorAttachment->setDestinationRGBBlendFactor(toMetal(descriptor.blend.destinationRGB));
+        colorAttachment->setSourceAlphaBlendFactor(toMetal(descriptor.blend.sourceAlpha));
+        colorAttachment->setDestinationAlphaBlendFactor(toMetal(descriptor.blend.destinationAlpha));
+
+        renderPipelineDescriptor->setDepthAttachmentPixelFormat(view->depthStencilPixelFormat());
+
+        NS::Error* error = nullptr;
+        MTL::RenderPipelineState* state = device->newRenderPipelineState(renderPipelineDescriptor, &error);
+
+        if (error != nullptr)
+            std::println("error in {} pipeline creation: {}", descriptor.label, error->localizedDescription()->utf8String());
+
+        defaultLibrary->release();
+        renderPipelineDescriptor->release();
+        vertexDescriptor->release();
+        if (vertexFunction) vertexFunction->release();
+        if (fragmentFunction) fragmentFunction->release();
+
+        return std::make_unique<MetalRenderPipeline>(state);
+    }
+
+    std::unique_ptr<Sampler> MetalDevice::newSampler(const SamplerDescriptor& descriptor) {
+        auto filter = descriptor.filter == SamplerFilter::Linear
+            ? MTL::SamplerMinMagFilterLinear
+            : MTL::SamplerMinMagFilterNearest;
+        auto addressMode = descriptor.addressMode == SamplerAddressMode::ClampToZero
+            ? MTL::SamplerAddressModeClampToZero
+            : MTL::SamplerAddressModeClampToEdge;
+
+        MTL::SamplerDescriptor* samplerDescriptor = MTL::SamplerDescriptor::alloc()->init();
+        samplerDescriptor->setNormalizedCoordinates(true);
+        samplerDescriptor->setMagFilter(filter);
+        samplerDescriptor->setMinFilter(filter);
+        samplerDescriptor->setSAddressMode(addressMode);
+        samplerDescriptor->setTAddressMode(addressMode);
+        auto* state = device->newSamplerState(samplerDescriptor);
+        samplerDescriptor->release();
+
+        return std::make_unique<MetalSampler>(state);
+    }
+
+    std::shared_ptr<Texture> MetalDevice::newTexture(const TextureDescriptor& descriptor, const void* pixels, size_t bytesPerRow) {
+        auto* desc = MTL::TextureDescriptor::texture2DDescriptor(
+            MTL::PixelFormatRGBA8Unorm,
+            descriptor.width, descriptor.height, false
+        );
+        desc->setUsage(MTL::TextureUsageShaderRead);
+        desc->setStorageMode(MTL::StorageModeShared);
+
+        auto texture = NS::TransferPtr(device->newTexture(desc));
+        if (!texture) return nullptr;
+
+        if (pixels) {
+            MTL::Region region = MTL::Region::Make2D(0, 0, descriptor.width, descriptor.height);
+            texture->replaceRegion(region, 0, pixels, bytesPerRow);
+        }
+
+        return std::make_shared<MetalTexture>(std::move(texture));
+    }
+
+    std::shared_ptr<Texture> MetalDevice::loadTexture(const std::string& path, uint32_t width, uint32_t height) {
+        if (!textureLoader) {
+            textureLoader.emplace(device);
+        }
+
+        auto texture = NS::TransferPtr(
+            MTKTextures::createDownsampledTexture(*textureLoader, path, width, height)
+        );
+        if (!texture) return nullptr;
+
+        return std::make_shared<MetalTexture>(std::move(texture));
+    }
+
+    MetalRenderEncoder::MetalRenderEncoder(MTL::RenderCommandEncoder* encoder):
+        encoder{encoder}
+    {}
+
+    void MetalRenderEncoder::setRenderPipeline(RenderPipeline* pipeline) {
+        encoder->setRenderPipelineState(static_cast<MetalRenderPipeline*>(pipeline)->state);
+    }
+
+    void MetalRenderEncoder::setVertexBuffer(Buffer* buffer, size_t offset, size_t index) {
+        encoder->setVertexBuffer(native(buffer), offset, index);
+    }
+
+    void MetalRenderEncoder::setFragmentBuffer(Buffer* buffer, size_t offset, size_t index) {
+        encoder->setFragmentBuffer(native(buffer), offset, index);
+    }
+
+    void MetalRenderEncoder::setVertexBytes(const void* bytes, size_t length, size_t index) {
+        encoder->setVertexBytes(bytes, NS::UInteger(length), NS::UInteger(index));
+    }
+
+    void MetalRenderEncoder::setFragmentBytes(const void* bytes, size_t length, size_t index) {
+        encoder->setFragmentBytes(bytes, NS::UInteger(length), NS::UInteger(index));
+    }
+
+    void MetalRenderEncoder::setFragmentTexture(Texture* texture, size_t index) {
+        encoder->setFragmentTexture(texture ? static_cast<MetalTexture*>(texture)->texture.get() : nullptr, index);
+    }
+
+    void MetalRenderEncoder::setFragmentSampler(Sampler* sampler, size_t index) {
+        encoder->setFragmentSamplerState(sampler ? static_cast<MetalSampler*>(sampler)->state : nullptr, index);
+    }
+
+    void MetalRenderEncoder::drawPrimitives(PrimitiveType, size_t vertexStart, size_t vertexCount) {
+        encoder->drawPrimitives(MTL::PrimitiveTypeTriangle, NS::UInteger(vertexStart), NS::UInteger(vertexCount));
+    }
+
+    void MetalRenderEncoder::drawInstancedPrimitives(PrimitiveType, size_t vertexStart, size_t vertexCount, size_t instanceCount) {
+        encoder->drawPrimitives(
+            MTL::PrimitiveTypeTriangle,
+            NS::UInteger(vertexStart),
+            NS::UInteger(vertexCount),
+            NS::UInteger(instanceCount)
+        );
+    }
+}
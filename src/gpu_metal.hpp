@@ -0,0 +1,75 @@
+//
+//  gpu_metal.hpp
+//  gui
+//
+
+#pragma once
+#include "gpu.hpp"
+#include "metal_imports.hpp"
+#include "MTKTexture_loader.hpp"
+#include <optional>
+
+namespace gpu {
+    struct MetalBuffer : Buffer {
+        MetalBuffer(MTL::Buffer* buffer);
+        ~MetalBuffer();
+
+        void* contents() override;
+        size_t length() const override;
+
+        MTL::Buffer* buffer;
+    };
+
+    struct MetalRenderPipeline : RenderPipeline {
+        MetalRenderPipeline(MTL::RenderPipelineState* state);
+        ~MetalRenderPipeline();
+
+        MTL::RenderPipelineState* state;
+    };
+
+    struct MetalSampler : Sampler {
+        MetalSampler(MTL::SamplerState* state);
+        ~MetalSampler();
+
+        MTL::SamplerState* state;
+    };
+
+    struct MetalTexture : Texture {
+        MetalTexture(NS::SharedPtr<MTL::Texture> texture);
+
+        uint32_t width() const override;
+        uint32_t height() const override;
+
+        NS::SharedPtr<MTL::Texture> texture;
+    };
+
+    struct MetalDevice : Device {
+        MetalDevice(MTL::Device* device, MTK::View* view);
+
+        std::unique_ptr<Buffer> newBuffer(size_t length) override;
+        std::unique_ptr<RenderPipeline> newRenderPipeline(const RenderPipelineDescriptor& descriptor) override;
+        std::unique_ptr<Sampler> newSampler(const SamplerDescriptor& descriptor) override;
+        std::shared_ptr<Texture> newTexture(const TextureDescriptor& descriptor, const void* pixels, size_t bytesPerRow) override;
+        std::shared_ptr<Texture> loadTexture(const std::string& path, uint32_t width, uint32_t height) override;
+
+        MTL::Device* device;
+        MTK::View* view;
+        std::optional<MTKTextures::MTKTextureLoader> textureLoader;
+    };
+
+    struct MetalRenderEncoder : RenderEncoder {
+        MetalRenderEncoder(MTL::RenderCommandEncoder* encoder);
+
+        void setRenderPipeline(RenderPipeline* pipeline) override;
+        void setVertexBuffer(Buffer* buffer, size_t offset, size_t index) override;
+        void setFragmentBuffer(Buffer* buffer, size_t offset, size_t index) override;
+        void setVertexBytes(const void* bytes, size_t length, size_t index) override;
+        void setFragmentBytes(const void* bytes, size_t length, size_t index) override;
+        void setFragmentTexture(Texture* texture, size_t index) override;
+        void setFragmentSampler(Sampler* sampler, size_t index) override;
+        void drawPrimitives(PrimitiveType type, size_t vertexStart, size_t vertexCount) override;
+        void drawInstancedPrimitives(PrimitiveType type, size_t vertexStart, size_t vertexCount, size_t instanceCount) override;
+
+        MTL::RenderCommandEncoder* encoder;
+    };
+}
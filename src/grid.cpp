@@ -488,7 +488,9 @@ namespace layout {
     }
 
     GridResolver::Bounds GridResolver::phaseC() {
-        for (size_t pi = 0; pi < inFlowIndices.size(); ++pi) {
+        // tracks are sized, so every item's cell is known and each subtree lays out on its own
+        std::vector<Bounds> itemBounds(inFlowIndices.size());
+        tree.layoutIndependent(inFlowIndices.size(), [&](size_t pi) {
             size_t i = inFlowIndices[pi];
             auto childAsPtr = node->children[i].get();
             auto& item = gridLayout.items[pi];
@@ -606,8 +608,15 @@ namespace layout {
 
             const auto& childLayout = childOutput->layout;
 
-            maxX = std::max(maxX, childLayout.computedBox.x + childLayout.computedBox.width);
-            maxY = std::max(maxY, childLayout.computedBox.y + childLayout.consumedHeight);
+            itemBounds[pi] = {
+                childLayout.computedBox.x + childLayout.computedBox.width,
+                childLayout.computedBox.y + childLayout.consumedHeight
+            };
+        });
+
+        for (const auto& bounds : itemBounds) {
+            maxX = std::max(maxX, bounds.maxX);
+            maxY = std::max(maxY, bounds.maxY);
         }
 
         return {maxX, maxY};
@@ -0,0 +1,188 @@
+#include "hit_test_index.hpp"
+#include <algorithm>
+#include <cmath>
+#include <functional>
+
+namespace tree {
+    namespace {
+        constexpr uint32_t MaxGridSide = 128;
+        constexpr uint32_t MinLargeCellSpan = 16;
+    }
+
+    void HitTestIndex::clear() {
+        entries.clear();
+        grids.clear();
+    }
+
+    uint32_t HitTestIndex::cellIndex(float value, float origin, float size, uint32_t count) {
+        float cell = std::floor((value - origin) / size);
+        if (!(cell > 0.0f)) return 0;
+        return std::min(static_cast<uint32_t>(cell), count - 1);
+    }
+
+    bool HitTestIndex::entryContains(const Entry& entry, simd_float2 point) {
+        return point.x >= entry.min.x && point.x <= entry.max.x &&
+            point.y >= entry.min.y && point.y <= entry.max.y;
+    }
+
+    bool HitTestIndex::clippedBounds(const LayoutResult& layout, simd_float2& min, simd_float2& max) {
+        auto& box = layout.computedBox;
+        min = {box.x, box.y};
+        max = {box.x + box.width, box.y + box.height};
+
+        // anything outside a clip's bounding rect fails contains() anyway
+        for (auto& clip : layout.clipUniforms) {
+            if (clip.scrollLayer != layout.scrollLayer) continue;
+            min.x = std::max(min.x, clip.rectCenter.x - clip.halfExtent.x);
+            min.y = std::max(min.y, clip.rectCenter.y - clip.halfExtent.y);
+            max.x = std::min(max.x, clip.rectCenter.x + clip.halfExtent.x);
+            max.y = std::min(max.y, clip.rectCenter.y + clip.halfExtent.y);
+        }
+        return min.x <= max.x && min.y <= max.y;
+    }
+
+    void HitTestIndex::build(const std::vector<TreeNode*>& renderOrder) {
+        clear();
+        entries.reserve(renderOrder.size());
+
+        // entries per scroll layer, each list in paint order
+        std::vector<std::vector<uint32_t>> layerMembers;
+        for (auto* node : renderOrder) {
+            if (!node->layout.has_value()) continue;
+            simd_float2 min;
+            simd_float2 max;
+            if (!clippedBounds(*node->layout, min, max)) continue;
+
+            uint32_t layer = node->layout->scrollLayer;
+            if (layer >= layerMembers.size()) layerMembers.resize(layer + 1);
+            layerMembers[layer].push_back(static_cast<uint32_t>(entries.size()));
+            entries.push_back({.node = node, .min = min, .max = max});
+        }
+
+        for (uint32_t layer = 0; layer < layerMembers.size(); ++layer) {
+            if (layerMembers[layer].empty()) continue;
+            auto& grid = grids.emplace_back();
+            grid.scrollLayer = layer;
+            buildGrid(grid, layerMembers[layer]);
+        }
+    }
+
+    void HitTestIndex::buildGrid(Grid& grid, const std::vector<uint32_t>& members) {
+        simd_float2 boundsMin{INFINITY, INFINITY};
+        simd_float2 boundsMax{-INFINITY, -INFINITY};
+        for (uint32_t index : members) {
+            auto& entry = entries[index];
+            boundsMin.x = std::min(boundsMin.x, entry.min.x);
+            boundsMin.y = std::min(boundsMin.y, entry.min.y);
+            boundsMax.x = std::max(boundsMax.x, entry.max.x);
+            boundsMax.y = std::max(boundsMax.y, entry.max.y);
+        }
+
+        // roughly one cell per node, capped so sparse huge trees don't blow up
+        // memory, and shaped like the bounds: a scroller's content is one tall
+        // column of rows that a square grid would lump together
+        auto cells = static_cast<double>(std::min<size_t>(members.size(), MaxGridSide * MaxGridSide));
+        double aspect = std::max(boundsMax.x - boundsMin.x, 1.0f) / std::max(boundsMax.y - boundsMin.y, 1.0f);
+        grid.columns = static_cast<uint32_t>(std::clamp(std::ceil(std::sqrt(cells * aspect)), 1.0, cells));
+        grid.rows = static_cast<uint32_t>(std::clamp(std::ceil(cells / grid.columns), 1.0, cells));
+        grid.origin = boundsMin;
+        grid.cellSize = {
+            std::max((boundsMax.x - boundsMin.x) / static_cast<float>(grid.columns), 1.0f),
+            std::max((boundsMax.y - boundsMin.y) / static_cast<float>(grid.rows), 1.0f)
+        };
+
+        uint32_t cellCount = grid.columns * grid.rows;
+        uint32_t largeSpan = std::max(MinLargeCellSpan, cellCount / 16);
+
+        struct Span {
+            uint32_t x0, y0, x1, y1;
+        };
+        std::vector<Span> spans(members.size());
+        std::vector<bool> large(members.size());
+        grid.cellStarts.assign(cellCount + 1, 0);
+
+        // counting pass
+        for (uint32_t i = 0; i < members.size(); ++i) {
+            auto& entry = entries[members[i]];
+            Span span {
+                cellIndex(entry.min.x, grid.origin.x, grid.cellSize.x, grid.columns),
+                cellIndex(entry.min.y, grid.origin.y, grid.cellSize.y, grid.rows),
+                cellIndex(entry.max.x, grid.origin.x, grid.cellSize.x, grid.columns),
+                cellIndex(entry.max.y, grid.origin.y, grid.cellSize.y, grid.rows)
+            };
+            spans[i] = span;
+
+            if ((span.x1 - span.x0 + 1) * (span.y1 - span.y0 + 1) > largeSpan) {
+                grid.largeEntries.push_back(members[i]);
+                large[i] = true;
+                continue;
+            }
+            for (uint32_t y = span.y0; y <= span.y1; ++y) {
+                for (uint32_t x = span.x0; x <= span.x1; ++x) {
+                    grid.cellStarts[y * grid.columns + x + 1]++;
+                }
+            }
+        }
+        for (uint32_t c = 0; c < cellCount; ++c) {
+            grid.cellStarts[c + 1] += grid.cellStarts[c];
+        }
+
+        // fill pass; members are in paint order so every cell ends up sorted
+        grid.cellEntries.resize(grid.cellStarts[cellCount]);
+        std::vector<uint32_t> cursor(grid.cellStarts.begin(), grid.cellStarts.end() - 1);
+        for (uint32_t i = 0; i < members.size(); ++i) {
+            if (large[i]) continue;
+            auto& span = spans[i];
+            for (uint32_t y = span.y0; y <= span.y1; ++y) {
+                for (uint32_t x = span.x0; x <= span.x1; ++x) {
+                    grid.cellEntries[cursor[y * grid.columns + x]++] = members[i];
+                }
+            }
+        }
+    }
+
+    void HitTestIndex::queryGrid(const Grid& grid, simd_float2 point, std::vector<uint32_t>& out) const {
+        float maxX = grid.origin.x + grid.cellSize.x * static_cast<float>(grid.columns);
+        float maxY = grid.origin.y + grid.cellSize.y * static_cast<float>(grid.rows);
+        if (point.x < grid.origin.x || point.y < grid.origin.y || point.x > maxX || point.y > maxY) return;
+
+        uint32_t cell = cellIndex(point.y, grid.origin.y, grid.cellSize.y, grid.rows) * grid.columns +
+            cellIndex(point.x, grid.origin.x, grid.cellSize.x, grid.columns);
+
+        // merge the cell's list with the large list, both ascending in paint order,
+        // walking back to front
+        auto cellIt = grid.cellEntries.begin() + grid.cellStarts[cell + 1];
+        auto cellBegin = grid.cellEntries.begin() + grid.cellStarts[cell];
+        auto largeIt = grid.largeEntries.end();
+        while (cellIt != cellBegin || largeIt != grid.largeEntries.begin()) {
+            uint32_t index;
+            if (largeIt == grid.largeEntries.begin() ||
+                (cellIt != cellBegin && *(cellIt - 1) > *(largeIt - 1))) {
+                index = *--cellIt;
+            } else {
+                index = *--largeIt;
+            }
+
+            if (entryContains(entries[index], point)) {
+                out.push_back(index);
+            }
+        }
+    }
+
+    void HitTestIndex::candidates(simd_float2 point, std::span<const simd_float2> scrollTranslations,
+                                  std::vector<TreeNode*>& out) const {
+        out.clear();
+        hits.clear();
+        for (auto& grid : grids) {
+            queryGrid(grid, point - scrollTranslation(scrollTranslations, grid.scrollLayer), hits);
+        }
+        // each grid's hits are topmost first already; interleave them when
+        // more than one layer has something under the point
+        if (grids.size() > 1) {
+            std::ranges::sort(hits, std::greater{});
+        }
+        for (uint32_t index : hits) {
+            out.push_back(entries[index].node);
+        }
+    }
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "element.hpp"
+#include "simd_types.hpp"
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace tree {
+    // Uniform grids over the computedBoxes (trimmed by each node's clip rects),
+    // one per scroll layer, rebuilt lazily after postLayout or a paint-order
+    // change. Boxes stay in layer space, so scrolling never rebuilds a grid: a
+    // query moves the point into each layer instead. Cells list nodes in paint
+    // order, so a point query only looks at what actually overlaps it and can
+    // hand candidates back topmost first.
+    class HitTestIndex {
+    public:
+        void build(const std::vector<TreeNode*>& renderOrder);
+        void clear();
+
+        // Nodes whose box contains point, topmost first, with each scroll layer
+        // moved by its entry in scrollTranslations. The caller still runs
+        // TreeNode::contains for rounded clips and preciseHitTest.
+        void candidates(simd_float2 point, std::span<const simd_float2> scrollTranslations,
+                        std::vector<TreeNode*>& out) const;
+
+        // the node's computedBox trimmed to the bounding rects of the clips in
+        // its own scroll layer; false when nothing is left. Clips in other
+        // layers move against the box, so they're left to contains().
+        static bool clippedBounds(const LayoutResult& layout, simd_float2& min, simd_float2& max);
+
+    private:
+        struct Entry {
+            TreeNode* node;
+            simd_float2 min;
+            simd_float2 max;
+        };
+
+        struct Grid {
+            uint32_t scrollLayer{0};
+            simd_float2 origin{0.0f, 0.0f};
+            simd_float2 cellSize{1.0f, 1.0f};
+            uint32_t columns{0};
+            uint32_t rows{0};
+
+            std::vector<uint32_t> cellStarts; // columns * rows + 1 offsets into cellEntries
+            std::vector<uint32_t> cellEntries; // indices into entries
+            // boxes covering a large share of the grid (roots, page containers) live
+            // here once instead of in every cell
+            std::vector<uint32_t> largeEntries;
+        };
+
+        static uint32_t cellIndex(float value, float origin, float size, uint32_t count);
+        static bool entryContains(const Entry& entry, simd_float2 point);
+        void buildGrid(Grid& grid, const std::vector<uint32_t>& members);
+        // appends the entries of grid containing point, topmost first
+        void queryGrid(const Grid& grid, simd_float2 point, std::vector<uint32_t>& out) const;
+
+        std::vector<Entry> entries; // paint order, back to front
+        std::vector<Grid> grids;
+        mutable std::vector<uint32_t> hits; // scratch for candidates()
+    };
+}
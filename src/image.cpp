@@ -26,23 +26,20 @@ uint32_t elements::ImageCache::quantize(float value) {
     return std::max(bucket, BucketSize);
 }
 
-NS::SharedPtr<MTL::Texture> elements::ImageCache::retrieveTexture(
+std::shared_ptr<gpu::Texture> elements::ImageCache::retrieveTexture(
     const std::shared_ptr<ImageAsset>& asset,
     ImageRenditionKey renditionKey,
-    const MTKTextures::MTKTextureLoader& textureLoader
+    gpu::Device& device
 ) {
     std::lock_guard lock(asset->renditionMutex);
     if (auto found = asset->renditions.find(renditionKey); found != asset->renditions.end()) {
         return found->second;
     }
 
-    auto texture = NS::TransferPtr(
-        MTKTextures::createDownsampledTexture(
-            textureLoader,
-            asset->path,
-            renditionKey.first,
-            renditionKey.second
-        )
+    auto texture = device.loadTexture(
+        asset->path,
+        renditionKey.first,
+        renditionKey.second
     );
 
     auto [rendition, _] = asset->renditions.emplace(renditionKey, texture);
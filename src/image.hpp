@@ -7,17 +7,16 @@
 
 #pragma once
 #include "fragment_types.hpp"
-#include "frame_buffered_buffer.hpp"
+#include "frame_arena.hpp"
 #include "element.hpp"
 #include "renderer_constants.hpp"
-#include "MTKTexture_loader.hpp"
 #include <cmath>
 #include <format>
 #include <map>
 #include <mutex>
 #include <optional>
 #include <shared_mutex>
-#include <simd/vector_types.h>
+#include "simd_types.hpp"
 #include "new_arch.hpp"
 #include <any>
 #include <unordered_map>
@@ -71,6 +70,7 @@ namespace elements {
         ImageStyleUniforms style;
         ImageGeometryUniforms geometry;
         uint32_t numClips;
+        uint32_t scrollLayer; // see LayoutResult::scrollLayer
     };
 
     using ImageRenditionKey = std::pair<uint32_t, uint32_t>;
@@ -78,15 +78,15 @@ namespace elements {
     struct ImageAsset {
         std::string path;
         std::mutex renditionMutex;
-        std::map<ImageRenditionKey, NS::SharedPtr<MTL::Texture>> renditions;
+        std::map<ImageRenditionKey, std::shared_ptr<gpu::Texture>> renditions;
     };
 
     struct ImageCache {
         std::shared_ptr<ImageAsset> retrieve(const std::string& path);
-        NS::SharedPtr<MTL::Texture> retrieveTexture(
+        std::shared_ptr<gpu::Texture> retrieveTexture(
             const std::shared_ptr<ImageAsset>& asset,
             ImageRenditionKey renditionKey,
-            const MTKTextures::MTKTextureLoader& textureLoader
+            gpu::Device& device
         );
 
         static constexpr uint32_t BucketSize = 64;
@@ -97,19 +97,14 @@ namespace elements {
     };
 
     struct ImageStorage {
-        ImageStorage(UIContext& ctx):
-            atomsBuffer{ctx.allocator, 6*sizeof(ImagePoint), MaxOutstandingFrameCount},
-            placementsBuffer{ctx.allocator, sizeof(simd_float2), MaxOutstandingFrameCount},
-            uniformsBuffer{ctx.allocator, 6*sizeof(ImageUniforms), MaxOutstandingFrameCount},
-            clipsBuffer{ctx.allocator, sizeof(ClipUniform) * 4, MaxOutstandingFrameCount}
-        {}
+        ImageStorage(UIContext&) {}
 
-        FrameBufferedBuffer<ImagePoint> atomsBuffer;
-        FrameBufferedBuffer<simd_float2> placementsBuffer;
-        FrameBufferedBuffer<ImageUniforms> uniformsBuffer;
-        FrameBufferedBuffer<ClipUniform> clipsBuffer;
+        FrameData<ImagePoint> atomsBuffer;
+        FrameData<simd_float2> placementsBuffer;
+        FrameData<ImageUniforms> uniformsBuffer;
+        FrameData<ClipUniform> clipsBuffer;
         std::shared_ptr<ImageAsset> asset;
-        NS::SharedPtr<MTL::Texture> activeTexture;
+        std::shared_ptr<gpu::Texture> activeTexture;
         std::optional<ImageRenditionKey> activeRendition;
     };
 
@@ -158,90 +153,44 @@ namespace elements {
             ctx{ctx}
         {}
 
-        void buildPipeline(MTL::RenderPipelineState*& pipeline)
+        std::unique_ptr<gpu::RenderPipeline> buildPipeline()
         {
-            MTL::Library* defaultLibrary = ctx.device->newDefaultLibrary();
-            MTL::RenderPipelineDescriptor* renderPipelineDescriptor =
-                MTL::RenderPipelineDescriptor::alloc()->init();
-
-            MTL::VertexDescriptor* vertexDescriptor = MTL::VertexDescriptor::alloc()->init();
-
-            vertexDescriptor->attributes()->object(0)->setFormat(MTL::VertexFormatFloat2);
-            vertexDescriptor->attributes()->object(0)->setOffset(0);
-            vertexDescriptor->attributes()->object(0)->setBufferIndex(0);
-
-            vertexDescriptor->attributes()->object(1)->setFormat(MTL::VertexFormatFloat2);
-            vertexDescriptor->attributes()->object(1)->setOffset(sizeof(simd_float2));
-            vertexDescriptor->attributes()->object(1)->setBufferIndex(0);
-
-            vertexDescriptor->attributes()->object(2)->setFormat(MTL::VertexFormatUInt);
-            vertexDescriptor->attributes()->object(2)->setOffset(sizeof(simd_float2) * 2);
-            vertexDescriptor->attributes()->object(2)->setBufferIndex(0);
-
-            vertexDescriptor->layouts()->object(0)->setStride(sizeof(ImagePoint));
-            renderPipelineDescriptor->setVertexDescriptor(vertexDescriptor);
-
-            MTL::Function* vertexFunction =
-                defaultLibrary->newFunction(NS::String::string("vertex_image", NS::UTF8StringEncoding));
-            renderPipelineDescriptor->setVertexFunction(vertexFunction);
-
-            MTL::Function* fragmentFunction =
-                defaultLibrary->newFunction(NS::String::string("fragment_image", NS::UTF8StringEncoding));
-            renderPipelineDescriptor->setFragmentFunction(fragmentFunction);
-
-            renderPipelineDescriptor->colorAttachments()->object(0)->setPixelFormat(ctx.view->colorPixelFormat());
-            renderPipelineDescriptor->colorAttachments()->object(0)->setBlendingEnabled(true);
-            renderPipelineDescriptor->colorAttachments()->object(0)->setAlphaBlendOperation(MTL::BlendOperationAdd);
-            renderPipelineDescriptor->colorAttachments()->object(0)->setSourceRGBBlendFactor(MTL::BlendFactorSourceAlpha);
-            renderPipelineDescriptor->colorAttachments()->object(0)->setDestinationRGBBlendFactor(MTL::BlendFactorOneMinusSourceAlpha);
-            renderPipelineDescriptor->colorAttachments()->object(0)->setSourceAlphaBlendFactor(MTL::BlendFactorSourceAlpha);
-            renderPipelineDescriptor->colorAttachments()->object(0)->setDestinationAlphaBlendFactor(MTL::BlendFactorOneMinusSourceAlpha);
-
-            renderPipelineDescriptor->setDepthAttachmentPixelFormat(ctx.view->depthStencilPixelFormat());
-
-            NS::Error* error = nullptr;
-            pipeline = ctx.device->newRenderPipelineState(renderPipelineDescriptor, &error);
-            if (error != nullptr)
-                std::println("error in image pipeline creation: {}", error->localizedDescription()->utf8String());
-
-            defaultLibrary->release();
-            renderPipelineDescriptor->release();
-            vertexDescriptor->release();
-            vertexFunction->release();
-            fragmentFunction->release();
+            gpu::RenderPipelineDescriptor descriptor {
+                .label = "image",
+                .vertexFunction = "vertex_image",
+                .fragmentFunction = "fragment_image",
+                .attributes = {
+                    {gpu::VertexFormat::Float2, 0, 0},
+                    {gpu::VertexFormat::Float2, sizeof(simd_float2), 0},
+                    {gpu::VertexFormat::UInt, sizeof(simd_float2) * 2, 0},
+                },
+                .stride = sizeof(ImagePoint),
+                .blend = {}
+            };
+
+            return ctx.device->newRenderPipeline(descriptor);
         }
 
-        MTL::RenderPipelineState* getPipeline() {
+        gpu::RenderPipeline* getPipeline() {
             static std::once_flag initFlag;
-            static MTL::RenderPipelineState* pipeline = nullptr;
+            static std::unique_ptr<gpu::RenderPipeline> pipeline;
         
             std::call_once(initFlag, [&](){
-                buildPipeline(pipeline);
+                pipeline = buildPipeline();
             });
         
-            return pipeline;
-        }
-
-        void buildSampler(MTL::SamplerState*& samplerState) {
-            MTL::SamplerDescriptor* samplerDescriptor = MTL::SamplerDescriptor::alloc()->init();
-            samplerDescriptor->setNormalizedCoordinates(true);
-            samplerDescriptor->setMagFilter(MTL::SamplerMinMagFilterLinear);
-            samplerDescriptor->setMinFilter(MTL::SamplerMinMagFilterLinear);
-            samplerDescriptor->setSAddressMode(MTL::SamplerAddressMode::SamplerAddressModeClampToZero);
-            samplerDescriptor->setTAddressMode(MTL::SamplerAddressMode::SamplerAddressModeClampToZero);
-            samplerState = ctx.device->newSamplerState(samplerDescriptor);
-            samplerDescriptor->release();
+            return pipeline.get();
         }
 
-        MTL::SamplerState* getSampler() {
-            static MTL::SamplerState* sampler = nullptr;
-            if (!sampler) buildSampler(sampler);
-            return sampler;
-        }
-        
-        MTKTextures::MTKTextureLoader& getTextureLoader() {
-            static auto textureLoader = MTKTextures::MTKTextureLoader{ctx.device};
-            return textureLoader;
+        gpu::Sampler* getSampler() {
+            static std::unique_ptr<gpu::Sampler> sampler;
+            if (!sampler) {
+                sampler = ctx.device->newSampler({
+                    .filter = gpu::SamplerFilter::Linear,
+                    .addressMode = gpu::SamplerAddressMode::ClampToZero
+                });
+            }
+            return sampler.get();
         }
 
 
@@ -262,7 +211,7 @@ namespace elements {
             storage.activeTexture = imageCache.retrieveTexture(
                 storage.asset,
                 renditionKey,
-                getTextureLoader()
+                *ctx.device
             );
             storage.activeRendition = renditionKey;
         }
@@ -318,10 +267,9 @@ namespace elements {
             }};
 
             // std::memcpy(atomsBuffer->contents(), points.data(), bufferLen);
-            fragment.fragmentStorage.atomsBuffer.write(ctx.frameIndex, points.data(), bufferLen);
+            fragment.fragmentStorage.atomsBuffer.write(points.data(), bufferLen);
 
             Atom atom;
-            atom.atomBufferHandle = fragment.fragmentStorage.atomsBuffer.getBufferHandle(ctx.frameIndex);
             atom.offset = 0;
             atom.length = bufferLen;
             atom.width = width;
@@ -364,10 +312,9 @@ namespace elements {
                 {{width, height},  {1, 1}, 0}
             }};
             
-            fragment.fragmentStorage.atomsBuffer.write(ctx.frameIndex, atomPoints.data(), bufferLen);
+            fragment.fragmentStorage.atomsBuffer.write(atomPoints.data(), bufferLen);
             
             Atom atom;
-            atom.atomBufferHandle = fragment.fragmentStorage.atomsBuffer.getBufferHandle(ctx.frameIndex);
             atom.offset = 0;
             atom.length = bufferLen;
             atom.width = width;
@@ -388,12 +335,11 @@ namespace elements {
         
             size_t bufferLen = offsets.size() * sizeof(simd_float2);
             if (bufferLen > 0) {
-                fragment.fragmentStorage.placementsBuffer.write(ctx.frameIndex, offsets.data(), bufferLen);
+                fragment.fragmentStorage.placementsBuffer.write(offsets.data(), bufferLen);
             }
 
             for (int i = 0; i < offsets.size(); ++i) {
                 placements.push_back({
-                    .placementBufferHandle = fragment.fragmentStorage.placementsBuffer.getBufferHandle(ctx.frameIndex),
                     .x = offsets[i].x,
                     .y = offsets[i].y
                 });
@@ -434,12 +380,12 @@ namespace elements {
             ImageUniforms uniforms {
                 .style = styleUniforms,
                 .geometry = geometryUniforms,
-                .numClips = static_cast<uint32_t>(layout.clipUniforms.size())
+                .numClips = static_cast<uint32_t>(layout.clipUniforms.size()),
+                .scrollLayer = layout.scrollLayer
             };
 
-            fragment.fragmentStorage.uniformsBuffer.write(ctx.frameIndex, &uniforms, sizeof(ImageUniforms));
+            fragment.fragmentStorage.uniformsBuffer.write(&uniforms, sizeof(ImageUniforms));
             fragment.fragmentStorage.clipsBuffer.write(
-                ctx.frameIndex,
                 layout.clipUniforms.data(),
                 sizeof(ClipUniform) * layout.clipUniforms.size()
             );
@@ -451,31 +397,32 @@ namespace elements {
             };
         }
 
-        void encode(MTL::RenderCommandEncoder* encoder, Fragment<S>& fragment, Finalized<U>& finalized) {
-            auto pipeline = getPipeline();
-            encoder->setRenderPipelineState(pipeline);
+        void record(DrawRecorder& recorder, Fragment<S>& fragment, const Finalized<U>& finalized) {
+            recorder.setRenderPipeline(getPipeline());
 
             auto sampler = getSampler();
 
-            auto atomBuf = fragment.fragmentStorage.atomsBuffer.getBuffer(ctx.frameIndex);
-            auto atomPlacementBuf = fragment.fragmentStorage.placementsBuffer.getBuffer(ctx.frameIndex);
-            auto frameInfoBuf = ctx.frameInfoBuffer.get();
-            auto uniformsBuf = fragment.fragmentStorage.uniformsBuffer.getBuffer(ctx.frameIndex);
-            auto clipsBuf = fragment.fragmentStorage.clipsBuffer.getBuffer(ctx.frameIndex);
+            auto atoms = recorder.copy(fragment.fragmentStorage.atomsBuffer);
+            auto atomPlacements = recorder.copy(fragment.fragmentStorage.placementsBuffer);
+            auto uniforms = recorder.copy(fragment.fragmentStorage.uniformsBuffer);
+            auto clips = recorder.copy(fragment.fragmentStorage.clipsBuffer);
 
-            encoder->setVertexBuffer(atomBuf, 0, 0);
-            encoder->setVertexBuffer(atomPlacementBuf, 0, 1);
-            encoder->setVertexBuffer(frameInfoBuf, 0, 2);
+            recorder.setVertexData(atoms, 0);
+            recorder.setVertexData(atomPlacements, 1);
+            recorder.setVertexFrameInfo(2);
+            recorder.setVertexData(uniforms, 3);
+            recorder.setVertexScrollLayers(4);
 
-            encoder->setFragmentBuffer(uniformsBuf, 0, 0);
-            encoder->setFragmentBuffer(clipsBuf, 0, 1);
+            recorder.setFragmentData(uniforms, 0);
+            recorder.setFragmentData(clips, 1);
+            recorder.setFragmentScrollLayers(2);
 
             if (fragment.fragmentStorage.activeTexture) {
-                encoder->setFragmentTexture(fragment.fragmentStorage.activeTexture.get(), 0);
+                recorder.setFragmentTexture(fragment.fragmentStorage.activeTexture, 0);
             }
             
-            encoder->setFragmentSamplerState(sampler, 0);
-            encoder->drawPrimitives(MTL::PrimitiveTypeTriangle, NS::UInteger(0), 6);
+            recorder.setFragmentSampler(sampler, 0);
+            recorder.drawPrimitives(6);
         }
 
         std::function<bool(HitTestContext<U>& context, simd_float2 testPoint)> setupHitTestFunction() {
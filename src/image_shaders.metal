@@ -25,6 +25,7 @@ struct ImageUniforms {
     ImageStyleUniforms style;
     ImageGeometryUniforms geometry;
     uint numClips;
+    uint scrollLayer;
 };
 
 struct ImageVertexIn {
@@ -35,23 +36,28 @@ struct ImageVertexIn {
 
 struct ImageVertexOut {
     float4 position [[position]];
-    float4 worldPosition;
+    float4 worldPosition; // in the image's scroll layer
+    float2 screenPosition;
     float2 texCords;
 };
 
 vertex ImageVertexOut vertex_image(
     ImageVertexIn in [[stage_in]],
     constant float2* offsets [[buffer(1)]],
-    constant FrameInfo* frameInfo [[buffer(2)]]
+    constant FrameInfo* frameInfo [[buffer(2)]],
+    constant ImageUniforms* uniforms [[buffer(3)]],
+    constant float2* scrollLayers [[buffer(4)]]
 )
 {
     ImageVertexOut out;
 
     in.position += offsets[in.atom_id];
+    float2 screenPosition = in.position + scrollLayers[uniforms->scrollLayer];
 
-    float2 adjustedPosition = toNDC(in.position, frameInfo->width, frameInfo->height);
+    float2 adjustedPosition = toNDC(screenPosition, frameInfo->width, frameInfo->height);
     out.position = float4(adjustedPosition, 0.0, 1.0);
     out.worldPosition = float4(in.position, 0.0, 1.0);
+    out.screenPosition = screenPosition;
     out.texCords = in.texCords;
 
     return out;
@@ -60,10 +66,11 @@ fragment float4 fragment_image(
     ImageVertexOut in [[stage_in]],
     constant ImageUniforms* uniforms[[buffer(0)]],
     constant ClipUniform* clips [[buffer(1)]],
+    constant float2* scrollLayers [[buffer(2)]],
     texture2d<float, access::sample> textureMap [[texture(0)]],
     sampler textureSampler [[sampler(0)]]
 ) {
-    if (outside_clips(in.worldPosition.xy, clips, uniforms->numClips)) {
+    if (outside_clips(in.screenPosition, clips, uniforms->numClips, scrollLayers)) {
         discard_fragment();
     }
 
@@ -4,7 +4,7 @@
 #include "new_arch.hpp"
 #include "sizing.hpp"
 #include <print>
-#include <simd/vector_types.h>
+#include "simd_types.hpp"
 
 static int count = 0;
 
@@ -3273,7 +3273,7 @@ div()
     // - The first image has a fixed 128x128 rendition.
     // - The second image is sized by flex after measurement.
     // Resize the window to make the flex image cross rendition bins and verify
-    // its post-layout atoms continue to use the current frame-buffer slot.
+    // its post-layout atoms are the ones drawn after every resize.
     constexpr auto butterflyPath = "/Users/treja/projects/gui/assets/butterfly.png";
 
     div(gui::Size::percent(1.0), gui::Size::percent(1.0), simd_float4{0.94,0.94,0.96,1.0})
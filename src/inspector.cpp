@@ -1,4 +1,5 @@
 #include "inspector.hpp"
+#include "renderer.hpp"
 #include "context_manager.hpp"
 #include "events.hpp"
 #include "instrumentation.hpp"
@@ -43,22 +44,6 @@ namespace Inspector {
             }
         }
 
-        std::string_view phaseName(instrumentation::Phase phase) {
-            using instrumentation::Phase;
-            switch (phase) {
-                case Phase::Update: return "update";
-                case Phase::Measure: return "measure";
-                case Phase::Atomize: return "atomize";
-                case Phase::PreLayout: return "pre-layout";
-                case Phase::Layout: return "layout";
-                case Phase::PostLayout: return "post-layout";
-                case Phase::Place: return "place";
-                case Phase::Finalize: return "finalize";
-                case Phase::Render: return "render";
-                case Phase::Count: return "unknown";
-            }
-        }
-
         std::string_view recomputeReasonName(instrumentation::RecomputeReason reason) {
             using instrumentation::RecomputeReason;
             switch (reason) {
@@ -482,7 +467,7 @@ namespace Inspector {
                 const auto& phaseData = frame.phases[i];
                 phases += std::format(
                     "{:<11} {:>6.2f} ms  {:>4} nodes",
-                    phaseName(phase),
+                    instrumentation::phaseName(phase),
                     milliseconds(phaseData.elapsed),
                     phaseData.recomputedNodes
                 );
@@ -494,12 +479,15 @@ namespace Inspector {
 
             cacheStatsText.text(std::format(
                 "render order  {} hit / {} miss  {:.2f} ms\n"
-                "spec layout   {} hit / {} miss",
+                "spec layout   {} hit / {} miss\n"
+                "shaping       {} hit / {} miss",
                 frame.renderOrderCache.hits,
                 frame.renderOrderCache.misses,
                 milliseconds(frame.renderOrderCache.rebuildTime),
                 frame.speculativeLayoutCache.hits,
-                frame.speculativeLayoutCache.misses
+                frame.speculativeLayoutCache.misses,
+                frame.shapeCache.hits,
+                frame.shapeCache.misses
             ));
 
             renderStatsText.text(std::format(
@@ -541,7 +529,7 @@ namespace Inspector {
                         auto index = static_cast<std::size_t>(phase);
                         dirtyDetails += std::format(
                             "\n{:<11} {:<11} x{}",
-                            phaseName(phase),
+                            instrumentation::phaseName(phase),
                             recomputeReasonName(found->second.lastRecomputeReasons[index]),
                             found->second.recomputeCounts[index]
                         );
@@ -9,7 +9,7 @@
 #include <cstdint>
 #include <limits>
 #include <optional>
-#include <simd/vector_types.h>
+#include "simd_types.hpp"
 #include <string>
 
 #ifndef GUI_ENABLE_INSPECTOR
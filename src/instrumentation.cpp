@@ -21,6 +21,22 @@ namespace instrumentation {
         return *diagnostics;
     }
 
+    std::string_view phaseName(Phase phase) {
+        switch (phase) {
+            case Phase::Update: return "update";
+            case Phase::Measure: return "measure";
+            case Phase::Atomize: return "atomize";
+            case Phase::PreLayout: return "pre-layout";
+            case Phase::Layout: return "layout";
+            case Phase::PostLayout: return "post-layout";
+            case Phase::Place: return "place";
+            case Phase::Finalize: return "finalize";
+            case Phase::Render: return "render";
+            case Phase::Count: break;
+        }
+        return "unknown";
+    }
+
     FrameDiagnostics& Diagnostics::targetFrame() {
         return frameActive ? currentFrame : pendingFrame;
     }
@@ -49,6 +65,7 @@ namespace instrumentation {
     }
 
     void Diagnostics::recordRecompute(uint64_t nodeId, Phase phase, RecomputeReason reason) {
+        std::lock_guard lock{taskMutex};
         auto index = phaseIndex(phase);
         targetFrame().phases[index].recomputedNodes++;
 
@@ -115,11 +132,18 @@ namespace instrumentation {
     }
 
     void Diagnostics::recordSpeculativeLayoutCache(bool hit) {
+        std::lock_guard lock{taskMutex};
         auto& cache = targetFrame().speculativeLayoutCache;
         hit ? cache.hits++ : cache.misses++;
     }
 
+    void Diagnostics::recordShapeCache(bool hit) {
+        auto& cache = targetFrame().shapeCache;
+        hit ? cache.hits++ : cache.misses++;
+    }
+
     void Diagnostics::recordRenderWork(uint64_t nodes, uint64_t drawCalls, uint64_t atoms) {
+        std::lock_guard lock{taskMutex};
         auto& render = targetFrame().render;
         render.nodesEncoded += nodes;
         render.drawCalls += drawCalls;
@@ -127,6 +151,7 @@ namespace instrumentation {
     }
 
     void Diagnostics::recordBufferWrite(uint64_t bytes) {
+        std::lock_guard lock{taskMutex};
         auto& render = targetFrame().render;
         render.bufferWrites++;
         render.bufferBytes += bytes;
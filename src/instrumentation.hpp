@@ -5,8 +5,10 @@
 #include <cstddef>
 #include <cstdint>
 #include <deque>
+#include <mutex>
 #include <source_location>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 
 #ifndef GUI_ENABLE_INSTRUMENTATION
@@ -43,7 +45,7 @@ namespace instrumentation {
         None = 0,
         Mutation = 1 << 0,
         FrameInfoChanged = 1 << 1,
-        PendingBufferWrites = 1 << 2
+        Scroll = 1 << 2 // only scroll layers moved
     };
 
     enum class DirtyPropagation : uint8_t {
@@ -106,6 +108,7 @@ namespace instrumentation {
         std::array<PhaseDiagnostics, static_cast<std::size_t>(Phase::Count)> phases{};
         CacheDiagnostics renderOrderCache;
         CacheDiagnostics speculativeLayoutCache;
+        CacheDiagnostics shapeCache;
         RenderDiagnostics render;
         HitTestDiagnostics hitTests;
         std::deque<MutationDiagnostics> mutations;
@@ -144,6 +147,7 @@ namespace instrumentation {
             std::chrono::nanoseconds rebuildTime
         );
         void recordSpeculativeLayoutCache(bool hit);
+        void recordShapeCache(bool hit);
         void recordRenderWork(uint64_t nodes, uint64_t drawCalls, uint64_t atoms);
         void recordBufferWrite(uint64_t bytes);
         void recordHitTest(uint64_t nodesExamined, uint64_t hits, std::chrono::nanoseconds elapsed);
@@ -166,9 +170,13 @@ namespace instrumentation {
         std::deque<FrameDiagnostics> frameHistory;
         SchedulingDiagnostics schedulingDiagnostics;
         std::unordered_map<uint64_t, NodeDiagnostics> nodeDiagnostics;
+        // parallel layout records recomputes and cache lookups from scheduler threads;
+        // a layout thread records render work while a presenter writes buffers
+        std::mutex taskMutex;
     };
 
     Diagnostics& getDiagnostics();
+    std::string_view phaseName(Phase phase);
 
     inline void recordRecompute(uint64_t nodeId, Phase phase, RecomputeReason reason) {
         if constexpr (enabled) getDiagnostics().recordRecompute(nodeId, phase, reason);
@@ -212,6 +220,10 @@ namespace instrumentation {
         if constexpr (enabled) getDiagnostics().recordSpeculativeLayoutCache(hit);
     }
 
+    inline void recordShapeCache(bool hit) {
+        if constexpr (enabled) getDiagnostics().recordShapeCache(hit);
+    }
+
     inline void recordRenderWork(uint64_t nodes, uint64_t drawCalls, uint64_t atoms) {
         if constexpr (enabled) getDiagnostics().recordRenderWork(nodes, drawCalls, atoms);
     }
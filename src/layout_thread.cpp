@@ -0,0 +1,179 @@
+#include "layout_thread.hpp"
+#include "instrumentation.hpp"
+#include <algorithm>
+#include <iterator>
+#include <utility>
+
+namespace tree {
+    namespace {
+        // one being presented, one published behind it and one being built
+        constexpr size_t MaxPooledSnapshots = 3;
+    }
+
+    LayoutThread::LayoutThread(RenderTree& tree, FrameInfo frameInfo):
+        tree{tree},
+        frameInfo{frameInfo}
+    {
+        // last, so run() never sees a half-built object
+        thread = std::thread([this] { run(); });
+    }
+
+    LayoutThread::~LayoutThread() {
+        {
+            std::lock_guard lock{queueMutex};
+            stopping = true;
+        }
+        queueChanged.notify_one();
+        thread.join();
+    }
+
+    void LayoutThread::post(Mutation mutation) {
+        {
+            std::lock_guard lock{queueMutex};
+            queue.push_back(std::move(mutation));
+            ++postedCount;
+        }
+        queueChanged.notify_one();
+    }
+
+    void LayoutThread::resize(FrameInfo frameInfo) {
+        {
+            std::lock_guard lock{queueMutex};
+            this->frameInfo = frameInfo;
+            frameRequested = true;
+        }
+        queueChanged.notify_one();
+    }
+
+    std::shared_ptr<const RenderSnapshot> LayoutThread::latest() const {
+        std::lock_guard lock{publishMutex};
+        return published;
+    }
+
+    void LayoutThread::flush() {
+        {
+            std::unique_lock lock{queueMutex};
+            uint64_t target = postedCount;
+            applied.wait(lock, [&] { return appliedCount >= target; });
+        }
+        rethrowFailure();
+    }
+
+    void LayoutThread::rethrowFailure() {
+        std::exception_ptr thrown;
+        {
+            std::lock_guard lock{queueMutex};
+            thrown = std::exchange(failure, nullptr);
+        }
+        if (thrown) std::rethrow_exception(thrown);
+    }
+
+    void LayoutThread::run() {
+        while (true) {
+            FrameInfo target;
+            uint64_t taken;
+            {
+                std::unique_lock lock{queueMutex};
+                queueChanged.wait(lock, [&] { return stopping || frameRequested || !queue.empty(); });
+                if (stopping) return;
+                // everything queued so far goes into one update, so a burst of
+                // mutations costs one layout rather than one each
+                batch.swap(queue);
+                target = frameInfo;
+                taken = postedCount;
+                frameRequested = false;
+            }
+
+            // a throwing mutation must not take the thread (and every flush()
+            // waiting on it) down; the rest of the batch still applies
+            std::exception_ptr thrown;
+            for (auto& mutation : batch) {
+                try {
+                    mutation(tree);
+                } catch (...) {
+                    if (!thrown) thrown = std::current_exception();
+                }
+            }
+            batch.clear();
+
+            try {
+                if (tree.requiresFrame(target)) {
+                    publish(target);
+                }
+            } catch (...) {
+                if (!thrown) thrown = std::current_exception();
+            }
+
+            {
+                std::lock_guard lock{queueMutex};
+                appliedCount = taken;
+                if (thrown && !failure) failure = thrown;
+            }
+            applied.notify_all();
+        }
+    }
+
+    void LayoutThread::publish(const FrameInfo& frameInfo) {
+        instrumentation::FrameTimer frameTimer{frameIndex};
+        {
+            instrumentation::PhaseTimer timer{instrumentation::Phase::Update};
+            tree.update(frameInfo, frameIndex++);
+        }
+
+        auto next = acquireSnapshot(tree.reusableGeneration());
+        {
+            instrumentation::PhaseTimer timer{instrumentation::Phase::Render};
+            tree.buildSnapshot(*next);
+        }
+        next->generation = ++generation;
+
+        std::shared_ptr<const RenderSnapshot> previous;
+        {
+            std::lock_guard lock{publishMutex};
+            previous = std::exchange(published, std::move(next));
+        }
+        // if no presenter holds it, previous goes back to the pool here
+    }
+
+    // The last owner's deleter returns a snapshot under the pool's lock and
+    // this takes it under the same lock, so whatever a presenter read happens
+    // before the layout thread records into it again.
+    //
+    // When only scroll offsets moved since contentGeneration was recorded, a
+    // snapshot already at it just needs its layers rewritten: a pooled one if
+    // there is one, else a copy of the published one, which costs a copy
+    // rather than a walk of the tree.
+    std::shared_ptr<RenderSnapshot> LayoutThread::acquireSnapshot(uint64_t contentGeneration) {
+        std::unique_ptr<RenderSnapshot> snapshot;
+        {
+            std::lock_guard lock{pool->mutex};
+            if (!pool->free.empty()) {
+                auto current = std::ranges::find_if(pool->free, [&](auto& pooled) {
+                    return contentGeneration != 0 && pooled->contentGeneration == contentGeneration;
+                });
+                if (current == pool->free.end()) current = std::prev(pool->free.end());
+                snapshot = std::move(*current);
+                pool->free.erase(current);
+            }
+        }
+        if (!snapshot) {
+            snapshot = std::make_unique<RenderSnapshot>();
+        }
+        if (contentGeneration != 0 && snapshot->contentGeneration != contentGeneration) {
+            // only this thread publishes, so published can't change under us,
+            // and presenters only read it
+            std::shared_ptr<const RenderSnapshot> current = latest();
+            if (current && current->contentGeneration == contentGeneration) {
+                *snapshot = *current;
+            }
+        }
+
+        return std::shared_ptr<RenderSnapshot>(snapshot.release(), [pool = pool](RenderSnapshot* returned) {
+            std::unique_ptr<RenderSnapshot> owned{returned};
+            std::lock_guard lock{pool->mutex};
+            if (pool->free.size() < MaxPooledSnapshots) {
+                pool->free.push_back(std::move(owned));
+            }
+        });
+    }
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include "frame_info.hpp"
+#include "render_snapshot.hpp"
+#include "render_tree.hpp"
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace tree {
+    // Owns every update of one RenderTree on a thread of its own. Other threads
+    // post mutations, which queue without waiting on layout or the GPU; the
+    // thread applies them in order, updates the tree, records a RenderSnapshot
+    // and publishes it. A presenter shows latest() each vsync, so a frame whose
+    // layout runs late presents the previous snapshot again instead of stalling.
+    //
+    // Once started, only this thread may touch the tree: reads and writes go
+    // through post().
+    class LayoutThread {
+    public:
+        using Mutation = std::function<void(RenderTree&)>;
+
+        LayoutThread(RenderTree& tree, FrameInfo frameInfo);
+        ~LayoutThread();
+
+        LayoutThread(const LayoutThread&) = delete;
+        LayoutThread& operator=(const LayoutThread&) = delete;
+
+        void post(Mutation mutation);
+        void resize(FrameInfo frameInfo);
+
+        // the last snapshot published; null until the first one is
+        std::shared_ptr<const RenderSnapshot> latest() const;
+
+        // blocks until everything posted before the call is in a published
+        // snapshot (or needed no new one), then rethrows like rethrowFailure()
+        void flush();
+        // rethrows the first exception a mutation or update threw since the
+        // last call; the thread itself carries on with the next batch
+        void rethrowFailure();
+
+    private:
+        // Snapshots no presenter holds any more, handed back by the deleter of
+        // the last shared_ptr to go. Shared with that deleter, which can run on
+        // a presenter after the thread is gone.
+        struct SnapshotPool {
+            std::mutex mutex;
+            std::vector<std::unique_ptr<RenderSnapshot>> free;
+        };
+
+        void run();
+        void publish(const FrameInfo& frameInfo);
+        std::shared_ptr<RenderSnapshot> acquireSnapshot(uint64_t contentGeneration);
+
+        RenderTree& tree;
+        std::thread thread;
+
+        std::mutex queueMutex;
+        std::condition_variable queueChanged;
+        std::condition_variable applied;
+        std::vector<Mutation> queue;
+        FrameInfo frameInfo;
+        bool frameRequested{true};
+        bool stopping{false};
+        uint64_t postedCount{0};
+        uint64_t appliedCount{0};
+        std::exception_ptr failure;
+
+        mutable std::mutex publishMutex;
+        std::shared_ptr<const RenderSnapshot> published;
+
+        std::shared_ptr<SnapshotPool> pool{std::make_shared<SnapshotPool>()};
+
+        // layout thread only
+        std::vector<Mutation> batch;
+        uint64_t frameIndex{0};
+        uint64_t generation{0};
+    };
+}
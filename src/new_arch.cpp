@@ -6,12 +6,14 @@
 //
 
 #include "new_arch.hpp"
+#include "renderer_constants.hpp"
 #include "fragment_types.hpp"
 #include "sizing.hpp"
 #include <algorithm>
 #include <optional>
 #include <print>
-#include <simd/vector_types.h>
+#include "simd_types.hpp"
+#include <cstring>
 
 namespace layout {
 
@@ -281,29 +283,19 @@ namespace layout {
 namespace runtime {
 
     // pipeline specific
-    UIContext::UIContext(MTL::Device* device, MTK::View* view):
-        device{device},
-        view{view},
-        allocator{DrawableBufferAllocator{device}},
+    UIContext::UIContext(gpu::Device& device, FrameInfo frameInfo):
+        device{&device},
+        allocator{DrawableBufferAllocator{&device}},
+        frameArena{&device, MaxOutstandingFrameCount},
         layoutEngine{},
+        frameInfo{frameInfo},
         frameInfoBuffer{allocator.allocate(sizeof(FrameInfo))},
         frameIndex{0}
     {
-        auto frameDimensions = this->view->drawableSize();
-        auto scale = AppKit_Extensions::getContentScaleFactor(reinterpret_cast<void*>(view));
-
-        FrameInfo frameInfo {.width=static_cast<float>(frameDimensions.width)/2.0f, .height=static_cast<float>(frameDimensions.height)/2.0f, .scale = scale};
-
-        this->frameInfo = frameInfo;
         std::memcpy(frameInfoBuffer.get()->contents(), &frameInfo, sizeof(FrameInfo));
     };
 
-    void UIContext::updateView() {
-        auto frameDimensions = this->view->drawableSize();
-
-        auto scale = AppKit_Extensions::getContentScaleFactor(reinterpret_cast<void*>(view));
-
-        FrameInfo frameInfo {.width=static_cast<float>(frameDimensions.width)/2.0f, .height=static_cast<float>(frameDimensions.height)/2.0f, .scale = scale};
+    void UIContext::updateFrameInfo(FrameInfo frameInfo) {
         this->frameInfo = frameInfo;
 
         std::memcpy(frameInfoBuffer.get()->contents(), &frameInfo, sizeof(FrameInfo));
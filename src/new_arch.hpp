@@ -8,8 +8,10 @@
 #pragma once
 #include "fragment_types.hpp"
 #include "printers.hpp"
-#include "metal_imports.hpp"
+#include "simd_types.hpp"
+#include "gpu.hpp"
 #include "frame_info.hpp"
+#include "frame_arena.hpp"
 #include "sizing.hpp"
 #include "text_bidi.hpp"
 #include <concepts>
@@ -19,12 +21,12 @@
 #include <span>
 #include <memory>
 #include <format>
-#include "AppKit_Extensions.hpp"
 #include <any>
 #include <unordered_map>
 #include <string>
 #include <utility>
 #include <vector>
+#include <atomic>
 
 class Renderer;
 
@@ -69,6 +71,8 @@ namespace layout {
         uint8_t bidiLevel{};
         size_t lineBoxIndex{};
         size_t fragmentIndex{};  // index within lineBox.fragmentOffsets
+
+        bool operator==(const LineFragment&) const = default;
     };
 
     struct LineBox {
@@ -78,17 +82,30 @@ namespace layout {
         float currentFragmentOffset{};
 
         void pushFragment(const LineFragment& fragment);
+
+        bool operator==(const LineBox&) const = default;
     };
 
     struct InlineFragmentRange {
         size_t start{};
         size_t count{};
+
+        bool operator==(const InlineFragmentRange&) const = default;
     };
 
     struct InlineFormattingContext {
         std::vector<LineFragment> fragments;
         std::vector<LineBox> lineBoxes;
         std::vector<InlineFragmentRange> childFragments;
+        // stamped when first built; rebuilding identical boxes reuses the retained
+        // context, so constraints keys can compare this instead of the boxes
+        uint64_t generation{};
+
+        bool sameBoxes(const InlineFormattingContext& other) const {
+            return fragments == other.fragments &&
+                lineBoxes == other.lineBoxes &&
+                childFragments == other.childFragments;
+        }
     };
 
     struct InlineFormattingInput {
@@ -359,12 +376,17 @@ namespace style {
         bool drawsEnding() const {
             return mode != Mode::Clip && !ending.empty();
         }
+
+        bool operator==(const TextOverflow&) const = default;
     };
 
     struct ClipUniform {
         simd_float2 rectCenter{};
         simd_float2 halfExtent{};
         simd_float2 cornerRadius{};
+        // scroll layer the rect is positioned in; shaders and hit testing add
+        // that layer's translation to rectCenter
+        uint32_t scrollLayer{};
     };
 
     struct GridPlacement {
@@ -494,7 +516,9 @@ namespace layout {
         ResolvedMargins resolvedMargins {};
         float prevInlineHeight{};
         std::vector<ClipUniform> clipUniforms {};
+        uint64_t clipChainId{}; // interned id of clipUniforms, see tree::ClipChainTable
         std::optional<TextOverflow> textOverflow{};
+        uint32_t textOverflowId{}; // interned textOverflow, see tree::RenderTree::setTextOverflow
 
         bool shrinkWidthToFit{false};
         bool shrinkHeightToFit{false};
@@ -645,6 +669,9 @@ namespace layout {
 
         DeferredPositionInfo deferredPosition;
         std::vector<ClipUniform> clipUniforms {};
+        // computedBox and atomOffsets are relative to this scroll layer, not
+        // the window; 0 is the page, which never moves
+        uint32_t scrollLayer{};
     };
 
     struct LayoutOutput {
@@ -681,13 +708,13 @@ namespace layout {
 
 namespace runtime {
     struct UIContext {
-        UIContext(MTL::Device* device, MTK::View* view);
+        UIContext(gpu::Device& device, FrameInfo frameInfo);
 
-        void updateView();
+        void updateFrameInfo(FrameInfo frameInfo);
 
-        MTL::Device* device;
-        MTK::View* view;
+        gpu::Device* device;
         DrawableBufferAllocator allocator;
+        FrameArena frameArena; // per-frame uniforms, clips, placements and points
         layout::LayoutEngine layoutEngine;
         FrameInfo frameInfo;
         DrawableBuffer frameInfoBuffer;
@@ -4,7 +4,8 @@
 #include "div.hpp"
 #include "events.hpp"
 #include "fonts.hpp"
-#include "renderer.hpp"
+#include "render_tree.hpp"
+#include "tree_manager.hpp"
 #include "image.hpp"
 #include "svg.hpp"
 #include "text.hpp"
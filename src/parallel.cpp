@@ -0,0 +1,204 @@
+#include "parallel.hpp"
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace Parallel {
+    namespace {
+        // spins before a worker with nothing to do goes to sleep
+        constexpr int IdleSpins = 64;
+
+        std::mutex sharedOptionsMutex;
+        SchedulerOptions sharedOptions;
+
+        // set on pool threads, so push() knows whose deque to use
+        thread_local Scheduler* currentScheduler = nullptr;
+        thread_local size_t currentWorker = 0;
+
+        void pinCurrentThread([[maybe_unused]] int cpu) {
+#ifdef __linux__
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(cpu, &set);
+            pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#endif
+        }
+    }
+
+    Scheduler::Scheduler(SchedulerOptions options):
+        options{std::move(options)}
+    {
+        size_t count = this->options.workers.value_or(
+            std::max(1u, std::thread::hardware_concurrency()) - 1
+        );
+
+        // every deque exists before any thread can try to steal from it
+        workers.reserve(count);
+        for (size_t i = 0; i < count; ++i) {
+            workers.push_back(std::make_unique<Worker>());
+        }
+        for (size_t i = 0; i < count; ++i) {
+            workers[i]->thread = std::thread([this, i] { workerLoop(i); });
+        }
+    }
+
+    Scheduler::~Scheduler() {
+        stopping.store(true);
+        {
+            std::lock_guard lock{sleepMutex};
+            wake.notify_all();
+        }
+        for (auto& worker : workers) {
+            worker->thread.join();
+        }
+    }
+
+    Scheduler& Scheduler::shared() {
+        static Scheduler scheduler{[] {
+            std::lock_guard lock{sharedOptionsMutex};
+            return sharedOptions;
+        }()};
+        return scheduler;
+    }
+
+    void Scheduler::configure(SchedulerOptions options) {
+        std::lock_guard lock{sharedOptionsMutex};
+        sharedOptions = std::move(options);
+    }
+
+    size_t Scheduler::workerCount() const {
+        return workers.size();
+    }
+
+    void Scheduler::push(Task task) {
+        // counted first, so a thief that sees nothing yet spins instead of sleeping
+        queued.fetch_add(1);
+        if (currentScheduler == this) {
+            auto& worker = *workers[currentWorker];
+            std::lock_guard lock{worker.mutex};
+            worker.tasks.push_back(std::move(task));
+        } else {
+            std::lock_guard lock{injectedMutex};
+            injected.push_back(std::move(task));
+        }
+
+        if (sleeping.load() > 0) {
+            std::lock_guard lock{sleepMutex};
+            wake.notify_one();
+        }
+    }
+
+    bool Scheduler::take(Task& task) {
+        const bool onWorker = currentScheduler == this;
+
+        // newest own task first: it's the smallest piece and its data is warm
+        if (onWorker) {
+            auto& worker = *workers[currentWorker];
+            std::lock_guard lock{worker.mutex};
+            if (!worker.tasks.empty()) {
+                task = std::move(worker.tasks.back());
+                worker.tasks.pop_back();
+                queued.fetch_sub(1);
+                return true;
+            }
+        }
+
+        // a thread outside the pool waiting in sync() takes the newest injected
+        // task, which is usually its own latest spawn, so helping stays depth
+        // first; workers take the oldest, which has the most left to split
+        {
+            std::lock_guard lock{injectedMutex};
+            if (!injected.empty()) {
+                if (onWorker) {
+                    task = std::move(injected.front());
+                    injected.pop_front();
+                } else {
+                    task = std::move(injected.back());
+                    injected.pop_back();
+                }
+                queued.fetch_sub(1);
+                return true;
+            }
+        }
+
+        // oldest task of someone else's: the largest piece left to split
+        const size_t start = onWorker ? currentWorker + 1 : 0;
+        for (size_t i = 0; i < workers.size(); ++i) {
+            auto& victim = *workers[(start + i) % workers.size()];
+            std::lock_guard lock{victim.mutex};
+            if (!victim.tasks.empty()) {
+                task = std::move(victim.tasks.front());
+                victim.tasks.pop_front();
+                queued.fetch_sub(1);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool Scheduler::runOne() {
+        Task task;
+        if (!take(task)) return false;
+        task();
+        return true;
+    }
+
+    void Scheduler::workerLoop(size_t index) {
+        currentScheduler = this;
+        currentWorker = index;
+        if (!options.cpus.empty()) {
+            pinCurrentThread(options.cpus[index % options.cpus.size()]);
+        }
+
+        while (!stopping.load()) {
+            if (runOne()) continue;
+
+            bool found = false;
+            for (int spin = 0; spin < IdleSpins && !found; ++spin) {
+                std::this_thread::yield();
+                found = queued.load() > 0;
+            }
+            if (found) continue;
+
+            // push() bumps queued before reading sleeping and this bumps sleeping
+            // before reading queued, so one of the two always sees the other
+            std::unique_lock lock{sleepMutex};
+            sleeping.fetch_add(1);
+            wake.wait(lock, [&] { return stopping.load() || queued.load() > 0; });
+            sleeping.fetch_sub(1);
+        }
+    }
+
+    TaskGroup::TaskGroup(Scheduler& scheduler):
+        scheduler{scheduler}
+    {}
+
+    TaskGroup::~TaskGroup() {
+        wait();
+    }
+
+    void TaskGroup::wait() {
+        while (pending.load(std::memory_order_acquire) > 0) {
+            if (!scheduler.runOne()) {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    void TaskGroup::sync() {
+        wait();
+        std::exception_ptr thrown;
+        {
+            std::lock_guard lock{errorMutex};
+            thrown = std::exchange(error, nullptr);
+        }
+        if (thrown) std::rethrow_exception(thrown);
+    }
+
+    void TaskGroup::fail(std::exception_ptr exception) {
+        std::lock_guard lock{errorMutex};
+        if (!error) error = exception;
+    }
+}
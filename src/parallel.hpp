@@ -1,19 +1,190 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
 #include <iterator>
-#include <dispatch/dispatch.h>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <utility>
+#include <vector>
 
 namespace Parallel {
+    struct SchedulerOptions {
+        // threads besides the one that waits; unset picks hardware_concurrency() - 1,
+        // 0 runs everything on the waiting thread
+        std::optional<size_t> workers;
+        // when not empty, worker i is pinned to cpus[i % cpus.size()] (Linux only)
+        std::vector<int> cpus;
+    };
+
+    // Work-stealing pool. Every worker owns a deque: it pushes and pops at the
+    // back, and when it runs dry steals from the front of another's. Threads
+    // outside the pool hand work in through a shared queue and run tasks while
+    // they wait in TaskGroup::sync, so fork-join nests without deadlocking.
+    class Scheduler {
+    public:
+        explicit Scheduler(SchedulerOptions options = {});
+        ~Scheduler();
+
+        Scheduler(const Scheduler&) = delete;
+        Scheduler& operator=(const Scheduler&) = delete;
+
+        // the pool behind the free functions below, started on first use
+        static Scheduler& shared();
+        // options for shared(); ignored once it has started
+        static void configure(SchedulerOptions options);
+
+        size_t workerCount() const;
+        // workers plus the thread waiting on them
+        size_t concurrency() const { return workerCount() + 1; }
+
+    private:
+        friend class TaskGroup;
+        using Task = std::function<void()>;
+
+        struct Worker {
+            std::mutex mutex;
+            std::deque<Task> tasks;
+            std::thread thread;
+        };
+
+        void push(Task task);
+        bool take(Task& task);
+        bool runOne();
+        void workerLoop(size_t index);
+
+        SchedulerOptions options;
+        std::vector<std::unique_ptr<Worker>> workers;
+
+        std::mutex injectedMutex;
+        std::deque<Task> injected; // pushed from threads outside the pool
+
+        std::atomic<size_t> queued{0};
+        std::atomic<size_t> sleeping{0};
+        std::atomic<bool> stopping{false};
+        std::mutex sleepMutex;
+        std::condition_variable wake;
+    };
+
+    // Fork-join scope. spawn() queues a task that may run on any worker; sync()
+    // runs queued work on the calling thread until every spawned task has
+    // finished, then rethrows the first exception one of them threw. The
+    // destructor waits too, so nothing outlives the captures it borrowed.
+    class TaskGroup {
+    public:
+        explicit TaskGroup(Scheduler& scheduler = Scheduler::shared());
+        ~TaskGroup();
+
+        TaskGroup(const TaskGroup&) = delete;
+        TaskGroup& operator=(const TaskGroup&) = delete;
+
+        template<typename Func>
+        void spawn(Func&& func) {
+            pending.fetch_add(1, std::memory_order_relaxed);
+            scheduler.push([this, func = std::forward<Func>(func)]() mutable {
+                try {
+                    func();
+                } catch (...) {
+                    fail(std::current_exception());
+                }
+                pending.fetch_sub(1, std::memory_order_acq_rel);
+            });
+        }
+
+        void sync();
+
+    private:
+        void wait();
+        void fail(std::exception_ptr exception);
+
+        Scheduler& scheduler;
+        std::atomic<size_t> pending{0};
+        std::mutex errorMutex;
+        std::exception_ptr error;
+    };
+
+    namespace detail {
+        // hands upper halves to thieves and keeps splitting the lower one, so a
+        // worker that steals takes a large block and splits it in turn
+        template<typename Func>
+        void forRange(Scheduler& scheduler, size_t begin, size_t end, size_t grain, Func& func) {
+            TaskGroup group{scheduler};
+            while (end - begin > grain) {
+                size_t mid = begin + (end - begin) / 2;
+                group.spawn([&scheduler, mid, end, grain, &func] {
+                    forRange(scheduler, mid, end, grain, func);
+                });
+                end = mid;
+            }
+            for (size_t i = begin; i < end; ++i) {
+                func(i);
+            }
+            group.sync();
+        }
+    }
+
+    // func(i) for every i in [0, count). grain is the most indices one task runs
+    // in a row; 0 picks one that gives each thread a few tasks to balance with.
+    template<typename Func>
+    void for_index(Scheduler& scheduler, size_t count, Func&& func, size_t grain = 0) {
+        if (count == 0) return;
+        if (grain == 0) grain = std::max<size_t>(1, count / (scheduler.concurrency() * 8));
+        if (count <= grain || scheduler.workerCount() == 0) {
+            for (size_t i = 0; i < count; ++i) func(i);
+            return;
+        }
+        detail::forRange(scheduler, 0, count, grain, func);
+    }
+
+    template<typename Func>
+    void for_index(size_t count, Func&& func, size_t grain = 0) {
+        for_index(Scheduler::shared(), count, std::forward<Func>(func), grain);
+    }
+
     template<typename Iter, typename Func>
     void for_each(Iter begin, Iter end, Func&& func) {
-        #ifdef __APPLE__
-            dispatch_apply(std::distance(begin, end), 
-                        dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_HIGH, 0),
-                ^(size_t i) {
-                    func(*(begin + i));
-                }
-            );
-        #else
-            // serial fallback (later will add portability)
-            std::for_each(begin, end, std::forward<Func>(func));
-        #endif
+        for_index(static_cast<size_t>(std::distance(begin, end)), [&](size_t i) {
+            func(*(begin + i));
+        });
+    }
+
+    // Folds map(element) with reduce over fixed chunks of grain elements, then
+    // combines the chunks left to right. Chunking doesn't depend on the worker
+    // count, so for a given grain the result is the same on any pool.
+    template<typename Iter, typename T, typename Map, typename Reduce>
+    T parallel_reduce(Scheduler& scheduler, Iter begin, Iter end, T identity, Map&& map, Reduce&& reduce,
+                      size_t grain = 0) {
+        const auto count = static_cast<size_t>(std::distance(begin, end));
+        if (count == 0) return identity;
+        if (grain == 0) grain = std::max<size_t>(1, (count + 255) / 256);
+
+        std::vector<T> partials((count + grain - 1) / grain, identity);
+        for_index(scheduler, partials.size(), [&](size_t chunk) {
+            const size_t first = chunk * grain;
+            const size_t last = std::min(count, first + grain);
+            T partial = identity;
+            for (size_t i = first; i < last; ++i) {
+                partial = reduce(std::move(partial), map(*(begin + i)));
+            }
+            partials[chunk] = std::move(partial);
+        }, 1);
+
+        T result = std::move(identity);
+        for (auto& partial : partials) {
+            result = reduce(std::move(result), std::move(partial));
+        }
+        return result;
+    }
+
+    template<typename Iter, typename T, typename Map, typename Reduce>
+    T parallel_reduce(Iter begin, Iter end, T identity, Map&& map, Reduce&& reduce, size_t grain = 0) {
+        return parallel_reduce(Scheduler::shared(), begin, end, std::move(identity),
+                               std::forward<Map>(map), std::forward<Reduce>(reduce), grain);
     }
-}
\ No newline at end of file
+}
@@ -7,7 +7,7 @@
 
 #pragma once
 
-#include "metal_imports.hpp"
+#include "simd_types.hpp"
 #include <iostream>
 #include <print>
 
@@ -0,0 +1,219 @@
+#include "render_snapshot.hpp"
+#include "instrumentation.hpp"
+#include <algorithm>
+#include <cstring>
+#include <span>
+
+namespace tree {
+    namespace {
+        void bindBuffer(gpu::RenderEncoder* encoder, RenderSnapshot::Stage stage, gpu::Buffer* buffer, size_t offset, size_t index) {
+            if (stage == RenderSnapshot::Stage::Vertex) {
+                encoder->setVertexBuffer(buffer, offset, index);
+            } else {
+                encoder->setFragmentBuffer(buffer, offset, index);
+            }
+        }
+
+        void bindBytes(gpu::RenderEncoder* encoder, RenderSnapshot::Stage stage, const std::byte* bytes, size_t length, size_t index) {
+            if (stage == RenderSnapshot::Stage::Vertex) {
+                encoder->setVertexBytes(bytes, length, index);
+            } else {
+                encoder->setFragmentBytes(bytes, length, index);
+            }
+            instrumentation::recordBufferWrite(length);
+        }
+
+        // index of object in objects, appending it unless it was the last one
+        // added; draws of one kind tend to share the same table or sampler
+        template <typename T>
+        uint32_t intern(std::vector<T>& objects, const T& object) {
+            if (objects.empty() || objects.back() != object) {
+                objects.push_back(object);
+            }
+            return static_cast<uint32_t>(objects.size() - 1);
+        }
+    }
+
+    void RenderSnapshot::clear() {
+        frameInfo = {};
+        generation = 0;
+        atomCount = 0;
+        contentGeneration = 0;
+        draws.clear();
+        bindings.clear();
+        data.clear();
+        inlineData.clear();
+        buffers.clear();
+        textures.clear();
+        samplers.clear();
+        hitBoxes.clear();
+        hitClips.clear();
+        scrollLayers.clear();
+    }
+
+    void RenderSnapshot::encode(gpu::RenderEncoder* encoder, FrameArena& arena) const {
+        // the blob only changes with the content, so a frame that just scrolled
+        // rebinds the upload an earlier frame made and pushes the layers alone
+        ArenaSlice blob{};
+        if (!data.empty()) {
+            blob = contentGeneration != 0
+                ? arena.pushRetained(contentGeneration, data.data(), data.size())
+                : arena.push(data.data(), data.size());
+        }
+        auto layers = arena.push(scrollLayers.data(), scrollLayers.size() * sizeof(simd_float2));
+
+        for (auto& draw : draws) {
+            encoder->setRenderPipeline(draw.pipeline);
+            for (uint32_t i = draw.bindingStart; i < draw.bindingStart + draw.bindingCount; ++i) {
+                auto& binding = bindings[i];
+                switch (binding.source) {
+                    case Source::Data:
+                        bindBuffer(encoder, binding.stage, blob.buffer, blob.offset + binding.offset, binding.index);
+                        break;
+                    case Source::Bytes:
+                        bindBytes(encoder, binding.stage, inlineData.data() + binding.offset, binding.length, binding.index);
+                        break;
+                    case Source::FrameInfo:
+                        bindBytes(encoder, binding.stage, reinterpret_cast<const std::byte*>(&frameInfo), sizeof(FrameInfo), binding.index);
+                        break;
+                    case Source::Buffer:
+                        bindBuffer(encoder, binding.stage, buffers[binding.object].get(), 0, binding.index);
+                        break;
+                    case Source::Texture:
+                        encoder->setFragmentTexture(textures[binding.object].get(), binding.index);
+                        break;
+                    case Source::Sampler:
+                        encoder->setFragmentSampler(samplers[binding.object], binding.index);
+                        break;
+                    case Source::ScrollLayers:
+                        bindBuffer(encoder, binding.stage, layers.buffer, layers.offset, binding.index);
+                        break;
+                }
+            }
+
+            if (draw.instanced) {
+                encoder->drawInstancedPrimitives(gpu::PrimitiveType::Triangle, 0, draw.vertexCount, draw.instanceCount);
+            } else {
+                encoder->drawPrimitives(gpu::PrimitiveType::Triangle, 0, draw.vertexCount);
+            }
+        }
+    }
+
+    std::optional<uint64_t> RenderSnapshot::hitTest(simd_float2 point) const {
+        auto inside = [&](simd_float2 min, simd_float2 max, uint32_t layer) {
+            simd_float2 local = point;
+            if (layer < scrollLayers.size()) {
+                local = point - scrollLayers[layer];
+            }
+            return local.x >= min.x && local.x <= max.x && local.y >= min.y && local.y <= max.y;
+        };
+
+        for (auto box = hitBoxes.rbegin(); box != hitBoxes.rend(); ++box) {
+            if (!inside(box->min, box->max, box->scrollLayer)) continue;
+            // a row scrolled out of its viewport still has its box under the point
+            auto clips = std::span{hitClips}.subspan(box->clipStart, box->clipCount);
+            if (std::ranges::all_of(clips, [&](const HitClip& clip) { return inside(clip.min, clip.max, clip.scrollLayer); })) {
+                return box->nodeId;
+            }
+        }
+        return std::nullopt;
+    }
+
+    DrawRecorder::DrawRecorder(RenderSnapshot& snapshot):
+        snapshot{snapshot},
+        bindingStart{snapshot.bindings.size()}
+    {}
+
+    DrawRecorder::DataRange DrawRecorder::copy(const void* bytes, size_t length) {
+        // Small ranges are passed by value, so they pack tightly. Only the big
+        // ones (glyph runs, instanced batches) are bound from the uploaded blob
+        // at the offsets constant address space buffers need, where the padding
+        // is small next to the range.
+        bool inlined = length <= gpu::MaxInlineBytes;
+        auto& data = inlined ? snapshot.inlineData : snapshot.data;
+        size_t alignment = inlined ? InlineAlignment : FrameArena::Alignment;
+        size_t offset = (data.size() + alignment - 1) & ~(alignment - 1);
+        // an empty range still binds something the shader may index
+        size_t size = inlined ? std::max(length, InlineAlignment) : length;
+        data.resize(offset + size);
+        if (length) {
+            std::memcpy(data.data() + offset, bytes, length);
+        }
+        return {offset, size, inlined};
+    }
+
+    void DrawRecorder::setRenderPipeline(gpu::RenderPipeline* pipeline) {
+        this->pipeline = pipeline;
+    }
+
+    void DrawRecorder::setVertexData(DataRange range, size_t index) {
+        bindData(RenderSnapshot::Stage::Vertex, range, index);
+    }
+
+    void DrawRecorder::setFragmentData(DataRange range, size_t index) {
+        bindData(RenderSnapshot::Stage::Fragment, range, index);
+    }
+
+    void DrawRecorder::setVertexFrameInfo(size_t index) {
+        bind(RenderSnapshot::Stage::Vertex, RenderSnapshot::Source::FrameInfo, index, 0, 0);
+    }
+
+    void DrawRecorder::setVertexScrollLayers(size_t index) {
+        bind(RenderSnapshot::Stage::Vertex, RenderSnapshot::Source::ScrollLayers, index, 0, 0);
+    }
+
+    void DrawRecorder::setFragmentScrollLayers(size_t index) {
+        bind(RenderSnapshot::Stage::Fragment, RenderSnapshot::Source::ScrollLayers, index, 0, 0);
+    }
+
+    void DrawRecorder::setFragmentBuffer(const std::shared_ptr<gpu::Buffer>& buffer, size_t index) {
+        bind(RenderSnapshot::Stage::Fragment, RenderSnapshot::Source::Buffer, index, intern(snapshot.buffers, buffer), 0);
+    }
+
+    void DrawRecorder::setFragmentTexture(const std::shared_ptr<gpu::Texture>& texture, size_t index) {
+        bind(RenderSnapshot::Stage::Fragment, RenderSnapshot::Source::Texture, index, intern(snapshot.textures, texture), 0);
+    }
+
+    void DrawRecorder::setFragmentSampler(gpu::Sampler* sampler, size_t index) {
+        bind(RenderSnapshot::Stage::Fragment, RenderSnapshot::Source::Sampler, index, intern(snapshot.samplers, sampler), 0);
+    }
+
+    void DrawRecorder::drawPrimitives(size_t vertexCount) {
+        draw(vertexCount, 1, false);
+    }
+
+    void DrawRecorder::drawInstancedPrimitives(size_t vertexCount, size_t instanceCount) {
+        draw(vertexCount, instanceCount, true);
+    }
+
+    void DrawRecorder::bind(RenderSnapshot::Stage stage, RenderSnapshot::Source source, size_t index, uint32_t object, size_t offset, size_t length) {
+        snapshot.bindings.push_back({
+            .stage = stage,
+            .source = source,
+            .index = static_cast<uint32_t>(index),
+            .object = object,
+            .length = static_cast<uint32_t>(length),
+            .offset = offset
+        });
+    }
+
+    void DrawRecorder::bindData(RenderSnapshot::Stage stage, DataRange range, size_t index) {
+        if (range.inlined) {
+            bind(stage, RenderSnapshot::Source::Bytes, index, 0, range.offset, range.length);
+        } else {
+            bind(stage, RenderSnapshot::Source::Data, index, 0, range.offset);
+        }
+    }
+
+    void DrawRecorder::draw(size_t vertexCount, size_t instanceCount, bool instanced) {
+        snapshot.draws.push_back({
+            .pipeline = pipeline,
+            .bindingStart = static_cast<uint32_t>(bindingStart),
+            .bindingCount = static_cast<uint32_t>(snapshot.bindings.size() - bindingStart),
+            .vertexCount = static_cast<uint32_t>(vertexCount),
+            .instanceCount = static_cast<uint32_t>(instanceCount),
+            .instanced = instanced
+        });
+        bindingStart = snapshot.bindings.size();
+    }
+}
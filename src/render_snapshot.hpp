@@ -0,0 +1,160 @@
+#pragma once
+
+#include "frame_arena.hpp"
+#include "frame_info.hpp"
+#include "gpu.hpp"
+#include "simd_types.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <vector>
+
+namespace tree {
+    // One frame's worth of drawing, copied out of the tree in paint order: the
+    // bytes every draw binds (atoms, placements, uniforms, clips), the pipelines, samplers, textures and shared buffers they use, and a
+    // clipped box per node for hit testing. Everything is positioned in scroll
+    // layers whose translations ride along separately, so a frame that only
+    // scrolled rewrites those and nothing else. Nothing writes it once it's
+    // published, so it can be encoded on any thread while the tree it came from
+    // keeps changing.
+    struct RenderSnapshot {
+        enum class Stage : uint8_t {
+            Vertex,
+            Fragment
+        };
+
+        enum class Source : uint8_t {
+            Data,        // offset into data
+            Bytes,       // inlineData[offset, offset + length), passed by value
+            FrameInfo,   // this snapshot's frameInfo
+            Buffer,      // buffers[object]
+            Texture,     // textures[object]
+            Sampler,     // samplers[object]
+            ScrollLayers // scrollLayers
+        };
+
+        struct Binding {
+            Stage stage;
+            Source source;
+            uint32_t index;
+            uint32_t object;
+            uint32_t length; // Bytes only
+            size_t offset;
+        };
+
+        struct Draw {
+            gpu::RenderPipeline* pipeline;
+            uint32_t bindingStart;
+            uint32_t bindingCount;
+            uint32_t vertexCount;
+            uint32_t instanceCount;
+            bool instanced;
+        };
+
+        // A clip positioned in a scroll layer other than the box's own, such
+        // as an enclosing scroller's viewport; one per layer, bounding rects
+        // intersected.
+        struct HitClip {
+            simd_float2 min; // in scrollLayer
+            simd_float2 max;
+            uint32_t scrollLayer;
+        };
+
+        struct HitBox {
+            uint64_t nodeId;
+            simd_float2 min; // in scrollLayer, trimmed by same-layer clips
+            simd_float2 max;
+            uint32_t scrollLayer;
+            // hitClips[clipStart, clipStart + clipCount); boxes under the same
+            // clips share one range
+            uint32_t clipStart;
+            uint32_t clipCount;
+        };
+
+        FrameInfo frameInfo{};
+        // set by whoever publishes it, so a presenter can tell a new snapshot
+        // from one it has already shown
+        uint64_t generation{};
+        uint64_t atomCount{};
+        // RenderTree::contentGeneration of the tree this was recorded from;
+        // two snapshots at the same nonzero value hold the same data
+        uint64_t contentGeneration{};
+
+        std::vector<Draw> draws;
+        std::vector<Binding> bindings;
+        // ranges too big for set*Bytes, each at a FrameArena::Alignment offset
+        std::vector<std::byte> data;
+        // the rest, packed at InlineAlignment; most draws bind only these
+        std::vector<std::byte> inlineData;
+        std::vector<std::shared_ptr<gpu::Buffer>> buffers;
+        std::vector<std::shared_ptr<gpu::Texture>> textures;
+        std::vector<gpu::Sampler*> samplers;
+        std::vector<HitBox> hitBoxes; // paint order, back to front
+        std::vector<HitClip> hitClips;
+        std::vector<simd_float2> scrollLayers; // window-space translation per layer
+
+        // empties everything but keeps capacity, for reuse
+        void clear();
+
+        // Uploads data once per contentGeneration (FrameArena::pushRetained)
+        // and pushes only scrollLayers into the arena's current frame, then
+        // replays the draws, passing frameInfo and inlineData ranges by value.
+        // The draws themselves go to a new encoder every frame, so they're
+        // replayed even when nothing but the layers changed.
+        void encode(gpu::RenderEncoder* encoder, FrameArena& arena) const;
+
+        // Topmost node whose box and clips contain point, each moved by its
+        // own scroll layer as TreeNode::contains does. Rounded corners and
+        // preciseHitTest need the live tree; this is the coarse answer a
+        // presenting thread can give on its own.
+        std::optional<uint64_t> hitTest(simd_float2 point) const;
+    };
+
+    // What processors draw into instead of an encoder. The calls mirror
+    // gpu::RenderEncoder, except bound data is copied into the snapshot rather
+    // than uploaded, and shared GPU objects are retained by it.
+    class DrawRecorder {
+    public:
+        // simd types need no more than this, and set*Bytes needs no offset
+        static constexpr size_t InlineAlignment = 16;
+
+        // a range of RenderSnapshot::inlineData, or of data when inlined is false
+        struct DataRange {
+            size_t offset;
+            size_t length;
+            bool inlined;
+        };
+
+        explicit DrawRecorder(RenderSnapshot& snapshot);
+
+        DataRange copy(const void* bytes, size_t length);
+
+        template <typename T>
+        DataRange copy(const FrameData<T>& frameData) {
+            return copy(frameData.data(), frameData.size() * sizeof(T));
+        }
+
+        void setRenderPipeline(gpu::RenderPipeline* pipeline);
+        void setVertexData(DataRange range, size_t index);
+        void setFragmentData(DataRange range, size_t index);
+        void setVertexFrameInfo(size_t index);
+        void setVertexScrollLayers(size_t index);
+        void setFragmentScrollLayers(size_t index);
+        void setFragmentBuffer(const std::shared_ptr<gpu::Buffer>& buffer, size_t index);
+        void setFragmentTexture(const std::shared_ptr<gpu::Texture>& texture, size_t index);
+        void setFragmentSampler(gpu::Sampler* sampler, size_t index);
+        void drawPrimitives(size_t vertexCount);
+        void drawInstancedPrimitives(size_t vertexCount, size_t instanceCount);
+
+    private:
+        void bind(RenderSnapshot::Stage stage, RenderSnapshot::Source source, size_t index, uint32_t object, size_t offset, size_t length = 0);
+        void bindData(RenderSnapshot::Stage stage, DataRange range, size_t index);
+        void draw(size_t vertexCount, size_t instanceCount, bool instanced);
+
+        RenderSnapshot& snapshot;
+        gpu::RenderPipeline* pipeline{};
+        // first binding of the draw being recorded
+        size_t bindingStart{};
+    };
+}
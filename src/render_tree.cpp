@@ -6,6 +6,9 @@
 #include <print>
 
 namespace tree {
+    constexpr size_t MaxClipChainEntries = 1 << 16;
+    constexpr size_t MaxSpeculativeLayoutsPerNode = 16;
+
     using layout::FlexLayout;
     using layout::FlexResolver;
     using layout::GridResolver;
@@ -40,6 +43,37 @@ namespace tree {
         }
     }
 
+    // A relayout root: its border box cannot depend on its children, and no
+    // margin chain crosses it, so a dirty subtree can be laid out again from here
+    // with the inputs its parent last used. Flex/grid parents size items from
+    // content, so only normal-flow children qualify.
+    bool isLayoutBoundary(const TreeNode* node, const Constraints& constraints) {
+        if (!node->parent) return false;
+        auto parentDisplay = node->parent->getDisplay();
+        if (parentDisplay == Display::Flex || parentDisplay == Display::Grid) return false;
+        if (node->getDisplay() == Display::Inline) return false;
+
+        auto isFixed = [](const Size& size) {
+            return size.unit == Unit::Px || size.unit == Unit::Pt;
+        };
+        if (!isFixed(node->shared.width) || !isFixed(node->shared.height)) return false;
+        if (constraints.shrinkWidthToFit || constraints.shrinkHeightToFit) return false;
+        if (constraints.widthResolution != AxisResolution::Final ||
+            constraints.heightResolution != AxisResolution::Final) {
+            return false;
+        }
+
+        auto position = node->getPosition();
+        bool outOfFlow = position == Position::Absolute || position == Position::Fixed;
+        return outOfFlow || (node->getPaddingTop().has_value() && node->getPaddingBottom().has_value());
+    }
+
+    // where scrollOffset moves a container's content; rtl content starts at the
+    // right edge and scrolls the other way
+    simd_float2 contentOffset(simd_float2 scrollOffset, bool rtl) {
+        return {rtl ? scrollOffset.x : -scrollOffset.x, -scrollOffset.y};
+    }
+
     bool RenderTree::isFrameInfoChanged(const FrameInfo& frameInfo) const {
         return !lastFrameInfo.has_value()
             || lastFrameInfo->width != frameInfo.width
@@ -55,8 +89,8 @@ namespace tree {
         if (isFrameInfoChanged(frameInfo)) {
             reasons |= std::to_underlying(instrumentation::FrameReason::FrameInfoChanged);
         }
-        if (pendingFrameBufferWrites > 0) {
-            reasons |= std::to_underlying(instrumentation::FrameReason::PendingBufferWrites);
+        if (scrollPending) {
+            reasons |= std::to_underlying(instrumentation::FrameReason::Scroll);
         }
         instrumentation::recordFrameDecision(reasons);
         return reasons != 0;
@@ -64,7 +98,6 @@ namespace tree {
 
     void RenderTree::markDirty(std::source_location source) {
         needsUpdate = true;
-        pendingFrameBufferWrites = MaxOutstandingFrameCount;
         renderOrderDirty = true;
         instrumentation::recordRenderOrderInvalidation(
             std::to_underlying(instrumentation::RenderOrderReason::FullTreeDirty)
@@ -87,7 +120,6 @@ namespace tree {
         if (!node || bits == DirtyBits::None) return;
 
         needsUpdate = true;
-        pendingFrameBufferWrites = MaxOutstandingFrameCount;
 
         if (hasDirty(bits, DirtyBits::PaintOrder)) {
             renderOrderDirty = true;
@@ -126,8 +158,25 @@ namespace tree {
         node->dirtySelf |= selfBits;
         node->dirtySubtree |= selfBits;
 
+        // Layout stops at the nearest relayout root; above it only the bits the
+        // other phases need to find their way down remain
+        TreeNode* boundary = nullptr;
+        if (hasDirty(bits, DirtyBits::Measure | DirtyBits::Atomize | DirtyBits::Layout)) {
+            for (auto* ancestor = node->parent; ancestor; ancestor = ancestor->parent) {
+                if (ancestor->layoutBoundary.has_value()) {
+                    boundary = ancestor;
+                    break;
+                }
+            }
+        }
+        TreeNode* aboveBoundary = boundary ? boundary->parent : nullptr;
+
+        DirtyBits subtreeBits = selfBits;
         for (auto* ancestor = node->parent; ancestor; ancestor = ancestor->parent) {
-            ancestor->dirtySubtree |= selfBits;
+            if (ancestor == aboveBoundary) {
+                subtreeBits = subtreeBits & ~DirtyBits::Layout;
+            }
+            ancestor->dirtySubtree |= subtreeBits;
         }
 
         if (hasDirty(bits, DirtyBits::PostLayout | DirtyBits::Place)) {
@@ -136,10 +185,18 @@ namespace tree {
 
         if (hasDirty(bits, DirtyBits::Measure | DirtyBits::Atomize | DirtyBits::Layout)) {
             DirtyBits ancestorBits = DirtyBits::Layout | DirtyBits::PostLayout | DirtyBits::Place | DirtyBits::Finalize;
-            for (auto* ancestor = node->parent; ancestor; ancestor = ancestor->parent) {
+            for (auto* ancestor = node->parent; ancestor != aboveBoundary; ancestor = ancestor->parent) {
                 ancestor->dirtySelf |= ancestorBits;
                 ancestor->dirtySubtree |= ancestorBits | selfBits;
             }
+            if (boundary) {
+                // the relaid-out subtree still has to be positioned, placed and
+                // finalized, and those phases only descend through dirty nodes
+                for (auto* ancestor = aboveBoundary; ancestor; ancestor = ancestor->parent) {
+                    ancestor->dirtySelf |= DirtyBits::PostLayout | DirtyBits::Place | DirtyBits::Finalize;
+                }
+                pendingRelayoutRoots.push_back(boundary);
+            }
         }
 
         if (hasDirty(bits, DirtyBits::PostLayout)) {
@@ -160,8 +217,36 @@ namespace tree {
         }
     }
 
+    void RenderTree::markScrolled(TreeNode* node) {
+        // a container not yet laid out as one picks its offset up when it is
+        if (!node || node->contentScrollLayer == 0) return;
+
+        auto& layer = scrollLayers[node->contentScrollLayer];
+        layer.offset = contentOffset(node->scrollOffset, layer.rtl);
+        scrollTranslationsDirty = true;
+        scrollPending = true;
+    }
+
+    std::span<const simd_float2> RenderTree::scrollTranslations() {
+        if (scrollTranslationsDirty) {
+            // a handful of layers, a few deep; walking each chain is cheaper than ordering them
+            scrollTranslationCache.resize(scrollLayers.size());
+            for (size_t i = 0; i < scrollLayers.size(); ++i) {
+                simd_float2 translation{0.0f, 0.0f};
+                for (uint32_t layer = static_cast<uint32_t>(i); layer != 0; layer = scrollLayers[layer].parent) {
+                    translation += scrollLayers[layer].offset;
+                }
+                scrollTranslationCache[i] = translation;
+            }
+            scrollTranslationsDirty = false;
+        }
+        return scrollTranslationCache;
+    }
+
     void RenderTree::clearDirty(TreeNode* node) {
         if (!node) return;
+        // a clean node has a clean subtree; dirtySubtree is propagated to every ancestor
+        if (node->dirtySelf == DirtyBits::None && node->dirtySubtree == DirtyBits::None) return;
         node->dirtySelf = DirtyBits::None;
         node->dirtySubtree = DirtyBits::None;
         for (auto& child : node->children) {
@@ -169,101 +254,115 @@ namespace tree {
         }
     }
 
+    // A speculative layout embeds the whole subtree, so anything on a
+    // Measure/Atomize/Layout dirty path loses its entries. Clean subtrees keep
+    // theirs across frames; stale constraints simply miss on the key.
+    void RenderTree::evictSpeculativeLayouts(TreeNode* node) {
+        if (!subtreeHasDirty(node, DirtyBits::Measure | DirtyBits::Atomize | DirtyBits::Layout)) return;
+        node->speculativeLayouts.clear();
+        for (auto& child : node->children) {
+            evictSpeculativeLayouts(child.get());
+        }
+    }
+
     bool RenderTree::subtreeHasDirty(TreeNode* node, DirtyBits bits) const {
         if (!node) return false;
         return hasDirty(node->dirtySelf | node->dirtySubtree, bits);
     }
 
-    ConstraintsKey RenderTree::makeConstraintsKey(const Constraints& constraints,
-                                                  simd_float2 extraOriginA,
-                                                  simd_float2 extraOriginB) const {
+    uint64_t ClipChainTable::intern(uint64_t parent, const ClipUniform& clip) {
         std::size_t hash = 0;
-        hash_combine(hash, constraints.origin.x);
-        hash_combine(hash, constraints.origin.y);
-        hash_combine(hash, constraints.cursor.x);
-        hash_combine(hash, constraints.cursor.y);
-        hash_combine(hash, constraints.availableWidth);
-        hash_combine(hash, constraints.availableHeight);
-        hash_combine(hash, static_cast<int>(constraints.inheritedProperties.direction));
-        hash_combine(hash, static_cast<int>(constraints.inheritedProperties.textAlign));
-        hash_combine(hash, constraints.frameInfo.width);
-        hash_combine(hash, constraints.frameInfo.height);
-        hash_combine(hash, constraints.frameInfo.scale);
-        hash_combine(hash, constraints.absoluteContainingBlock.origin.x);
-        hash_combine(hash, constraints.absoluteContainingBlock.origin.y);
-        hash_combine(hash, constraints.absoluteContainingBlock.width);
-        hash_combine(hash, constraints.absoluteContainingBlock.height);
-        hash_combine(hash, static_cast<int>(constraints.edgeIntent.edgeDisplayMode));
-        hash_combine(hash, constraints.edgeIntent.intent);
-        hash_combine(hash, constraints.edgeIntent.collapsable);
-        hash_combine(hash, constraints.prevInlineHeight);
-        auto hashOptionalSize = [&](const std::optional<Size>& size) {
-            hash_combine(hash, size.has_value());
-            if (size.has_value()) {
-                hash_combine(hash, size->value);
-                hash_combine(hash, static_cast<int>(size->unit));
-            }
-        };
-        hashOptionalSize(constraints.replacedAttributes.marginTop);
-        hashOptionalSize(constraints.replacedAttributes.marginBottom);
-        hash_combine(hash, constraints.shrinkWidthToFit);
-        hash_combine(hash, constraints.shrinkHeightToFit);
-        hash_combine(hash, static_cast<int>(constraints.widthResolution));
-        hash_combine(hash, static_cast<int>(constraints.heightResolution));
-        auto lineFragments = constraints.inlineFormatting.lineFragments();
-        auto lineBoxes = constraints.inlineFormatting.lineBoxes();
-        hash_combine(hash, lineFragments.size());
-        hash_combine(hash, lineBoxes.size());
-        hash_combine(hash, constraints.textBidiInput.has_value());
-        if (constraints.textBidiInput.has_value()) {
-            const auto& bidi = *constraints.textBidiInput;
-            hash_combine(hash, bidi.paragraphByteStart);
-            hash_combine(hash, bidi.byteLength);
-            for (const auto& run : bidi.runs) {
-                hash_combine(hash, run.byteStart);
-                hash_combine(hash, run.byteLength);
-                hash_combine(hash, run.level);
-            }
-        }
-        hash_combine(hash, constraints.textOverflow.has_value());
-        if (constraints.textOverflow.has_value()) {
-            hash_combine(hash, static_cast<int>(constraints.textOverflow->mode));
-            for (unsigned char byte : constraints.textOverflow->ending) {
-                hash_combine(hash, byte);
+        hash_combine(hash, parent);
+        hash_combine(hash, clip.rectCenter.x);
+        hash_combine(hash, clip.rectCenter.y);
+        hash_combine(hash, clip.halfExtent.x);
+        hash_combine(hash, clip.halfExtent.y);
+        hash_combine(hash, clip.cornerRadius.x);
+        hash_combine(hash, clip.cornerRadius.y);
+        hash_combine(hash, clip.scrollLayer);
+
+        auto [first, last] = entries.equal_range(hash);
+        for (auto it = first; it != last; ++it) {
+            auto& entry = it->second;
+            if (entry.parent == parent &&
+                entry.clip.rectCenter.x == clip.rectCenter.x &&
+                entry.clip.rectCenter.y == clip.rectCenter.y &&
+                entry.clip.halfExtent.x == clip.halfExtent.x &&
+                entry.clip.halfExtent.y == clip.halfExtent.y &&
+                entry.clip.cornerRadius.x == clip.cornerRadius.x &&
+                entry.clip.cornerRadius.y == clip.cornerRadius.y &&
+                entry.clip.scrollLayer == clip.scrollLayer) {
+                return entry.id;
             }
         }
 
-        for (auto& clip : constraints.clipUniforms) {
-            hash_combine(hash, clip.rectCenter.x);
-            hash_combine(hash, clip.rectCenter.y);
-            hash_combine(hash, clip.halfExtent.x);
-            hash_combine(hash, clip.halfExtent.y);
-            hash_combine(hash, clip.cornerRadius.x);
-            hash_combine(hash, clip.cornerRadius.y);
-        }
-
-        for (auto& fragment : lineFragments) {
-            hash_combine(hash, fragment.width);
-            hash_combine(hash, fragment.atomStart);
-            hash_combine(hash, fragment.atomCount);
-            hash_combine(hash, fragment.lineBoxIndex);
-            hash_combine(hash, fragment.fragmentIndex);
-        }
-        for (auto& lineBox : lineBoxes) {
-            hash_combine(hash, lineBox.fragmentCount);
-            hash_combine(hash, lineBox.width);
-            hash_combine(hash, lineBox.currentFragmentOffset);
-            for (auto offset : lineBox.fragmentOffsets) {
-                hash_combine(hash, offset);
+        uint64_t id = nextId++;
+        entries.emplace(hash, Entry{.parent = parent, .clip = clip, .id = id});
+        return id;
+    }
+
+    // Interns once per clipping node when it hands its overflow down, so
+    // building keys never touches the lock.
+    void RenderTree::setTextOverflow(Constraints& constraints, const std::optional<style::TextOverflow>& overflow) const {
+        constraints.textOverflow = overflow;
+        constraints.textOverflowId = internTextOverflow(overflow);
+    }
+
+    uint32_t RenderTree::internTextOverflow(const std::optional<style::TextOverflow>& overflow) const {
+        if (!overflow.has_value()) return 0;
+        std::lock_guard lock{textOverflowMutex};
+        for (size_t i = 0; i < textOverflows.size(); ++i) {
+            if (textOverflows[i].mode == overflow->mode && textOverflows[i].ending == overflow->ending) {
+                return static_cast<uint32_t>(i + 1);
             }
         }
+        textOverflows.push_back(*overflow);
+        return static_cast<uint32_t>(textOverflows.size());
+    }
 
-        hash_combine(hash, extraOriginA.x);
-        hash_combine(hash, extraOriginA.y);
-        hash_combine(hash, extraOriginB.x);
-        hash_combine(hash, extraOriginB.y);
-
-        return ConstraintsKey{.value = hash};
+    // Constant cost per node: line boxes, bidi runs and the clip stack are
+    // represented by their generation / interned id rather than walked.
+    ConstraintsKey RenderTree::makeConstraintsKey(const Constraints& constraints,
+                                                  simd_float2 extraOriginA,
+                                                  simd_float2 extraOriginB) const {
+        const auto& inlineFormatting = constraints.inlineFormatting;
+        return ConstraintsKey{
+            .originX = constraints.origin.x,
+            .originY = constraints.origin.y,
+            .cursorX = constraints.cursor.x,
+            .cursorY = constraints.cursor.y,
+            .availableWidth = constraints.availableWidth,
+            .availableHeight = constraints.availableHeight,
+            .direction = constraints.inheritedProperties.direction,
+            .textAlign = constraints.inheritedProperties.textAlign,
+            .frameWidth = constraints.frameInfo.width,
+            .frameHeight = constraints.frameInfo.height,
+            .frameScale = constraints.frameInfo.scale,
+            .containingBlockX = constraints.absoluteContainingBlock.origin.x,
+            .containingBlockY = constraints.absoluteContainingBlock.origin.y,
+            .containingBlockWidth = constraints.absoluteContainingBlock.width,
+            .containingBlockHeight = constraints.absoluteContainingBlock.height,
+            .edgeDisplayMode = constraints.edgeIntent.edgeDisplayMode,
+            .edgeIntent = constraints.edgeIntent.intent,
+            .edgeCollapsable = constraints.edgeIntent.collapsable,
+            .prevInlineHeight = constraints.prevInlineHeight,
+            .replacedMarginTop = constraints.replacedAttributes.marginTop,
+            .replacedMarginBottom = constraints.replacedAttributes.marginBottom,
+            .shrinkWidthToFit = constraints.shrinkWidthToFit,
+            .shrinkHeightToFit = constraints.shrinkHeightToFit,
+            .widthResolution = constraints.widthResolution,
+            .heightResolution = constraints.heightResolution,
+            .inlineFormattingGeneration = inlineFormatting.context ? inlineFormatting.context->generation : 0,
+            .fragmentStart = inlineFormatting.fragments.start,
+            .fragmentCount = inlineFormatting.fragments.count,
+            .textBidiGeneration = constraints.textBidiInput ? constraints.textBidiInput->generation : 0,
+            .clipChainId = constraints.clipChainId,
+            .textOverflowId = constraints.textOverflowId,
+            .extraOriginAX = extraOriginA.x,
+            .extraOriginAY = extraOriginA.y,
+            .extraOriginBX = extraOriginB.x,
+            .extraOriginBY = extraOriginB.y,
+        };
     }
 
     ConstraintsKey RenderTree::makeSpeculativeKey(
@@ -272,19 +371,9 @@ namespace tree {
         const Measured& measured
     ) const {
         auto key = makeConstraintsKey(constraints);
-        hash_combine(key.value, node->id);
-        hash_combine(key.value, measured.explicitWidth.has_value());
-        if (measured.explicitWidth.has_value()) {
-            hash_combine(key.value, *measured.explicitWidth);
-        } else {
-            hash_combine(key.value, static_cast<int>(measured.explicitWidth.error()));
-        }
-        hash_combine(key.value, measured.explicitHeight.has_value());
-        if (measured.explicitHeight.has_value()) {
-            hash_combine(key.value, *measured.explicitHeight);
-        } else {
-            hash_combine(key.value, static_cast<int>(measured.explicitHeight.error()));
-        }
+        key.nodeId = node->id;
+        key.explicitWidth = measured.explicitWidth;
+        key.explicitHeight = measured.explicitHeight;
         return key;
     }
 
@@ -295,12 +384,21 @@ namespace tree {
     ) const {
         using instrumentation::RecomputeReason;
 
+        auto& storedKey = node->constraintsKey(bit);
         if (hasDirty(node->dirtySelf, bit)) return RecomputeReason::Dirty;
-        if (!node->constraintsKey.has_value()) return RecomputeReason::MissingConstraintsKey;
-        if (*node->constraintsKey != incomingKey) return RecomputeReason::ConstraintsChanged;
+        if (!storedKey.has_value()) return RecomputeReason::MissingConstraintsKey;
+        if (*storedKey != incomingKey) return RecomputeReason::ConstraintsChanged;
         return RecomputeReason::None;
     }
 
+    ConstraintsKey RenderTree::phaseKey(TreeNode* node, DirtyBits phase, const Constraints& constraints, bool inputsChanged) const {
+        auto& storedKey = node->constraintsKey(phase);
+        if (!inputsChanged && storedKey.has_value()) {
+            return *storedKey;
+        }
+        return makeConstraintsKey(constraints);
+    }
+
     const std::vector<TreeNode*>& RenderTree::sortedRenderOrder() {
         if (!renderOrderDirty && !renderOrderCache.empty()) {
             instrumentation::recordRenderOrderCache(true);
@@ -316,6 +414,7 @@ namespace tree {
             : 0;
 
         renderOrderCache = collectAllNodes(getRoot());
+        hitTestIndexDirty = true;
 
         uint64_t paintOrderIndex = 0;
 
@@ -368,7 +467,6 @@ namespace tree {
     void RenderTree::update(const FrameInfo& frameInfo, uint64_t frameIndex) {
         bool frameInfoChanged = isFrameInfoChanged(frameInfo);
         if (frameInfoChanged) {
-            pendingFrameBufferWrites = MaxOutstandingFrameCount;
             if (auto root = getRoot()) {
                 markSubtreeDirty(root, allPhaseDirtyBits());
             }
@@ -378,11 +476,14 @@ namespace tree {
             );
         }
 
-        if (!needsUpdate && !frameInfoChanged && pendingFrameBufferWrites == 0) {
+        // scrolling alone is picked up by buildSnapshot
+        scrollPending = false;
+        if (!needsUpdate && !frameInfoChanged) {
             return;
         }
 
         needsUpdate = false;
+        contentGeneration = nextLayoutGeneration();
         lastFrameInfo = frameInfo;
 
         auto root = getRoot();
@@ -409,6 +510,11 @@ namespace tree {
                 }
             },
         };
+        // long sessions with many distinct clip rects would grow the table forever
+        if (clipChains.size() > MaxClipChainEntries) {
+            clipChains.clear();
+        }
+        rootConstraints.clipChainId = clipChains.intern(0, rootConstraints.clipUniforms.front());
 
         // AHH APPLE CLANG DOESN'T SUPPORT EXECUTION POLICIES YET EXECUTE ME
         // Parallel::for_each(allNodes.begin(), allNodes.end(),
@@ -434,10 +540,20 @@ namespace tree {
             preLayoutPhase(root, frameInfo, rootConstraints);
         }
         // initial layout pass
-        if (needsLayoutPass) {
-            speculativeLayoutCache.clear();
+        if (needsLayoutPass || !pendingRelayoutRoots.empty()) {
             instrumentation::PhaseTimer timer{instrumentation::Phase::Layout};
-            layoutPhase(root, frameInfo, rootConstraints, *root->measured);
+            ++layoutGeneration;
+            evictSpeculativeLayouts(root);
+            // Layout dirties stopped at a boundary leave no trail from the root
+            for (auto* boundary : pendingRelayoutRoots) {
+                evictSpeculativeLayouts(boundary);
+            }
+            if (needsLayoutPass) {
+                layoutPhase(root, frameInfo, rootConstraints, *root->measured);
+            }
+            relayoutBoundaries(frameInfo);
+        }
+        if (renderOrderDirty) {
             root->calculateGlobalZIndex(0);
         }
         sortedRenderOrder();
@@ -445,53 +561,144 @@ namespace tree {
         if (subtreeHasDirty(root, DirtyBits::PostLayout) || !root->layout.has_value()) {
             instrumentation::PhaseTimer timer{instrumentation::Phase::PostLayout};
             postLayoutPhase(root, frameInfo, rootConstraints, {0.0f, 0.0f}, {0.0f, 0.0f});
+            hitTestIndexDirty = true;
         }
 
         if (subtreeHasDirty(root, DirtyBits::Place) || !root->placed.has_value()) {
             instrumentation::PhaseTimer timer{instrumentation::Phase::Place};
             placePhase(root, frameInfo, rootConstraints);
         }
-        if (subtreeHasDirty(root, DirtyBits::Finalize) || !root->finalized.has_value()) {
+        if (subtreeHasDirty(root, DirtyBits::Finalize) || !root->element->isFinalized()) {
             instrumentation::PhaseTimer timer{instrumentation::Phase::Finalize};
             finalizePhase(root, rootConstraints);
         }
 
-        if (pendingFrameBufferWrites > 0) {
-            pendingFrameBufferWrites--;
-        }
-        if (pendingFrameBufferWrites == 0) {
-            clearDirty(root);
+        clearDirty(root);
+
+    }
+
+    // The clips clippedBounds leaves out, merged to one rect per scroll layer.
+    // Siblings under the same scroller share their clips, so a run of them
+    // reuses the range the previous box appended.
+    std::pair<uint32_t, uint32_t> RenderTree::recordHitClips(RenderSnapshot& snapshot, const LayoutResult& layout) {
+        hitClipScratch.clear();
+        for (auto& clip : layout.clipUniforms) {
+            if (clip.scrollLayer == layout.scrollLayer) continue;
+            simd_float2 min = clip.rectCenter - clip.halfExtent;
+            simd_float2 max = clip.rectCenter + clip.halfExtent;
+            auto merged = std::ranges::find(hitClipScratch, clip.scrollLayer, &RenderSnapshot::HitClip::scrollLayer);
+            if (merged == hitClipScratch.end()) {
+                hitClipScratch.push_back({.min = min, .max = max, .scrollLayer = clip.scrollLayer});
+                continue;
+            }
+            merged->min.x = std::max(merged->min.x, min.x);
+            merged->min.y = std::max(merged->min.y, min.y);
+            merged->max.x = std::min(merged->max.x, max.x);
+            merged->max.y = std::min(merged->max.y, max.y);
+        }
+
+        auto count = static_cast<uint32_t>(hitClipScratch.size());
+        if (!snapshot.hitBoxes.empty()) {
+            auto& previous = snapshot.hitBoxes.back();
+            auto previousClips = std::span{snapshot.hitClips}.subspan(previous.clipStart, previous.clipCount);
+            bool same = std::ranges::equal(previousClips, hitClipScratch, [](auto& a, auto& b) {
+                return a.scrollLayer == b.scrollLayer &&
+                    a.min.x == b.min.x && a.min.y == b.min.y && a.max.x == b.max.x && a.max.y == b.max.y;
+            });
+            if (same) return {previous.clipStart, count};
         }
 
+        auto start = static_cast<uint32_t>(snapshot.hitClips.size());
+        snapshot.hitClips.insert(snapshot.hitClips.end(), hitClipScratch.begin(), hitClipScratch.end());
+        return {start, count};
     }
 
-    void RenderTree::render(MTL::RenderCommandEncoder* encoder) {
+    void RenderTree::buildSnapshot(RenderSnapshot& snapshot) {
+        auto translations = scrollTranslations();
+        if (snapshot.contentGeneration == contentGeneration && contentGeneration != 0 && !renderOrderDirty) {
+            // nothing but scroll offsets moved since this was recorded; the draws,
+            // hit boxes and their bytes are all in layer space and still hold
+            snapshot.scrollLayers.assign(translations.begin(), translations.end());
+            instrumentation::recordRenderWork(0, snapshot.draws.size(), snapshot.atomCount);
+            return;
+        }
+
+        if (renderOrderDirty) {
+            // reordered since update(); this recording must not pass for the
+            // last one at the same generation
+            contentGeneration = nextLayoutGeneration();
+        }
         auto& allNodes = sortedRenderOrder();
+        snapshot.clear();
+        snapshot.frameInfo = lastFrameInfo.value_or(FrameInfo{});
+        snapshot.contentGeneration = contentGeneration;
+        snapshot.scrollLayers.assign(translations.begin(), translations.end());
+        snapshot.hitBoxes.reserve(allNodes.size());
+        DrawRecorder recorder{snapshot};
         uint64_t atomCount = 0;
         
-        // serially encoded; encoders are not thread safe
-        for (auto node : allNodes) {
-            if (node->atomized.has_value()) {
-                const auto& atomized = *node->atomized;
+        uint64_t drawCalls = 0;
+        
+        // Runs of adjacent nodes sharing a batch key go out as one instanced
+        // draw, which keeps paint order since nothing else is drawn between them.
+        for (size_t i = 0; i < allNodes.size();) {
+            auto* node = allNodes[i];
+            auto* key = node->element->batchKey();
+            size_t end = i + 1;
+            if (key) {
+                while (end < allNodes.size() && allNodes[end]->element->batchKey() == key) ++end;
+            }
+
+            for (size_t j = i; j < end; ++j) {
+                auto* member = allNodes[j];
+                if (member->layout.has_value()) {
+                    simd_float2 min;
+                    simd_float2 max;
+                    if (HitTestIndex::clippedBounds(*member->layout, min, max)) {
+                        auto [clipStart, clipCount] = recordHitClips(snapshot, *member->layout);
+                        snapshot.hitBoxes.push_back({
+                            .nodeId = member->id,
+                            .min = min,
+                            .max = max,
+                            .scrollLayer = member->layout->scrollLayer,
+                            .clipStart = clipStart,
+                            .clipCount = clipCount
+                        });
+                    }
+                }
+                if (!member->atomized.has_value()) continue;
+                const auto& atomized = *member->atomized;
                 atomCount += atomized.usesDrawableAtoms
                     ? atomized.drawableAtoms.size()
                     : atomized.atoms.size();
             }
-            auto& finalized = node->finalized;
-            node->element->encode(encoder, finalized);
+
+            if (end - i > 1) {
+                renderBatch.clear();
+                for (size_t j = i; j < end; ++j) renderBatch.push_back(allNodes[j]->element.get());
+                node->element->recordBatch(recorder, renderBatch);
+            } else {
+                node->element->record(recorder);
+            }
+            ++drawCalls;
+            i = end;
         }
-        instrumentation::recordRenderWork(allNodes.size(), allNodes.size(), atomCount);
+        snapshot.atomCount = atomCount;
+        instrumentation::recordRenderWork(allNodes.size(), drawCalls, atomCount);
     }
 
-    void RenderTree::measurePhase(TreeNode* node, Constraints& constraints) {
-        auto key = makeConstraintsKey(constraints);
+    void RenderTree::measurePhase(TreeNode* node, Constraints& constraints, bool inputsChanged) {
+        auto key = phaseKey(node, DirtyBits::Measure, constraints, inputsChanged);
         auto reason = recomputeReason(node, DirtyBits::Measure, key);
-        if (reason != instrumentation::RecomputeReason::None) {
+        bool recomputed = reason != instrumentation::RecomputeReason::None;
+        if (recomputed) {
             instrumentation::recordRecompute(node->id, instrumentation::Phase::Measure, reason);
             auto measured = node->element->measure(constraints, node->shared);
             node->measured = measured;
-            node->constraintsKey = key;
+            node->constraintsKey(DirtyBits::Measure) = key;
             node->dirtySelf |= DirtyBits::Atomize | DirtyBits::Layout | DirtyBits::PostLayout | DirtyBits::Place | DirtyBits::Finalize;
+        } else if (!hasDirty(node->dirtySubtree, DirtyBits::Measure)) {
+            return;
         }
         
         float paddingLeft = node->shared.paddingLeft.value_or(Size{}).resolveOr(Size::px(constraints.availableWidth));
@@ -508,29 +715,70 @@ namespace tree {
         
         // std::println("maxWidth: {}", childConstraints.availableWidth);
 
+        // child constraints derive from this node's measurement, so they can only
+        // differ from last time if it was recomputed
         for (auto& child : node->children) {
-            measurePhase(child.get(), childConstraints);
+            if (!recomputed && !subtreeHasDirty(child.get(), DirtyBits::Measure)) continue;
+            measurePhase(child.get(), childConstraints, recomputed);
         }
     }
 
 
-    // consider safer way of accessing cache?
-    Result<void> RenderTree::atomizePhase(
+    Result<void> RenderTree::atomizePhase(TreeNode* node, Constraints& constraints) {
+        atomizeJobs.clear();
+        auto collected = collectAtomizeJobs(node, constraints, true);
+        if (!collected) return collected;
+
+        // compute stage: shaping, glyph outlines and break data, any order
+        Parallel::for_index(atomizeJobs.size(), [&](size_t i) {
+            auto& job = atomizeJobs[i];
+            job.node->element->prepareAtomize(job.constraints, job.node->shared, *job.node->measured);
+        }, 1);
+
+        // commit stage: buffers and shared tables, in tree order so glyph table
+        // indices don't depend on which thread finished first
+        for (auto& job : atomizeJobs) {
+            job.node->atomized = job.node->element->commitAtomize(job.constraints, job.node->shared, *job.node->measured);
+        }
+        atomizeJobs.clear();
+        return {};
+    }
+
+    Result<void> RenderTree::collectAtomizeJobs(
         TreeNode* node,
-        Constraints& constraints
+        Constraints& constraints,
+        bool inputsChanged
     ) {
+        // same runs as last time keep the same generation, so the key still matches
+        if (constraints.textBidiInput.has_value()) {
+            auto& previous = node->textBidiInput;
+            constraints.textBidiInput->generation =
+                previous.has_value() && previous->generation != 0 && previous->sameRuns(*constraints.textBidiInput)
+                    ? previous->generation
+                    : nextLayoutGeneration();
+        }
         node->textBidiInput = constraints.textBidiInput;
 
-        auto key = makeConstraintsKey(constraints);
+        auto key = phaseKey(node, DirtyBits::Atomize, constraints, inputsChanged);
         auto reason = recomputeReason(node, DirtyBits::Atomize, key);
-        if (reason != instrumentation::RecomputeReason::None) {
+        bool recomputed = reason != instrumentation::RecomputeReason::None;
+        if (recomputed) {
             instrumentation::recordRecompute(node->id, instrumentation::Phase::Atomize, reason);
-            auto& measured  = *node->measured;
-            auto& shared = node->shared;
-            auto atomized = node->element->atomize(constraints, shared, measured);
-            node->atomized = atomized;
-            node->constraintsKey = key;
+            atomizeJobs.push_back({.node = node, .constraints = constraints});
+            node->constraintsKey(DirtyBits::Atomize) = key;
             node->dirtySelf |= DirtyBits::Layout | DirtyBits::PostLayout | DirtyBits::Place | DirtyBits::Finalize;
+        } else if (!hasDirty(node->dirtySubtree, DirtyBits::Atomize)) {
+            return {};
+        }
+
+        // bidi inputs span sibling text runs, so one edited child shifts the others
+        bool childInputsChanged = recomputed || std::ranges::any_of(node->children, [](auto& child) {
+            return hasDirty(child->dirtySelf, DirtyBits::Atomize);
+        });
+        if (!childInputsChanged && std::ranges::none_of(node->children, [&](auto& child) {
+            return subtreeHasDirty(child.get(), DirtyBits::Atomize);
+        })) {
+            return {};
         }
 
         Constraints childConstraints = constraints;
@@ -540,8 +788,10 @@ namespace tree {
         );
         if (!childBidiInputs) return std::unexpected{childBidiInputs.error()};
         for (size_t i = 0; i < node->children.size(); ++i) {
+            auto* child = node->children[i].get();
+            if (!childInputsChanged && !subtreeHasDirty(child, DirtyBits::Atomize)) continue;
             childConstraints.textBidiInput = std::move((*childBidiInputs)[i]);
-            auto result = atomizePhase(node->children[i].get(), childConstraints);
+            auto result = collectAtomizeJobs(child, childConstraints, childInputsChanged);
             if (!result) return result;
         }
         return {};
@@ -688,20 +938,70 @@ namespace tree {
         Constraints constraints,
         Measured measured
     ) {
+        auto& cache = node->speculativeLayouts;
         auto key = makeSpeculativeKey(node, constraints, measured);
-        if (auto found = speculativeLayoutCache.find(key);
-            found != speculativeLayoutCache.end()) {
+        if (auto found = cache.find(key); found != cache.end()) {
             instrumentation::recordSpeculativeLayoutCache(true);
+            node->speculativeLayoutsPass = layoutGeneration;
             return found->second;
         }
 
         instrumentation::recordSpeculativeLayoutCache(false);
 
+        // callers hold references into the cache for the rest of the pass, so only
+        // trim entries left over from earlier passes
+        if (cache.size() >= MaxSpeculativeLayoutsPerNode && node->speculativeLayoutsPass != layoutGeneration) {
+            cache.clear();
+        }
+        node->speculativeLayoutsPass = layoutGeneration;
+
         auto output = layoutRecursive(node, frameInfo, std::move(constraints), measured, false);
-        auto [inserted, _] = speculativeLayoutCache.emplace(key, std::move(output));
+        auto [inserted, _] = cache.emplace(key, std::move(output));
         return inserted->second;
     }
 
+    void RenderTree::relayoutBoundaries(const FrameInfo& frameInfo) {
+        if (pendingRelayoutRoots.empty()) return;
+
+        // outer roots first: relaying out one may reach (and refresh the inputs of) a nested one
+        std::vector<std::pair<size_t, TreeNode*>> roots;
+        roots.reserve(pendingRelayoutRoots.size());
+        for (auto* node : pendingRelayoutRoots) {
+            size_t depth = 0;
+            for (auto* ancestor = node->parent; ancestor; ancestor = ancestor->parent) ++depth;
+            roots.emplace_back(depth, node);
+        }
+        pendingRelayoutRoots.clear();
+        std::ranges::sort(roots);
+
+        for (auto [depth, node] : roots) {
+            // already redone from further up this pass, or no longer a boundary
+            if (node->layoutPass == layoutGeneration || !node->layoutBoundary.has_value()) continue;
+            if (!subtreeHasDirty(node, DirtyBits::Layout)) continue;
+
+            // the boundary blocks its margin chains, so its children start fresh ones
+            // exactly as a full preLayout pass would give them
+            collapsedChainMap.clear();
+            nextChainId = 0;
+            auto& measured = *node->measured;
+            auto& inputs = *node->layoutBoundary;
+            // the constraints the boundary was last laid out with, so direction,
+            // alignment and origin match what a full pass would hand its children
+            auto childConstraints = inputs.constraints;
+            childConstraints.availableWidth = measured.explicitWidth.value_or(inputs.constraints.availableWidth);
+            childConstraints.availableHeight = measured.explicitHeight.value_or(inputs.constraints.availableHeight);
+            childConstraints.frameInfo = frameInfo;
+            for (auto& child : node->children) {
+                buildCollapsedChains(child.get(), collapsedChainMap, nextChainId, nullptr, nullptr);
+            }
+            for (auto& child : node->children) {
+                precomputeMargins(child.get(), childConstraints, collapsedChainMap);
+            }
+
+            layoutRecursive(node, frameInfo, inputs.constraints, inputs.measured, true);
+        }
+    }
+
     LayoutOutput RenderTree::layoutRecursive(
         TreeNode* node,
         const FrameInfo& frameInfo,
@@ -709,14 +1009,36 @@ namespace tree {
         Measured measured,
         bool mutate
     ) {
-        auto key = makeConstraintsKey(constraints);
+        ConstraintsKey key{};
 
         if (mutate) {
+            // flex/grid hand children adjusted measurements, so those are part of the key
+            key = makeSpeculativeKey(node, constraints, measured);
             auto reason = recomputeReason(node, DirtyBits::Layout, key);
+            // refreshed on the clean path too: a parent's display change can end a boundary
+            if (isLayoutBoundary(node, constraints)) {
+                node->layoutBoundary = TreeNode::LayoutBoundaryInputs{constraints, measured};
+            } else {
+                node->layoutBoundary.reset();
+            }
+            if (reason == instrumentation::RecomputeReason::None &&
+                !subtreeHasDirty(node, DirtyBits::Layout) && node->layout.has_value()) {
+                // same inputs and nothing below changed: the retained layout still holds.
+                // postLayout rewrites computedBox/atomOffsets in global space, so hand the
+                // parent the local copies it originally produced
+                LayoutOutput output {
+                    .measured = measured,
+                    .layout = *node->layout
+                };
+                output.layout.computedBox = output.layout.localComputedBox;
+                output.layout.atomOffsets = output.layout.localAtomOffsets;
+                return output;
+            }
             if (reason == instrumentation::RecomputeReason::None) {
                 reason = instrumentation::RecomputeReason::AncestorRecomputed;
             }
             instrumentation::recordRecompute(node->id, instrumentation::Phase::Layout, reason);
+            node->layoutPass = layoutGeneration;
         }
 
         auto& atomized = *node->atomized;
@@ -794,8 +1116,9 @@ namespace tree {
             childConstraints.heightResolution = constraints.heightResolution;
         }
         childConstraints.textOverflow = constraints.textOverflow;
+        childConstraints.textOverflowId = constraints.textOverflowId;
         if (node->shared.overflow != Overflow::Visible) {
-            childConstraints.textOverflow = node->shared.textOverflow;
+            setTextOverflow(childConstraints, node->shared.textOverflow);
         }
         float parentAvailableWidth  = childConstraints.availableWidth;
         float parentAvailableHeight = childConstraints.availableHeight;
@@ -823,6 +1146,10 @@ namespace tree {
         auto inlineFormatting = buildInlineBoxes(node, childConstraints);
 
         auto normalPass = [&](){
+            // out-of-flow children neither move the cursor nor count toward the
+            // bounds, so once the cursor reaches one it can run beside its siblings
+            std::optional<Parallel::TaskGroup> outOfFlow;
+
             for (uint64_t i = 0; i < node->children.size(); ++i) {
                 auto& child = node->children[i];
                 auto childAsPtr = child.get();
@@ -832,6 +1159,17 @@ namespace tree {
                     .fragments = inlineFormatting->childFragments[i]
                 };
                 childConstraints.inheritedProperties = constraints.inheritedProperties;
+
+                auto childPosition = childAsPtr->getPosition();
+                if (layoutMode == LayoutMode::Parallel &&
+                    (childPosition == Position::Absolute || childPosition == Position::Fixed)) {
+                    if (!outOfFlow) outOfFlow.emplace();
+                    outOfFlow->spawn([this, childAsPtr, &frameInfo, childConstraints, mutate] {
+                        layoutRecursive(childAsPtr, frameInfo, childConstraints, *childAsPtr->measured, mutate);
+                    });
+                    continue;
+                }
+
                 auto childOutput = layoutRecursive(
                     childAsPtr,
                     frameInfo,
@@ -850,6 +1188,8 @@ namespace tree {
                     maxY = std::max(maxY, childLayout.computedBox.y + childLayout.consumedHeight);
                 }
             }
+
+            if (outOfFlow) outOfFlow->sync();
         };
 
         auto flexPass = [&]() {
@@ -964,8 +1304,9 @@ namespace tree {
                 childConstraints.heightResolution = constraints.heightResolution;
             }
             childConstraints.textOverflow = constraints.textOverflow;
+            childConstraints.textOverflowId = constraints.textOverflowId;
             if (node->shared.overflow != Overflow::Visible) {
-                childConstraints.textOverflow = node->shared.textOverflow;
+                setTextOverflow(childConstraints, node->shared.textOverflow);
             }
             parentAvailableWidth  = childConstraints.availableWidth;
             parentAvailableHeight = childConstraints.availableHeight;
@@ -1033,7 +1374,7 @@ namespace tree {
 
         if (mutate) {
             node->layout = output.layout;
-            node->constraintsKey = key;
+            node->constraintsKey(DirtyBits::Layout) = key;
             node->dirtySelf |= DirtyBits::PostLayout | DirtyBits::Place | DirtyBits::Finalize;
         }
 
@@ -1041,9 +1382,14 @@ namespace tree {
     }
 
     void RenderTree::postLayoutPhase(TreeNode* node, const FrameInfo& frameInfo, Constraints& constraints,
-                                      simd_float2 parentGlobalOrigin, simd_float2 absBlockGlobalOrigin) {
+                                      simd_float2 parentGlobalOrigin, simd_float2 absBlockGlobalOrigin,
+                                      uint32_t parentLayer, uint32_t absBlockLayer) {
         auto key = makeConstraintsKey(constraints, parentGlobalOrigin, absBlockGlobalOrigin);
+        key.scrollLayerA = parentLayer;
+        key.scrollLayerB = absBlockLayer;
         auto reason = recomputeReason(node, DirtyBits::PostLayout, key);
+        // ancestors of anything postLayout-dirty are dirty themselves, so a clean node with
+        // an unchanged key has nothing to redo underneath it either
         if (reason == instrumentation::RecomputeReason::None) {
             return;
         }
@@ -1075,12 +1421,16 @@ namespace tree {
         }
 
         simd_float2 baseOrigin;
+        uint32_t layer;
         if (position == Position::Fixed) {
             baseOrigin = {0.0f, 0.0f};
+            layer = 0;
         } else if (position == Position::Absolute) {
             baseOrigin = absBlockGlobalOrigin;
+            layer = absBlockLayer;
         } else {
             baseOrigin = parentGlobalOrigin;
+            layer = parentLayer;
         }
 
         layout.computedBox.x += baseOrigin.x;
@@ -1091,6 +1441,7 @@ namespace tree {
         }
         node->globalOffset = baseOrigin;
         layout.clipUniforms = constraints.clipUniforms;
+        layout.scrollLayer = layer;
 
         if (node->shared.overflow == Overflow::Scroll) {
             float viewportLeft = layout.computedBox.x;
@@ -1098,7 +1449,10 @@ namespace tree {
             float viewportTop = layout.computedBox.y;
             float viewportBottom = layout.computedBox.y + layout.computedBox.height;
 
+            // clips from an enclosing scroller move against this box, so only
+            // the ones sharing its layer trim the viewport
             for (auto& clip : constraints.clipUniforms) {
+                if (clip.scrollLayer != layer) continue;
                 viewportLeft = std::max(viewportLeft, clip.rectCenter.x - clip.halfExtent.x);
                 viewportRight = std::min(viewportRight, clip.rectCenter.x + clip.halfExtent.x);
                 viewportTop = std::max(viewportTop, clip.rectCenter.y - clip.halfExtent.y);
@@ -1124,24 +1478,34 @@ namespace tree {
             layout.computedBox.y + layout.resolvedPadding.top
         };
 
+        // content stays where it would be unscrolled; the scroll offset lives in
+        // its layer, so scrolling never comes back through here
+        uint32_t childLayer = layer;
         if (node->shared.overflow == Overflow::Scroll) {
-            currContentOrigin.x += constraints.inheritedProperties.direction == layout::Direction::rtl
-                ? node->scrollOffset.x
-                : -node->scrollOffset.x;
-            currContentOrigin.y -= node->scrollOffset.y;
+            if (node->contentScrollLayer == 0) {
+                node->contentScrollLayer = static_cast<uint32_t>(scrollLayers.size());
+                scrollLayers.emplace_back();
+            }
+            auto& contentLayer = scrollLayers[node->contentScrollLayer];
+            contentLayer.parent = layer;
+            contentLayer.rtl = constraints.inheritedProperties.direction == layout::Direction::rtl;
+            contentLayer.offset = contentOffset(node->scrollOffset, contentLayer.rtl);
+            scrollTranslationsDirty = true;
+            childLayer = node->contentScrollLayer;
         }
 
         simd_float2 childAbsBlockOrigin = absBlockGlobalOrigin;
+        uint32_t childAbsBlockLayer = absBlockLayer;
         if (position != Position::Static) {
             childAbsBlockOrigin = currContentOrigin;
+            childAbsBlockLayer = childLayer;
         }
 
         auto childConstraints = constraints;
         childConstraints.availableWidth = layout.childConstraints.availableWidth;
         if (node->shared.overflow != Overflow::Visible) {
-            childConstraints.textOverflow = node->shared.textOverflow;
-        }
-        if (node->shared.overflow != Overflow::Visible) {
+            setTextOverflow(childConstraints, node->shared.textOverflow);
+
             float cornerRadius = node->shared.cornerRadius.resolveOr(
                 Size::px(std::min(layout.computedBox.width, layout.computedBox.height))
             );
@@ -1157,14 +1521,16 @@ namespace tree {
                     layout.computedBox.y + halfExtent.y
                 },
                 .halfExtent = halfExtent,
-                .cornerRadius = {cornerRadius, cornerRadius}
+                .cornerRadius = {cornerRadius, cornerRadius},
+                .scrollLayer = layer
             });
+            childConstraints.clipChainId = clipChains.intern(constraints.clipChainId, childConstraints.clipUniforms.back());
 
         }
 
         for (auto& child : node->children) {
             postLayoutPhase(child.get(), frameInfo, childConstraints,
-                           currContentOrigin, childAbsBlockOrigin);
+                           currContentOrigin, childAbsBlockOrigin, childLayer, childAbsBlockLayer);
         }
 
         if (node->shared.overflow == Overflow::Scroll) {
@@ -1195,12 +1561,15 @@ namespace tree {
             node->scrollContentSize = contentSize;
         }
 
-        node->constraintsKey = key;
+        node->constraintsKey(DirtyBits::PostLayout) = key;
         node->dirtySelf |= DirtyBits::Place | DirtyBits::Finalize;
     }
 
-    void RenderTree::placePhase(TreeNode* node, const FrameInfo& frameInfo, Constraints& constraints) {
-        auto key = makeConstraintsKey(constraints);
+    void RenderTree::placePhase(TreeNode* node, const FrameInfo& frameInfo, Constraints& constraints, bool inputsChanged) {
+        auto key = phaseKey(node, DirtyBits::Place, constraints, inputsChanged);
+        auto& storedKey = node->constraintsKey(DirtyBits::Place);
+        // place and finalize pass the same constraints to every node
+        bool childInputsChanged = inputsChanged && storedKey != key;
         auto reason = recomputeReason(node, DirtyBits::Place, key);
         if (reason != instrumentation::RecomputeReason::None) {
             instrumentation::recordRecompute(node->id, instrumentation::Phase::Place, reason);
@@ -1210,17 +1579,20 @@ namespace tree {
 
             auto placed = node->element->place(constraints, node->shared, measured, atomized, layout);
             node->placed = placed;
-            node->constraintsKey = key;
+            storedKey = key;
             node->dirtySelf |= DirtyBits::Finalize;
         }
 
         for (auto& child : node->children) {
-            placePhase(child.get(), frameInfo, constraints);
+            if (!childInputsChanged && !subtreeHasDirty(child.get(), DirtyBits::Place)) continue;
+            placePhase(child.get(), frameInfo, constraints, childInputsChanged);
         }
     }
 
-    void RenderTree::finalizePhase(TreeNode* node, Constraints& constraints) {
-        auto key = makeConstraintsKey(constraints);
+    void RenderTree::finalizePhase(TreeNode* node, Constraints& constraints, bool inputsChanged) {
+        auto key = phaseKey(node, DirtyBits::Finalize, constraints, inputsChanged);
+        auto& storedKey = node->constraintsKey(DirtyBits::Finalize);
+        bool childInputsChanged = inputsChanged && storedKey != key;
         auto reason = recomputeReason(node, DirtyBits::Finalize, key);
         if (reason != instrumentation::RecomputeReason::None) {
             instrumentation::recordRecompute(node->id, instrumentation::Phase::Finalize, reason);
@@ -1228,16 +1600,25 @@ namespace tree {
             auto& atomized = *node->atomized;
             auto& layout = *node->layout;
             auto& placed = *node->placed;
-            auto finalized = node->element->finalize(constraints, node->shared, measured, atomized, layout, placed);
-            node->finalized = finalized;
-            node->constraintsKey = key;
+            node->element->finalize(constraints, node->shared, measured, atomized, layout, placed);
+            storedKey = key;
         }
 
         for (auto& child : node->children) {
-            finalizePhase(child.get(), constraints);
+            if (!childInputsChanged && !subtreeHasDirty(child.get(), DirtyBits::Finalize)) continue;
+            finalizePhase(child.get(), constraints, childInputsChanged);
         }
     }
 
+    const HitTestIndex& RenderTree::currentHitTestIndex() {
+        auto& renderOrder = sortedRenderOrder();
+        if (hitTestIndexDirty) {
+            hitTestIndex.build(renderOrder);
+            hitTestIndexDirty = false;
+        }
+        return hitTestIndex;
+    }
+
     TreeNode* RenderTree::hitTestRecursive(TreeNode* node, simd_float2 point) {
         auto startedAt = std::chrono::steady_clock::time_point{};
         if constexpr (instrumentation::enabled) {
@@ -1247,9 +1628,9 @@ namespace tree {
         TreeNode* hit = nullptr;
 
         if (node) {
-            auto& renderOrder = sortedRenderOrder();
-            for (auto it = renderOrder.rbegin(); it != renderOrder.rend(); ++it) {
-                auto* candidate = *it;
+            auto translations = scrollTranslations();
+            currentHitTestIndex().candidates(point, translations, hitTestCandidates);
+            for (auto* candidate : hitTestCandidates) {
                 auto isInSubtree = node->paintPreorderIndex <= candidate->paintPreorderIndex
                     && candidate->paintPostorderIndex <= node->paintPostorderIndex;
                 if (!isInSubtree) {
@@ -1257,7 +1638,7 @@ namespace tree {
                 }
 
                 nodesExamined++;
-                if (candidate->contains(point)) {
+                if (candidate->contains(point, translations)) {
                     hit = candidate;
                     break;
                 }
@@ -1280,17 +1661,18 @@ namespace tree {
             startedAt = std::chrono::steady_clock::now();
         }
         std::vector<TreeNode*> hits;
-        auto& renderOrder = sortedRenderOrder();
+        auto translations = scrollTranslations();
+        currentHitTestIndex().candidates(point, translations, hitTestCandidates);
 
-        for (auto it = renderOrder.rbegin(); it != renderOrder.rend(); ++it) {
-            if ((*it)->contains(point)) {
-                hits.push_back(*it);
+        for (auto* candidate : hitTestCandidates) {
+            if (candidate->contains(point, translations)) {
+                hits.push_back(candidate);
             }
         }
 
         if constexpr (instrumentation::enabled) {
             instrumentation::recordHitTest(
-                renderOrder.size(),
+                hitTestCandidates.size(),
                 hits.size(),
                 std::chrono::steady_clock::now() - startedAt
             );
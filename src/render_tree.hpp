@@ -3,10 +3,15 @@
 #include "element.hpp"
 #include "flex.hpp"
 #include "grid.hpp"
+#include "hit_test_index.hpp"
 #include "instrumentation.hpp"
 #include "new_arch.hpp"
+#include "parallel.hpp"
+#include "render_snapshot.hpp"
 #include "renderer_constants.hpp"
+#include <mutex>
 #include <source_location>
+#include <span>
 #include <unordered_map>
 
 namespace tree {
@@ -17,6 +22,44 @@ namespace tree {
     using layout::LayoutEngine;
     using runtime::UIContext;
 
+    // Interns clip stacks as (parent chain, clip rect) -> id so constraints keys
+    // compare one integer instead of every ClipUniform down from the root. Ids are
+    // never reused, so clearing the table only costs a conservative recompute.
+    struct ClipChainTable {
+        uint64_t intern(uint64_t parent, const style::ClipUniform& clip);
+        size_t size() const { return entries.size(); }
+        void clear() { entries.clear(); }
+
+    private:
+        struct Entry {
+            uint64_t parent;
+            style::ClipUniform clip;
+            uint64_t id;
+        };
+
+        std::unordered_multimap<std::size_t, Entry> entries;
+        uint64_t nextId{1};
+    };
+
+    // A scroll container's content, laid out once as if it were never scrolled.
+    // Scrolling only changes offset here; shaders and hit testing add the sum
+    // of a layer's offsets and its ancestors' to everything positioned in it.
+    struct ScrollLayer {
+        uint32_t parent{};
+        simd_float2 offset{0.0f, 0.0f}; // how far the content moves on screen
+        bool rtl{};
+    };
+
+    // Serial lays every subtree out on the calling thread. Parallel hands
+    // independent child subtrees (out-of-flow children once the cursor reaches
+    // them, flex/grid items once their sizes are resolved) to the shared
+    // Parallel scheduler and joins them in child order, so both give the same
+    // layout bit for bit.
+    enum class LayoutMode : uint8_t {
+        Serial,
+        Parallel
+    };
+
     struct RenderTree {
         template<ElementType E, typename P>
             requires ProcessorType<P, typename E::StorageType, typename E::DescriptorType, typename E::UniformsType>
@@ -29,23 +72,37 @@ namespace tree {
         
         bool requiresFrame(const FrameInfo& frameInfo) const;
         void update(const FrameInfo& frameInfo, uint64_t frameIndex);
-        void render(MTL::RenderCommandEncoder* encoder); 
+        // Records the finalized tree into snapshot in paint order, replacing what
+        // it held. Only reads the tree, so it runs wherever update last ran.
+        void buildSnapshot(RenderSnapshot& snapshot);
+        // The contentGeneration a snapshot must carry for buildSnapshot to only
+        // refresh its scroll layers; 0 when it would record everything anyway.
+        uint64_t reusableGeneration() const { return renderOrderDirty ? 0 : contentGeneration; }
         void markDirty(std::source_location source = std::source_location::current());
         void markDirty(
             TreeNode* node,
             DirtyBits bits,
             std::source_location source = std::source_location::current()
         );
+        // Moves a scroll container's content to its new scrollOffset. Nothing
+        // is laid out again: the next frame only rewrites the layer translations
+        // and reuses the snapshot it recorded last.
+        void markScrolled(TreeNode* node);
+        // window-space translation of every scroll layer, indexed by layer
+        std::span<const simd_float2> scrollTranslations();
   
         TreeNode* hitTestRecursive(TreeNode* node, simd_float2 point);
         std::vector<TreeNode*> hitTestAll(simd_float2 point);
         
 
-        void measurePhase(TreeNode* node, Constraints& constraints);
-        Result<void> atomizePhase(
-            TreeNode* node,
-            Constraints& constraints
-        );
+        // inputsChanged=false means the caller is passing the same constraints as last
+        // update, so the node's stored key is reused instead of rehashing; clean subtrees
+        // whose inputs did not change are skipped entirely
+        void measurePhase(TreeNode* node, Constraints& constraints, bool inputsChanged = true);
+        // Walks the dirty part of the tree serially (bidi inputs, keys, dirty bits)
+        // to find the nodes to atomize, prepares them all across the shared
+        // Parallel scheduler, then commits them one by one in tree order.
+        Result<void> atomizePhase(TreeNode* node, Constraints& constraints);
 
         void preLayoutPhase(TreeNode* node, const FrameInfo& frameInfo, Constraints& constraints);
 
@@ -62,12 +119,38 @@ namespace tree {
             Constraints constraints,
             layout::Measured measured
         );
+        // Origins are in the given scroll layers, never including a scroll offset,
+        // so scrolling leaves every key here unchanged.
         void postLayoutPhase(TreeNode* node, const FrameInfo& frameInfo, Constraints& constraints,
-                             simd_float2 parentGlobalOrigin, simd_float2 absBlockGlobalOrigin);
+                             simd_float2 parentGlobalOrigin, simd_float2 absBlockGlobalOrigin,
+                             uint32_t parentLayer = 0, uint32_t absBlockLayer = 0);
+
+        void placePhase(TreeNode* node, const FrameInfo& frameInfo, Constraints& constraints, bool inputsChanged = true);
+        void finalizePhase(TreeNode* node, Constraints& constraints, bool inputsChanged = true);
 
-        void placePhase(TreeNode* node, const FrameInfo& frameInfo, Constraints& constraints);
-        void finalizePhase(TreeNode* node, Constraints& constraints);
+        void setLayoutMode(LayoutMode mode) { layoutMode = mode; }
+        LayoutMode getLayoutMode() const { return layoutMode; }
+
+        // func(i) for every i in [0, count). A call may only lay out (or
+        // speculate on) its own item's subtree, since in parallel mode they run
+        // at the same time; callers combine the results in index order.
+        template<typename Func>
+        void layoutIndependent(size_t count, Func&& func) {
+            if (layoutMode == LayoutMode::Parallel) {
+                Parallel::for_index(count, func);
+                return;
+            }
+            for (size_t i = 0; i < count; ++i) func(i);
+        }
     private:
+        // a node atomizePhase recomputes, with the constraints it was reached with
+        struct AtomizeJob {
+            TreeNode* node;
+            Constraints constraints;
+        };
+
+        Result<void> collectAtomizeJobs(TreeNode* node, Constraints& constraints, bool inputsChanged);
+
         layout::LayoutOutput layoutRecursive(
             TreeNode* node,
             const FrameInfo& frameInfo,
@@ -85,24 +168,42 @@ namespace tree {
             const Constraints& constraints,
             const layout::Measured& measured
         ) const;
+        void setTextOverflow(Constraints& constraints, const std::optional<style::TextOverflow>& overflow) const;
+        uint32_t internTextOverflow(const std::optional<style::TextOverflow>& overflow) const;
+        ConstraintsKey phaseKey(TreeNode* node, DirtyBits phase, const Constraints& constraints, bool inputsChanged) const;
         instrumentation::RecomputeReason recomputeReason(
             TreeNode* node,
             DirtyBits bit,
             const ConstraintsKey& incomingKey
         ) const;
         void markSubtreeDirty(TreeNode* node, DirtyBits bits);
+        void evictSpeculativeLayouts(TreeNode* node);
+        void relayoutBoundaries(const FrameInfo& frameInfo);
         void clearDirty(TreeNode* node);
         bool subtreeHasDirty(TreeNode* node, DirtyBits bits) const;
         const std::vector<TreeNode*>& sortedRenderOrder();
+        const HitTestIndex& currentHitTestIndex();
+        std::pair<uint32_t, uint32_t> recordHitClips(RenderSnapshot& snapshot, const LayoutResult& layout);
 
         bool needsUpdate{true};
-        // Retain dirty bits briefly after a mutation so every FrameBufferedBuffer slot
-        // receives the new retained data before the node becomes clean.
-        uint64_t pendingFrameBufferWrites{MaxOutstandingFrameCount};
+        bool scrollPending{false};
+        // a fresh nextLayoutGeneration() whenever update() runs phases, so no
+        // two trees share one; a snapshot recorded at the current value only
+        // needs its scroll layers refreshed
+        uint64_t contentGeneration{0};
+        LayoutMode layoutMode{LayoutMode::Serial};
         std::optional<FrameInfo> lastFrameInfo;
-        uint64_t layoutGeneration{0};
+        uint64_t layoutGeneration{0}; // bumped per layout pass
         bool renderOrderDirty{true};
         std::vector<TreeNode*> renderOrderCache;
+        HitTestIndex hitTestIndex;
+        bool hitTestIndexDirty{true};
+        std::vector<TreeNode*> hitTestCandidates;
+        std::vector<elements::ElementBase*> renderBatch; // scratch for buildSnapshot()
+        std::vector<RenderSnapshot::HitClip> hitClipScratch; // scratch for recordHitClips()
+        std::vector<AtomizeJob> atomizeJobs; // scratch for atomizePhase()
+        // boundaries that stopped a Layout dirty on its way to the root
+        std::vector<TreeNode*> pendingRelayoutRoots;
 
 
         Constraints rootConstraints; 
@@ -113,6 +214,14 @@ namespace tree {
         std::unique_ptr<TreeNode> elementTree;
         LayoutEngine layoutEngine;
 
-        std::unordered_map<ConstraintsKey, layout::LayoutOutput> speculativeLayoutCache;
+        ClipChainTable clipChains;
+        // index 0 is the page; like clip chain ids, layers are never reused
+        std::vector<ScrollLayer> scrollLayers{ScrollLayer{}};
+        std::vector<simd_float2> scrollTranslationCache;
+        bool scrollTranslationsDirty{true};
+        // distinct overflow endings seen so far; a handful per app
+        mutable std::vector<style::TextOverflow> textOverflows;
+        // layout tasks intern overflows from several threads
+        mutable std::mutex textOverflowMutex;
     };
 }
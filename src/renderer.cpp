@@ -11,10 +11,9 @@
 #include "svg.hpp"
 #include "tree_manager.hpp"
 #include "new_arch.hpp"
-#include <simd/vector_types.h>
+#include "simd_types.hpp"
 #include "index.hpp"
 #include "inspector.hpp"
-#include "instrumentation.hpp"
 
 
 
@@ -43,6 +42,10 @@ Renderer::Renderer(MTL::Device* device, MTK::View* view):
     rootNode->shared.height = style::Size::percent(1.0);
     rootTree.markDirty();
     makeResources();
+
+    // index() built the tree on this thread; from here on it belongs to the layout thread
+    layoutFrameInfo = getFrameInfo();
+    layoutThread = std::make_unique<tree::LayoutThread>(rootTree, layoutFrameInfo);
 }
 
 MTL::DepthStencilState* Renderer::getDefaultDepthStencilState()
@@ -72,35 +75,51 @@ void Renderer::makeResources()
 void Renderer::registerInspector(Inspector::Inspector& inspector)
 {
     if constexpr (GUI_INSPECTOR_ENABLED) {
-        tree::TreeStack::pushTree(&rootTree);
-        inspector.visualizer();
+        post([this, &inspector](tree::RenderTree&) {
+            tree::TreeStack::pushTree(&rootTree);
+            inspector.visualizer();
+        });
+        layoutThread->flush();
     }
 }
 
+void Renderer::post(tree::LayoutThread::Mutation mutation)
+{
+    layoutThread->post(std::move(mutation));
+}
+
 void Renderer::draw() {
     auto frameInfo = getFrameInfo();
-    if (!rootTree.requiresFrame(frameInfo)) return;
+    if (frameInfo != layoutFrameInfo) {
+        layoutFrameInfo = frameInfo;
+        layoutThread->resize(frameInfo);
+    }
+    // a mutation that threw on the layout thread surfaces here, where an
+    // event handler's exception used to
+    layoutThread->rethrowFailure();
 
-    instrumentation::FrameTimer frameTimer{ctx.frameIndex};
+    // update and recording run on the layout thread (which also times them);
+    // a vsync it has published nothing new for presents nothing
+    auto snapshot = layoutThread->latest();
+    if (!snapshot || snapshot->generation == presentedGeneration) return;
+    presentedGeneration = snapshot->generation;
 
     NS::AutoreleasePool* autoreleasePool = NS::AutoreleasePool::alloc()->init();
-    
+    uint64_t frameIndex = ctx.frameIndex;
+
+    auto ts1 = clock.now();
     this->frameSemaphore.acquire();
     
     MTL::CommandBuffer* commandBuffer = commandQueue->commandBuffer();
     MTL::RenderPassDescriptor* renderPassDescriptor = view->currentRenderPassDescriptor();
     MTL::RenderCommandEncoder* renderCommandEncoder = commandBuffer->renderCommandEncoder(renderPassDescriptor);
     // renderCommandEncoder->setDepthStencilState(getDefaultDepthStencilState());
-    uint64_t frameIndex = ctx.frameIndex;
+    // the semaphore guarantees this slot's previous command buffer has completed
+    ctx.frameArena.beginFrame(frameIndex);
 
-    auto ts1 = clock.now();
-    {
-        instrumentation::PhaseTimer timer{instrumentation::Phase::Update};
-        rootTree.update(frameInfo, frameIndex);
-    }
     {
-        instrumentation::PhaseTimer timer{instrumentation::Phase::Render};
-        rootTree.render(renderCommandEncoder);
+        gpu::MetalRenderEncoder encoder{renderCommandEncoder};
+        snapshot->encode(&encoder, ctx.frameArena);
     }
 
     auto ts2 = clock.now();
@@ -141,8 +160,12 @@ FrameInfo Renderer::getFramePixelSize() {
 }
 
 FrameInfo Renderer::getFrameInfo() {
-    auto frameDimensions = this->view->drawableSize();
-    auto scale = AppKit_Extensions::getContentScaleFactor(reinterpret_cast<void*>(this->view));
+    return frameInfoFor(this->view);
+}
+
+FrameInfo Renderer::frameInfoFor(MTK::View* view) {
+    auto frameDimensions = view->drawableSize();
+    auto scale = AppKit_Extensions::getContentScaleFactor(reinterpret_cast<void*>(view));
 
     return {.width=static_cast<float>(frameDimensions.width)/2.0f, .height=static_cast<float>(frameDimensions.height)/2.0f, .scale = scale};
 }
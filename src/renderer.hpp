@@ -8,12 +8,14 @@
 #pragma once
 #include <semaphore>
 #include "frame_info.hpp"
+#include "gpu_metal.hpp"
 #include "new_arch.hpp"
 #include "div.hpp"
 #include "image.hpp"
 #include <chrono>
 #include "text.hpp"
 #include "element.hpp"
+#include "layout_thread.hpp"
 #include "renderer_constants.hpp"
 #include "context_manager.hpp"
 #include "tree_manager.hpp"
@@ -33,8 +35,12 @@ public:
     void makeResources();
     void registerInspector(Inspector::Inspector& inspector);
     void draw();
+    // the only way to touch rootTree once the renderer is up; runs on the
+    // layout thread ahead of its next update
+    void post(tree::LayoutThread::Mutation mutation);
     FrameInfo getFramePixelSize();
     FrameInfo getFrameInfo();
+    static FrameInfo frameInfoFor(MTK::View* view);
     
     void makeCurrent();
     static bool hasActiveRenderer();
@@ -53,6 +59,10 @@ public:
     elements::Image<> img;
     elements::Text<> txt;
     tree::RenderTree rootTree;
+    // updates rootTree and records snapshots; declared after it, so it stops first
+    std::unique_ptr<tree::LayoutThread> layoutThread;
+    FrameInfo layoutFrameInfo{}; // last size handed to layoutThread
+    uint64_t presentedGeneration{0};
 
     std::chrono::high_resolution_clock clock {};
     
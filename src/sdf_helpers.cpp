@@ -6,7 +6,7 @@
 //
 
 #include "sdf_helpers.hpp"
-#include <simd/vector_types.h>
+#include "simd_types.hpp"
 
 float rounded_rect_sdf(simd_float2 pt, simd_float2 halfExtent, simd_float2 r) {
     const float epsilon = 0.0001;
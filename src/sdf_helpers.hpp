@@ -7,6 +7,6 @@
 
 #pragma once
 #include <cmath>
-#include "metal_imports.hpp"
+#include "simd_types.hpp"
 
 float rounded_rect_sdf(simd_float2 pt, simd_float2 halfExtent, simd_float2 r);
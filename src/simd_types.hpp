@@ -0,0 +1,36 @@
+//
+//  simd_types.hpp
+//  gui
+//
+
+#pragma once
+
+// The core only needs the simd vector types plus a couple of helpers. On Apple
+// they come from <simd/simd.h>; elsewhere we mirror them with clang ext vectors
+// so layout/text can build without the Apple SDK (gui_core requires clang).
+#ifdef __APPLE__
+#include <simd/simd.h>
+#else
+#include <cmath>
+#include <cstdint>
+
+typedef float simd_float2 __attribute__((ext_vector_type(2)));
+typedef float simd_float3 __attribute__((ext_vector_type(3)));
+typedef float simd_float4 __attribute__((ext_vector_type(4)));
+typedef int32_t simd_int2 __attribute__((ext_vector_type(2)));
+typedef uint32_t simd_uint2 __attribute__((ext_vector_type(2)));
+
+namespace simd {
+    inline float clamp(float x, float lo, float hi) {
+        return std::fmin(std::fmax(x, lo), hi);
+    }
+
+    inline simd_float2 abs(simd_float2 v) {
+        return simd_float2{std::fabs(v.x), std::fabs(v.y)};
+    }
+
+    inline float length(simd_float2 v) {
+        return std::sqrt(v.x * v.x + v.y * v.y);
+    }
+}
+#endif
@@ -39,6 +39,8 @@ namespace style {
         static Size autoSize()        { return {0.0f, Unit::Auto}; }
         static Size fr(float v)       { return {v, Unit::Fr}; }
 
+        bool operator==(const Size&) const = default;
+
         bool isAuto() const { return unit == Unit::Auto; }
         bool isFr() const { return unit == Unit::Fr; }
 
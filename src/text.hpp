@@ -6,12 +6,14 @@
 //
 
 #pragma once
-#include "frame_buffered_buffer.hpp"
+#include "frame_arena.hpp"
 #include "element.hpp"
 #include "renderer_constants.hpp"
 #include "freetype.hpp"
 #include "glyphs.hpp"
 #include "glyphCache.hpp"
+#include "glyph_table.hpp"
+#include "hash_combine.hpp"
 #include <mutex>
 #include <optional>
 #include <print>
@@ -19,7 +21,11 @@
 #include "overloaded.hpp"
 #include "utf8.hpp"
 #include "textShaper.hpp"
+#include "text_breaks.hpp"
 #include <any>
+#include <memory>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
 namespace elements {
@@ -40,11 +46,17 @@ namespace elements {
     using style::WhiteSpace;
     using style::WordBreak;
 
-    struct TextPoint {
-        simd_float2 point;
+    // distinct (ending, font, size, direction) combinations kept shaped
+    constexpr size_t MaxOverflowEndings = 64;
+
+    // One drawn glyph: its bounds in font units, the shaper's offset and its
+    // GlyphTable entry. The vertex stage expands it into a quad, and its position
+    // comes from the placements buffer at the same (instance) index.
+    struct GlyphInstance {
+        simd_float2 topLeft;
+        simd_float2 bottomRight;
         simd_float2 shapingOffset;
-        int metadataIndex;
-        int id;
+        int glyphIndex;
     };
 
     struct TextRequestPayload {
@@ -53,11 +65,11 @@ namespace elements {
 }
 
 template <>
-struct std::formatter<elements::TextPoint> : std::formatter<float>
+struct std::formatter<elements::GlyphInstance> : std::formatter<float>
 {
-    auto format(const elements::TextPoint& v, format_context& ctx) const
+    auto format(const elements::GlyphInstance& v, format_context& ctx) const
     {
-            return std::format_to(ctx.out(), "(x: {}, y: {}, ox: {}, oy: {}, mi: {} id: {})", v.point.x, v.point.y, v.shapingOffset.x, v.shapingOffset.y, v.metadataIndex, v.id);
+            return std::format_to(ctx.out(), "(x0: {}, y0: {}, x1: {}, y1: {}, ox: {}, oy: {}, gi: {})", v.topLeft.x, v.topLeft.y, v.bottomRight.x, v.bottomRight.y, v.shapingOffset.x, v.shapingOffset.y, v.glyphIndex);
     }
 };
 
@@ -97,28 +109,37 @@ namespace elements {
         simd_float4 color;
         float fontSize;
         uint32_t numClips;
+        uint32_t scrollLayer; // see LayoutResult::scrollLayer
     };
 
 
-    struct TextStorage {
-        TextStorage(UIContext& ctx):
-            atomsBuffer{ctx.allocator, 6 * sizeof(TextPoint) * 4, MaxOutstandingFrameCount},
-            drawablePointsBuffer{ctx.allocator, 6 * sizeof(TextPoint) * 4, MaxOutstandingFrameCount},
-            placementsBuffer{ctx.allocator, sizeof(simd_float2) * 4, MaxOutstandingFrameCount},
-            uniformsBuffer{ctx.allocator, sizeof(TextUniforms), MaxOutstandingFrameCount},
-            metadataBuffer{ctx.allocator,sizeof(int) * 16, MaxOutstandingFrameCount },
-            clipsBuffer{ctx.allocator, sizeof(ClipUniform) * 4, MaxOutstandingFrameCount}
-        {}
+    // glyph an instance draws; the GlyphTable index is filled in at commit
+    struct PendingGlyph {
+        GlyphQuery query{};
+        const Glyph* glyph{}; // null for instances that draw nothing
+    };
+
+    // What TextProcessor::prepareAtoms computes off the main thread, held until
+    // commitAtoms turns it into buffers and the node's Atomized.
+    struct PreparedText {
+        std::vector<Atom> atoms;
+        std::vector<GlyphInstance> instances;
+        std::vector<PendingGlyph> glyphs; // one per instance
+        ShapedRun shapedRun;
+        TextBreaks textBreaks;
+    };
 
-        FrameBufferedBuffer<TextPoint> atomsBuffer;
-        FrameBufferedBuffer<TextPoint> drawablePointsBuffer;
-        FrameBufferedBuffer<simd_float2> placementsBuffer;
-        FrameBufferedBuffer<TextUniforms> uniformsBuffer;
+    struct TextStorage {
+        TextStorage(UIContext&) {}
 
-        FrameBufferedBuffer<int> metadataBuffer;
-        FrameBufferedBuffer<ClipUniform> clipsBuffer;
-        size_t sourceMetadataCount{};
+        FrameData<GlyphInstance> atomsBuffer;
+        FrameData<GlyphInstance> drawableAtomsBuffer;
+        FrameData<simd_float2> placementsBuffer;
+        FrameData<TextUniforms> uniformsBuffer;
+        FrameData<ClipUniform> clipsBuffer;
         ShapedRun shapedRun;
+        TextBreaks textBreaks;
+        PreparedText prepared; // filled by prepareAtoms, drained by commitAtoms
     };
 
     template <typename S = TextStorage>
@@ -148,6 +169,8 @@ namespace elements {
                 }
                 case RequestTarget::TextShaping:
                     return &fragment.fragmentStorage.shapedRun;
+                case RequestTarget::TextBreaks:
+                    return static_cast<const TextBreaks*>(&fragment.fragmentStorage.textBreaks);
                 default: {
                     return std::any{};
                 }
@@ -166,8 +189,7 @@ namespace elements {
     struct TextProcessor {
         TextProcessor(UIContext& ctx):
             glyphCache{},
-            lastGlyphsBufferOffset{0},
-            glyphBuffer{ctx.allocator.allocate(4096)},
+            glyphTable{ctx.allocator},
             ctx{ctx}
         {
             // FT_Init_FreeType(&(this->ft));
@@ -176,77 +198,33 @@ namespace elements {
             // glyphCache = GlyphCache{this->ft};
         }
         
-        void buildPipeline(MTL::RenderPipelineState*& pipeline) {
-            MTL::Library* defaultLibrary = ctx.device->newDefaultLibrary();
-            MTL::RenderPipelineDescriptor* renderPipelineDescriptor = MTL::RenderPipelineDescriptor::alloc()->init();
-        
-            // set up vertex descriptor
-            MTL::VertexDescriptor* vertexDescriptor = MTL::VertexDescriptor::alloc()->init();
-            vertexDescriptor->attributes()->object(0)->setFormat(MTL::VertexFormat::VertexFormatFloat2);
-            vertexDescriptor->attributes()->object(0)->setOffset(0);
-            vertexDescriptor->attributes()->object(0)->setBufferIndex(0);
-        
-            vertexDescriptor->attributes()->object(1)->setFormat(MTL::VertexFormat::VertexFormatInt);
-            vertexDescriptor->attributes()->object(1)->setOffset(sizeof(simd_float2) * 2);
-            vertexDescriptor->attributes()->object(1)->setBufferIndex(0);
-        
-            vertexDescriptor->attributes()->object(2)->setFormat(MTL::VertexFormat::VertexFormatInt);
-            vertexDescriptor->attributes()->object(2)->setOffset(sizeof(simd_float2) * 2 + sizeof(int));
-            vertexDescriptor->attributes()->object(2)->setBufferIndex(0);
+        std::unique_ptr<gpu::RenderPipeline> buildPipeline() {
+            gpu::RenderPipelineDescriptor descriptor {
+                .label = "text",
+                .vertexFunction = "vertex_text",
+                .fragmentFunction = "fragment_text",
+                .attributes = {},
+                .stride = 0,
+                .blend = {
+                    .sourceRGB = gpu::BlendFactor::One,
+                    .destinationRGB = gpu::BlendFactor::OneMinusSourceAlpha,
+                    .sourceAlpha = gpu::BlendFactor::SourceAlpha,
+                    .destinationAlpha = gpu::BlendFactor::OneMinusSourceAlpha
+                }
+            };
 
-            vertexDescriptor->attributes()->object(3)->setFormat(MTL::VertexFormat::VertexFormatFloat2);
-            vertexDescriptor->attributes()->object(3)->setOffset(sizeof(simd_float2));
-            vertexDescriptor->attributes()->object(3)->setBufferIndex(0);
-    
-        
-            vertexDescriptor->layouts()->object(0)->setStride(sizeof(TextPoint));
-        
-            renderPipelineDescriptor->setVertexDescriptor(vertexDescriptor);
-        
-        
-            // set up vertex function
-            MTL::Function* vertexFunction = defaultLibrary->newFunction(NS::String::string("vertex_text", NS::UTF8StringEncoding));
-            renderPipelineDescriptor->setVertexFunction(vertexFunction);
-        
-            renderPipelineDescriptor->colorAttachments()->object(0)->setPixelFormat(ctx.view->colorPixelFormat());
-            renderPipelineDescriptor->colorAttachments()->object(0)->setBlendingEnabled(true);
-            renderPipelineDescriptor->colorAttachments()->object(0)->setAlphaBlendOperation(MTL::BlendOperationAdd);
-            renderPipelineDescriptor->colorAttachments()->object(0)->setSourceRGBBlendFactor(MTL::BlendFactorOne);
-            renderPipelineDescriptor->colorAttachments()->object(0)->setDestinationRGBBlendFactor(MTL::BlendFactorOneMinusSourceAlpha);
-            renderPipelineDescriptor->colorAttachments()->object(0)->setSourceAlphaBlendFactor(MTL::BlendFactorSourceAlpha);
-            renderPipelineDescriptor->colorAttachments()->object(0)->setDestinationAlphaBlendFactor(MTL::BlendFactorOneMinusSourceAlpha);
-        
-        
-            renderPipelineDescriptor->setDepthAttachmentPixelFormat(ctx.view->depthStencilPixelFormat());
-        
-        
-            // set up fragment function
-            MTL::Function* fragmentFunction = defaultLibrary->newFunction(NS::String::string("fragment_text", NS::UTF8StringEncoding));
-            renderPipelineDescriptor->setFragmentFunction(fragmentFunction);
-        
-        
-            NS::Error* error = nullptr;
-            pipeline = ctx.device->newRenderPipelineState(renderPipelineDescriptor, &error);
-        
-            if (error != nullptr)
-                std::println("error in pipeline creation: {}", error->localizedDescription()->utf8String());
-        
-        
-            defaultLibrary->release();
-            renderPipelineDescriptor->release();
-            vertexDescriptor->release();
-            vertexFunction->release();
+            return ctx.device->newRenderPipeline(descriptor);
         }
         
-        MTL::RenderPipelineState* getPipeline() {
+        gpu::RenderPipeline* getPipeline() {
             static std::once_flag initFlag;
-            static MTL::RenderPipelineState* pipeline = nullptr;
+            static std::unique_ptr<gpu::RenderPipeline> pipeline;
         
             std::call_once(initFlag, [&](){
-                buildPipeline(pipeline);
+                pipeline = buildPipeline();
             });
         
-            return pipeline;
+            return pipeline.get();
         }
         
         Measured measure(Fragment<S>& fragment, Constraints& constraints, SharedDescriptor& shared, TextDescriptor& desc) {
@@ -259,14 +237,12 @@ namespace elements {
             return measured;
         }
 
-        std::array<TextPoint, 6> makeAtomPoints(const Quad& quad, int metadataIndex, int id, simd_float2 shapingOffset = {}) {
-            return std::array<TextPoint,6>{
-                TextPoint{ .point = quad.topLeft, .shapingOffset = shapingOffset, .metadataIndex = metadataIndex, .id = id },
-                TextPoint{ .point = simd_float2{ quad.bottomRight.x, quad.topLeft.y }, .shapingOffset = shapingOffset, .metadataIndex = metadataIndex, .id = id },
-                TextPoint{ .point = simd_float2{ quad.topLeft.x,    quad.bottomRight.y }, .shapingOffset = shapingOffset, .metadataIndex = metadataIndex, .id = id },
-                TextPoint{ .point = simd_float2{ quad.topLeft.x,    quad.bottomRight.y }, .shapingOffset = shapingOffset, .metadataIndex = metadataIndex, .id = id },
-                TextPoint{ .point = simd_float2{ quad.bottomRight.x, quad.topLeft.y }, .shapingOffset = shapingOffset, .metadataIndex = metadataIndex, .id = id },
-                TextPoint{ .point = quad.bottomRight, .shapingOffset = shapingOffset, .metadataIndex = metadataIndex, .id = id }
+        GlyphInstance makeGlyphInstance(const Quad& quad, int glyphIndex, simd_float2 shapingOffset = {}) {
+            return GlyphInstance{
+                .topLeft = quad.topLeft,
+                .bottomRight = quad.bottomRight,
+                .shapingOffset = shapingOffset,
+                .glyphIndex = glyphIndex
             };
         }
 
@@ -276,8 +252,8 @@ namespace elements {
             bool collapseWhitespace,
             bool preserveLineFeeds,
             std::vector<Atom>& atoms,
-            std::vector<TextPoint>& points,
-            std::vector<int>& metadata,
+            std::vector<GlyphInstance>& instances,
+            std::vector<PendingGlyph>& glyphs,
             std::span<const bidi::TextShapingRun> bidiRuns
         ) {
             float fontSize = 0.0;
@@ -286,7 +262,8 @@ namespace elements {
             }
 
             float scale = fontSize / BASE_PIXEL_HEIGHT;
-            float defaultLineHeight = glyphCache.lineHeight(desc.font) / FT_PIXEL_CF * scale;
+            FontId font = FontRegistry::shared().intern(desc.font);
+            float defaultLineHeight = glyphCache.lineHeight(font) / FT_PIXEL_CF * scale;
             float resolvedLineHeight = defaultLineHeight * desc.lineHeight.value_or(1.0f);
 
             std::string renderedText{text};
@@ -313,7 +290,7 @@ namespace elements {
                     renderedText,
                     run.byteStart,
                     run.byteLength,
-                    desc.font,
+                    font,
                     run.isRtl() ? TextDirection::Rtl : TextDirection::Ltr,
                     run.scriptTag
                 );
@@ -338,21 +315,15 @@ namespace elements {
                     bool sourceLineFeed = codepoint == U'\r' || codepoint == U'\n';
 
                     if (preserveLineFeeds && sourceLineFeed) {
-                        int metadataIndex = metadata.size();
-                        metadata.push_back(0);
-                        metadata.push_back(static_cast<int>(CurveType::Quadratic));
-                        metadata.push_back(0);
-
                         Quad emptyQuad {
                             .topLeft = {0.0f, 0.0f},
                             .bottomRight = {0.0f, 0.0f}
                         };
-                        auto atomPts = makeAtomPoints(emptyQuad, metadataIndex, atoms.size());
-                        points.insert(points.end(), atomPts.begin(), atomPts.end());
+                        instances.push_back(makeGlyphInstance(emptyQuad, GlyphTable::EmptyGlyph));
+                        glyphs.push_back({});
 
-                        atom.atomBufferHandle = glyphBuffer.handle();
-                        atom.length = sizeof(TextPoint) * 6;
-                        atom.offset = (points.size() - 6) * sizeof(TextPoint);
+                        atom.length = sizeof(GlyphInstance);
+                        atom.offset = (instances.size() - 1) * sizeof(GlyphInstance);
                         atom.width = 0;
                         atom.height = defaultLineHeight;
                         atom.lineHeight = resolvedLineHeight;
@@ -366,58 +337,18 @@ namespace elements {
                         atom.canPlaceOnNewLine = true;
                     }
 
-                    GlyphQuery glyphQuery { shapedGlyph.glyphId, desc.font };
-
-                    auto glyph = glyphCache.retrieve(glyphQuery);
-                    size_t pointsLenBytes = glyph.points.size() * sizeof(simd_float2);
-                    size_t offset = 0;
-
-                    // highly unoptimized coarse lock, for now
-                    {
-                        std::lock_guard<std::mutex> lock(glyphBufferMutex);
-                        auto offset_it = glyphBufferOffsets.find(glyphQuery);
-                        if (offset_it == glyphBufferOffsets.end()) {
-                            auto rawGlyphBuffer = glyphBuffer.get();
-                            size_t requiredSize = lastGlyphsBufferOffset + pointsLenBytes;
-
-                            if (requiredSize > rawGlyphBuffer->length()) {
-                                ctx.allocator.resize(glyphBuffer, requiredSize);
-                                rawGlyphBuffer = glyphBuffer.get();
-                            }
-
-                            auto copyStart =
-                                reinterpret_cast<std::byte*>(rawGlyphBuffer->contents()) + lastGlyphsBufferOffset;
-
-                            std::memcpy(copyStart, glyph.points.data(), pointsLenBytes);
-
-                            glyphBufferOffsets[glyphQuery] = lastGlyphsBufferOffset / sizeof(simd_float2);
-                            offset_it = glyphBufferOffsets.find(glyphQuery);
-                            lastGlyphsBufferOffset += pointsLenBytes;
-                        }
-
-                        offset = offset_it->second;
-                    }
-
-                    int metadataIndex = metadata.size();
-
-                    metadata.push_back(offset);
-                    metadata.push_back(static_cast<int>(glyph.curveType));
-                    metadata.push_back(glyph.numContours);
-                    for (auto& contourSize : glyph.contourSizes) {
-                        metadata.push_back(contourSize);
-                    }
+                    GlyphQuery glyphQuery { shapedGlyph.glyphId, font };
+                    const Glyph& glyph = glyphCache.retrieve(glyphQuery);
 
                     simd_float2 shapingOffset{
                         shapedGlyph.xOffset,
                         -shapedGlyph.yOffset
                     };
-                    auto atomPts = makeAtomPoints(glyph.quad, metadataIndex, atoms.size(), shapingOffset);
-
-                    points.insert(points.end(), atomPts.begin(), atomPts.end());
+                    instances.push_back(makeGlyphInstance(glyph.quad, GlyphTable::EmptyGlyph, shapingOffset));
+                    glyphs.push_back({glyphQuery, &glyph});
 
-                    atom.atomBufferHandle = glyphBuffer.handle();
-                    atom.length = sizeof(TextPoint) * 6;
-                    atom.offset = (points.size() - 6) * sizeof(TextPoint);
+                    atom.length = sizeof(GlyphInstance);
+                    atom.offset = (instances.size() - 1) * sizeof(GlyphInstance);
                     float glyphWidth = shapedGlyph.xAdvance / FT_PIXEL_CF * scale;
                     atom.width = collapsedWhitespace[shapedGlyph.byteOffset]
                         ? 0.0f
@@ -432,11 +363,24 @@ namespace elements {
             return shapedRun;
         }
 
-        Atomized atomize(Fragment<S>& fragment, Constraints& constraints, SharedDescriptor& shared, TextDescriptor& desc, Measured&) {
-            std::vector<Atom> atoms;
-            std::vector<TextPoint> allAtomPoints;
-            std::vector<int> metadata;
-            allAtomPoints.reserve(desc.text.size() * 6);
+        // Appending glyphs to the shared table is the only write appendTextAtoms
+        // would otherwise make, so it's done here, after the fact and serially.
+        void internGlyphs(std::vector<GlyphInstance>& instances, const std::vector<PendingGlyph>& glyphs) {
+            for (size_t i = 0; i < instances.size(); ++i) {
+                if (glyphs[i].glyph) {
+                    instances[i].glyphIndex = static_cast<int>(glyphTable.intern(glyphs[i].query, *glyphs[i].glyph));
+                }
+            }
+        }
+
+        // Shaping, glyph outlines and line-break data for one node. Touches only
+        // this node's storage and the thread-safe shaper and glyph cache, so
+        // RenderTree::atomizePhase runs it for many nodes at once.
+        void prepareAtoms(Fragment<S>& fragment, Constraints& constraints, SharedDescriptor& shared, TextDescriptor& desc, Measured&) {
+            auto& prepared = fragment.fragmentStorage.prepared;
+            prepared = {};
+            prepared.instances.reserve(desc.text.size());
+            prepared.glyphs.reserve(desc.text.size());
 
             bool collapseWhitespace =
                 desc.whiteSpace == WhiteSpace::Normal ||
@@ -445,32 +389,35 @@ namespace elements {
                 desc.whiteSpace == WhiteSpace::Pre ||
                 desc.whiteSpace == WhiteSpace::PreWrap;
 
-            fragment.fragmentStorage.shapedRun = appendTextAtoms(
+            prepared.shapedRun = appendTextAtoms(
                 desc.text,
                 desc,
                 collapseWhitespace,
                 preserveLineFeeds,
-                atoms,
-                allAtomPoints,
-                metadata,
+                prepared.atoms,
+                prepared.instances,
+                prepared.glyphs,
                 constraints.textBidiInput.value().runs
             );
+            prepared.textBreaks = buildTextBreaks(desc.text, prepared.shapedRun, prepared.atoms);
+        }
 
-            if (!allAtomPoints.empty()) {
-                size_t neededAtomsBytes = allAtomPoints.size() * sizeof(TextPoint);
-
-                fragment.fragmentStorage.atomsBuffer.write(ctx.frameIndex, allAtomPoints.data(), neededAtomsBytes);
-            }
-
-            size_t neededMetaBytes = metadata.size() * sizeof(int);
+        // The serial half: glyph table indices and the instance buffer write.
+        Atomized commitAtoms(Fragment<S>& fragment, Constraints&, SharedDescriptor&, TextDescriptor&, Measured&) {
+            auto& storage = fragment.fragmentStorage;
+            auto prepared = std::exchange(storage.prepared, {});
 
-            if (!metadata.empty()) {
-                fragment.fragmentStorage.metadataBuffer.write(ctx.frameIndex, metadata.data(), neededMetaBytes);
-            }
+            internGlyphs(prepared.instances, prepared.glyphs);
+            storage.shapedRun = std::move(prepared.shapedRun);
+            storage.textBreaks = std::move(prepared.textBreaks);
+            storage.atomsBuffer.write(prepared.instances.data(), prepared.instances.size() * sizeof(GlyphInstance));
 
-            fragment.fragmentStorage.sourceMetadataCount = metadata.size();
+            return Atomized{ .id = fragment.id, .atoms = std::move(prepared.atoms) };
+        }
 
-            return Atomized{ .id = fragment.id, .atoms = std::move(atoms) };
+        Atomized atomize(Fragment<S>& fragment, Constraints& constraints, SharedDescriptor& shared, TextDescriptor& desc, Measured& measured) {
+            prepareAtoms(fragment, constraints, shared, desc, measured);
+            return commitAtoms(fragment, constraints, shared, desc, measured);
         }
 
         LayoutResult layout(Fragment<S>& fragment, Constraints& constraints, SharedDescriptor& shared, TextDescriptor& desc, Measured& measured, Atomized& atomized) {
@@ -480,6 +427,82 @@ namespace elements {
             return lr;
         }
 
+        struct OverflowEnding {
+            std::vector<Atom> atoms;
+            std::vector<GlyphInstance> instances;
+            float width{};
+        };
+
+        struct OverflowEndingKey {
+            std::string text;
+            FontId font{};
+            float fontSize{};
+            float lineHeight{};
+            bool rtl{};
+
+            bool operator==(const OverflowEndingKey&) const = default;
+        };
+
+        struct OverflowEndingKeyHash {
+            size_t operator()(const OverflowEndingKey& key) const {
+                size_t seed = std::hash<std::string>{}(key.text);
+                hash_combine(seed, key.font);
+                hash_combine(seed, key.fontSize);
+                hash_combine(seed, key.lineHeight);
+                hash_combine(seed, key.rtl);
+                return seed;
+            }
+        };
+
+        // The ending's atoms depend only on what OverflowEndingKey holds, so it's
+        // shaped once and shared by every line fragment, node and frame that
+        // truncates with it. Callers hold a reference, so clearing the table
+        // when it fills never frees an ending still in use.
+        std::shared_ptr<const OverflowEnding> overflowEnding(const TextDescriptor& desc, const std::string& text, bool rtl) {
+            float fontSize = 0.0f;
+            if (desc.fontSize.unit == Unit::Pt) {
+                fontSize = desc.fontSize.resolveOr(Size::px(0.0f));
+            }
+            OverflowEndingKey key {
+                .text = text,
+                .font = FontRegistry::shared().intern(desc.font),
+                .fontSize = fontSize,
+                .lineHeight = desc.lineHeight.value_or(1.0f),
+                .rtl = rtl
+            };
+
+            {
+                std::lock_guard lock(overflowEndingMutex);
+                if (auto found = overflowEndings.find(key); found != overflowEndings.end()) {
+                    return found->second;
+                }
+            }
+
+            auto endingBidi = bidi::TextBidiContext::create(
+                text,
+                rtl ? bidi::BidiBaseDirection::Rtl : bidi::BidiBaseDirection::Ltr
+            );
+            std::vector<bidi::TextShapingRun> endingRuns;
+            if (endingBidi) {
+                auto resolvedRuns = endingBidi->runs();
+                endingRuns.assign(resolvedRuns.begin(), resolvedRuns.end());
+            }
+
+            auto ending = std::make_shared<OverflowEnding>();
+            std::vector<PendingGlyph> endingGlyphs;
+            appendTextAtoms(text, desc, true, false, ending->atoms, ending->instances, endingGlyphs, endingRuns);
+            internGlyphs(ending->instances, endingGlyphs);
+            for (const Atom& atom : ending->atoms) ending->width += atom.width;
+
+            // every font size an animation passes through is its own key
+            std::lock_guard lock(overflowEndingMutex);
+            if (overflowEndings.size() >= MaxOverflowEndings) {
+                overflowEndings.clear();
+            }
+            // another thread may have shaped the same ending meanwhile
+            return overflowEndings.try_emplace(std::move(key), std::move(ending)).first->second;
+        }
+
         Atomized postLayout(Fragment<S>& fragment, Constraints& constraints, SharedDescriptor& shared, TextDescriptor& desc, Measured& measured, Atomized& atomized, LayoutResult& layout) {
             atomized.usesDrawableAtoms = false;
             if (!constraints.textOverflow->drawsEnding()) return atomized;
@@ -492,17 +515,15 @@ namespace elements {
             atomized.drawableAtoms.clear();
             layout.drawableAtomOffsets.clear();
 
-            auto sourcePoints = reinterpret_cast<TextPoint*>(
-                fragment.fragmentStorage.atomsBuffer.getBuffer(ctx.frameIndex)->contents()
-            );
-            auto sourceMetadata = reinterpret_cast<int*>(
-                fragment.fragmentStorage.metadataBuffer.getBuffer(ctx.frameIndex)->contents()
-            );
-            std::vector<TextPoint> drawablePoints;
-            std::vector<int> drawableMetadata(
-                sourceMetadata,
-                sourceMetadata + fragment.fragmentStorage.sourceMetadataCount
+            auto sourceInstances = fragment.fragmentStorage.atomsBuffer.data();
+            std::vector<GlyphInstance> drawableInstances;
+            auto endingHandle = overflowEnding(
+                desc,
+                constraints.textOverflow->ending,
+                constraints.inheritedProperties.direction == Direction::rtl
             );
+            const auto& ending = *endingHandle;
+            const float endingWidth = ending.width;
 
             bool endingAdded = false;
             for (const auto& lineFragment : layout.inlineFormatting.lineFragments()) {
@@ -517,34 +538,7 @@ namespace elements {
 
                 size_t visibleStart = 0;
                 size_t visibleCount = lineFragment.atomCount;
-                float endingWidth = 0.0f;
-                std::vector<Atom> endingAtoms;
-                std::vector<TextPoint> endingPoints;
-                std::vector<int> endingMetadata;
-
-                auto endingBidi = bidi::TextBidiContext::create(
-                    constraints.textOverflow->ending,
-                    constraints.inheritedProperties.direction == Direction::rtl
-                        ? bidi::BidiBaseDirection::Rtl
-                        : bidi::BidiBaseDirection::Ltr
-                );
-                std::vector<bidi::TextShapingRun> endingRuns;
-                if (endingBidi) {
-                    auto resolvedRuns = endingBidi->runs();
-                    endingRuns.assign(resolvedRuns.begin(), resolvedRuns.end());
-                }
-
-                appendTextAtoms(
-                    constraints.textOverflow->ending,
-                    desc,
-                    true,
-                    false,
-                    endingAtoms,
-                    endingPoints,
-                    endingMetadata,
-                    endingRuns
-                );
-                for (const Atom& atom : endingAtoms) endingWidth += atom.width;
+                bool drawsEnding = !ending.atoms.empty();
 
                 if (!endingAdded && (isLtr
                         ? fragmentRight + endingWidth > visibleRight
@@ -568,9 +562,7 @@ namespace elements {
                     if (visibleCount == 0) {
                         visibleCount = std::min<size_t>(1, lineFragment.atomCount);
                         visibleStart = isLtr ? 0 : lineFragment.atomCount - visibleCount;
-                        endingAtoms.clear();
-                        endingPoints.clear();
-                        endingMetadata.clear();
+                        drawsEnding = false;
                     }
                 }
 
@@ -584,37 +576,30 @@ namespace elements {
                     firstOffset + visibleStart,
                     firstOffset + visibleStart + visibleCount
                 );
-                drawablePoints.insert(
-                    drawablePoints.end(),
-                    sourcePoints + (lineFragment.atomStart + visibleStart) * 6,
-                    sourcePoints + (lineFragment.atomStart + visibleStart + visibleCount) * 6
+                drawableInstances.insert(
+                    drawableInstances.end(),
+                    sourceInstances + lineFragment.atomStart + visibleStart,
+                    sourceInstances + lineFragment.atomStart + visibleStart + visibleCount
                 );
 
-                if (endingAtoms.empty() || visibleCount == lineFragment.atomCount) continue;
+                if (!drawsEnding || visibleCount == lineFragment.atomCount) continue;
 
-                size_t metadataOffset = drawableMetadata.size();
-                for (auto& point : endingPoints) point.metadataIndex += metadataOffset;
-                drawableMetadata.insert(
-                    drawableMetadata.end(),
-                    endingMetadata.begin(),
-                    endingMetadata.end()
-                );
                 atomized.drawableAtoms.insert(
                     atomized.drawableAtoms.end(),
-                    endingAtoms.begin(),
-                    endingAtoms.end()
+                    ending.atoms.begin(),
+                    ending.atoms.end()
                 );
-                drawablePoints.insert(
-                    drawablePoints.end(),
-                    endingPoints.begin(),
-                    endingPoints.end()
+                drawableInstances.insert(
+                    drawableInstances.end(),
+                    ending.instances.begin(),
+                    ending.instances.end()
                 );
 
                 float endingX = isLtr
                     ? firstOffset[visibleCount - 1].x + firstAtom[visibleCount - 1].width
                     : firstOffset[visibleStart].x - endingWidth;
                 float endingY = firstOffset[visibleStart].y;
-                for (const Atom& atom : endingAtoms) {
+                for (const Atom& atom : ending.atoms) {
                     layout.drawableAtomOffsets.push_back(simd_float2{endingX, endingY});
                     endingX += atom.width;
                 }
@@ -622,18 +607,9 @@ namespace elements {
                 endingAdded = true;
             }
 
-            for (size_t pointIndex = 0; pointIndex < drawablePoints.size(); ++pointIndex) {
-                drawablePoints[pointIndex].id = pointIndex / 6;
-            }
-            fragment.fragmentStorage.drawablePointsBuffer.write(
-                ctx.frameIndex,
-                drawablePoints.data(),
-                drawablePoints.size() * sizeof(TextPoint)
-            );
-            fragment.fragmentStorage.metadataBuffer.write(
-                ctx.frameIndex,
-                drawableMetadata.data(),
-                drawableMetadata.size() * sizeof(int)
+            fragment.fragmentStorage.drawableAtomsBuffer.write(
+                drawableInstances.data(),
+                drawableInstances.size() * sizeof(GlyphInstance)
             );
 
             return atomized;
@@ -649,11 +625,10 @@ namespace elements {
 
             size_t bufferLen = offsets.size() * sizeof(simd_float2);
 
-            fragment.fragmentStorage.placementsBuffer.write(ctx.frameIndex, offsets.data(), bufferLen);
+            fragment.fragmentStorage.placementsBuffer.write(offsets.data(), bufferLen);
 
             for (int i = 0; i < offsets.size(); ++i) {
                 placements.push_back({
-                    .placementBufferHandle = fragment.fragmentStorage.placementsBuffer.getBufferHandle(ctx.frameIndex),
                     .x = offsets[i].x ,
                     .y = offsets[i].y
                 });
@@ -672,12 +647,12 @@ namespace elements {
             TextUniforms uniforms {
                 .color = desc.color,
                 .fontSize = fontSize,
-                .numClips = static_cast<uint32_t>(layout.clipUniforms.size())
+                .numClips = static_cast<uint32_t>(layout.clipUniforms.size()),
+                .scrollLayer = layout.scrollLayer
             };
 
-            fragment.fragmentStorage.uniformsBuffer.write(ctx.frameIndex, &uniforms, sizeof(TextUniforms));
+            fragment.fragmentStorage.uniformsBuffer.write(&uniforms, sizeof(TextUniforms));
             fragment.fragmentStorage.clipsBuffer.write(
-                ctx.frameIndex,
                 layout.clipUniforms.data(),
                 sizeof(ClipUniform) * layout.clipUniforms.size()
             );
@@ -690,35 +665,34 @@ namespace elements {
             };
         }
 
-        void encode(MTL::RenderCommandEncoder* encoder, Fragment<S>& fragment, Finalized<U>& finalized) {
-            auto pipeline = getPipeline();
-            encoder->setRenderPipelineState(pipeline);
-
-            auto frameInfoBuf = ctx.frameInfoBuffer.get();
-            auto atomBuf = finalized.atomized.usesDrawableAtoms
-                ? fragment.fragmentStorage.drawablePointsBuffer.getBuffer(ctx.frameIndex)
-                : fragment.fragmentStorage.atomsBuffer.getBuffer(ctx.frameIndex);
-            auto placementBuf = fragment.fragmentStorage.placementsBuffer.getBuffer(ctx.frameIndex);
-            auto metaBuf = fragment.fragmentStorage.metadataBuffer.getBuffer(ctx.frameIndex);
-            auto uniformsBuf = fragment.fragmentStorage.uniformsBuffer.getBuffer(ctx.frameIndex);
-            auto clipsBuf = fragment.fragmentStorage.clipsBuffer.getBuffer(ctx.frameIndex);
-            auto bezierBuf = glyphBuffer.get();
-
-            encoder->setVertexBuffer(atomBuf, 0, 0);
-            encoder->setVertexBuffer(placementBuf, 0, 1);
-            encoder->setVertexBuffer(frameInfoBuf, 0, 2);
-            encoder->setVertexBuffer(uniformsBuf, 0, 3);
-
-            encoder->setFragmentBuffer(bezierBuf, 0, 0);
-            encoder->setFragmentBuffer(metaBuf, 0, 1);
-            encoder->setFragmentBuffer(uniformsBuf, 0, 2);
-            encoder->setFragmentBuffer(clipsBuf, 0, 3);
+        void record(DrawRecorder& recorder, Fragment<S>& fragment, const Finalized<U>& finalized) {
+            recorder.setRenderPipeline(getPipeline());
+
+            auto glyphInstances = finalized.atomized.usesDrawableAtoms
+                ? recorder.copy(fragment.fragmentStorage.drawableAtomsBuffer)
+                : recorder.copy(fragment.fragmentStorage.atomsBuffer);
+            auto placements = recorder.copy(fragment.fragmentStorage.placementsBuffer);
+            auto uniforms = recorder.copy(fragment.fragmentStorage.uniformsBuffer);
+            auto clips = recorder.copy(fragment.fragmentStorage.clipsBuffer);
+            auto glyphTableBuf = glyphTable.buffer();
+
+            recorder.setVertexData(glyphInstances, 0);
+            recorder.setVertexData(placements, 1);
+            recorder.setVertexFrameInfo(2);
+            recorder.setVertexData(uniforms, 3);
+            recorder.setVertexScrollLayers(4);
+
+            // the same table read as points and as int headers
+            recorder.setFragmentBuffer(glyphTableBuf, 0);
+            recorder.setFragmentBuffer(glyphTableBuf, 1);
+            recorder.setFragmentData(uniforms, 2);
+            recorder.setFragmentData(clips, 3);
+            recorder.setFragmentScrollLayers(4);
 
             const auto& atoms = finalized.atomized.usesDrawableAtoms
                 ? finalized.atomized.drawableAtoms
                 : finalized.atomized.atoms;
-            encoder->drawPrimitives(MTL::PrimitiveTypeTriangle, NS::UInteger(0), atoms.size()*6);
-
+            recorder.drawInstancedPrimitives(6, atoms.size());
         }
 
         std::function<bool(HitTestContext<U>& context, simd_float2 testPoint)> setupHitTestFunction() {
@@ -735,10 +709,12 @@ namespace elements {
         // retrivial methods, stores buffer with all glyphs/ligatures, standardizes everything, etc... Turn this into a struct later
         GlyphCache glyphCache;
         TextShaper textShaper;
-        size_t lastGlyphsBufferOffset;
-        std::unordered_map<GlyphQuery, size_t, GlyphQueryHash> glyphBufferOffsets;
-        DrawableBuffer glyphBuffer;
-        std::mutex glyphBufferMutex;
+        GlyphTable glyphTable;
+
+        // keyed by style rather than content, so it stays small; cleared at
+        // MaxOverflowEndings
+        std::unordered_map<OverflowEndingKey, std::shared_ptr<const OverflowEnding>, OverflowEndingKeyHash> overflowEndings;
+        std::mutex overflowEndingMutex;
         
         UIContext& ctx;
     };
@@ -1,54 +1,203 @@
 #include "textShaper.hpp"
 #include "glyphs.hpp"
+#include "hash_combine.hpp"
+#include "instrumentation.hpp"
 #include "utf8.hpp"
-#include <hb-ft.h>
+#include <hb-ot.h>
 #include <hb.h>
 #include <algorithm>
+#include <iterator>
 #include <memory>
 
-char32_t ShapedCluster::codepoint() const {
-    return utf8::at(text, 0).value;
+char32_t ShapedCluster::codepoint(std::string_view source) const {
+    return utf8::at(source, byteOffset).value;
 }
 
-TextShaper::TextShaper() {
-    FT_Init_FreeType(&ft);
+namespace {
+    // HarfBuzz reads at most this many codepoints of context on each side of the
+    // item (HB_BUFFER_CONTEXT_LENGTH)
+    constexpr size_t ShapingContextCodepoints = 5;
+
+    bool isContinuationByte(char byte) {
+        return (static_cast<unsigned char>(byte) & 0xC0) == 0x80;
+    }
+
+    size_t estimatedBytes(const ShapedRun& run) {
+        return run.glyphs.size() * sizeof(ShapedGlyph) +
+            run.clusters.size() * sizeof(ShapedCluster) +
+            run.runs.size() * sizeof(ShapedSubRun);
+    }
+
+    // hb_font_t carries per-font caches, so threads don't share them; the faces
+    // they reference are shared and refcounted, which keeps these valid after the
+    // shaper that made them is gone
+    struct ThreadFonts {
+        std::unordered_map<FontId, hb_font_t*> fonts;
+
+        ~ThreadFonts() {
+            for (auto& [_, font] : fonts) hb_font_destroy(font);
+        }
+    };
+
+    thread_local ThreadFonts threadFonts;
 }
 
+TextShaper::TextShaper(size_t cacheBudgetBytes):
+    cacheBudgetBytes{cacheBudgetBytes}
+{}
+
 TextShaper::~TextShaper() {
-    for (auto& [_, font] : fonts) {
-        hb_font_destroy(font.harfBuzzFont);
-        FT_Done_Face(font.face);
+    for (auto& [_, face] : faces) {
+        hb_face_destroy(face);
+    }
+}
+
+hb_face_t* TextShaper::sharedFace(FontId font) {
+    std::lock_guard lock(faceMutex);
+    if (auto found = faces.find(font); found != faces.end()) {
+        return found->second;
     }
-    FT_Done_FreeType(ft);
+
+    // hb_face_create references the blob
+    auto face = hb_face_create(FontRegistry::shared().blob(font), 0);
+    hb_face_make_immutable(face);
+    faces.emplace(font, face);
+    return face;
 }
 
-TextShaper::Font& TextShaper::getFont(const std::string& fontName) {
-    if (auto found = fonts.find(fontName); found != fonts.end()) {
+hb_font_t* TextShaper::threadFont(FontId fontId) {
+    if (auto found = threadFonts.fonts.find(fontId); found != threadFonts.fonts.end()) {
         return found->second;
     }
 
-    FT_Face face = nullptr;
-    FT_New_Face(ft, fontName.c_str(), 0, &face);
-    FT_Set_Pixel_Sizes(face, 0, BASE_PIXEL_HEIGHT);
+    // same metrics hb_ft produced for a face sized with FT_Set_Pixel_Sizes(0, BASE_PIXEL_HEIGHT)
+    auto font = hb_font_create(sharedFace(fontId));
+    hb_ot_font_set_funcs(font);
+    int scale = static_cast<int>(BASE_PIXEL_HEIGHT * FT_PIXEL_CF);
+    hb_font_set_scale(font, scale, scale);
+    hb_font_set_ppem(font, static_cast<unsigned int>(BASE_PIXEL_HEIGHT), static_cast<unsigned int>(BASE_PIXEL_HEIGHT));
+    hb_font_make_immutable(font);
+    threadFonts.fonts.emplace(fontId, font);
+    return font;
+}
+
+size_t TextShaper::ShapeKey::hash() const {
+    size_t seed = std::hash<std::string_view>{}(text);
+    hash_combine(seed, font);
+    hash_combine(seed, itemOffset);
+    hash_combine(seed, itemLength);
+    hash_combine(seed, static_cast<int>(direction));
+    hash_combine(seed, scriptTag);
+    return seed;
+}
+
+const ShapedRun* TextShaper::findCached(const ShapeKey& key, size_t hash) {
+    auto [first, last] = cacheIndex.equal_range(hash);
+    for (auto it = first; it != last; ++it) {
+        auto entry = it->second;
+        const auto& cached = entry->key;
+        if (cached.text == key.text && cached.font == key.font &&
+            cached.itemOffset == key.itemOffset && cached.itemLength == key.itemLength &&
+            cached.direction == key.direction && cached.scriptTag == key.scriptTag) {
+            cacheEntries.splice(cacheEntries.begin(), cacheEntries, entry);
+            return &entry->run;
+        }
+    }
+    return nullptr;
+}
+
+void TextShaper::insertCached(const ShapeKey& key, size_t hash, ShapedRun run) {
+    size_t bytes = sizeof(CacheEntry) + key.text.size() + estimatedBytes(run);
+    if (bytes > cacheBudgetBytes) return;
+    // another thread may have shaped the same run while this one was
+    if (findCached(key, hash)) return;
 
-    auto harfBuzzFont = hb_ft_font_create_referenced(face);
-    auto [inserted, _] = fonts.emplace(fontName, Font{
-        .face = face,
-        .harfBuzzFont = harfBuzzFont
-    });
-    return inserted->second;
+    cacheEntries.emplace_front();
+    auto entry = cacheEntries.begin();
+    entry->text = key.text;
+    entry->key = key;
+    // only point at the string once it sits in its final list node
+    entry->key.text = entry->text;
+    entry->hash = hash;
+    entry->bytes = bytes;
+    entry->run = std::move(run);
+    cacheIndex.emplace(hash, entry);
+    cacheBytes += bytes;
+
+    while (cacheBytes > cacheBudgetBytes) {
+        auto victim = std::prev(cacheEntries.end());
+        auto [first, last] = cacheIndex.equal_range(victim->hash);
+        for (auto it = first; it != last; ++it) {
+            if (it->second == victim) {
+                cacheIndex.erase(it);
+                break;
+            }
+        }
+        cacheBytes -= victim->bytes;
+        cacheEntries.erase(victim);
+    }
 }
 
 ShapedRun TextShaper::shape(
     std::string_view text,
     size_t byteStart,
     size_t byteLength,
-    const std::string& fontName,
+    FontId font,
     TextDirection direction,
     uint32_t scriptTag
 ) {
-    std::lock_guard lock(mutex);
-    auto& font = getFont(fontName);
+    size_t contextStart = byteStart;
+    for (size_t n = 0; n < ShapingContextCodepoints && contextStart > 0; ++n) {
+        do {
+            --contextStart;
+        } while (contextStart > 0 && isContinuationByte(text[contextStart]));
+    }
+    size_t contextEnd = byteStart + byteLength;
+    for (size_t n = 0; n < ShapingContextCodepoints && contextEnd < text.size(); ++n) {
+        do {
+            ++contextEnd;
+        } while (contextEnd < text.size() && isContinuationByte(text[contextEnd]));
+    }
+
+    ShapeKey key {
+        .text = text.substr(contextStart, contextEnd - contextStart),
+        .font = font,
+        .itemOffset = byteStart - contextStart,
+        .itemLength = byteLength,
+        .direction = direction,
+        .scriptTag = scriptTag
+    };
+    size_t hash = key.hash();
+
+    ShapedRun result;
+    bool hit = false;
+    if (cacheBudgetBytes > 0) {
+        std::lock_guard lock(cacheMutex);
+        if (auto cached = findCached(key, hash)) {
+            result = *cached;
+            hit = true;
+        }
+        instrumentation::recordShapeCache(hit);
+    }
+
+    if (!hit) {
+        // HarfBuzz runs unlocked on this thread's font
+        result = shapeUncached(key, threadFont(font));
+        if (cacheBudgetBytes > 0) {
+            std::lock_guard lock(cacheMutex);
+            insertCached(key, hash, result);
+        }
+    }
+
+    for (auto& glyph : result.glyphs) glyph.byteOffset += static_cast<uint32_t>(contextStart);
+    for (auto& cluster : result.clusters) cluster.byteOffset += contextStart;
+    return result;
+}
+
+ShapedRun TextShaper::shapeUncached(const ShapeKey& key, hb_font_t* font) {
+    std::string_view text = key.text;
+    size_t byteStart = key.itemOffset;
+    size_t byteLength = key.itemLength;
 
     using HarfBuzzBuffer = std::unique_ptr<hb_buffer_t, decltype(&hb_buffer_destroy)>;
     HarfBuzzBuffer buffer{hb_buffer_create(), hb_buffer_destroy};
@@ -62,10 +211,10 @@ ShapedRun TextShaper::shape(
     hb_buffer_guess_segment_properties(buffer.get());
     hb_buffer_set_direction(
         buffer.get(),
-        direction == TextDirection::Rtl ? HB_DIRECTION_RTL : HB_DIRECTION_LTR
+        key.direction == TextDirection::Rtl ? HB_DIRECTION_RTL : HB_DIRECTION_LTR
     );
-    hb_buffer_set_script(buffer.get(), hb_script_from_iso15924_tag(scriptTag));
-    hb_shape(font.harfBuzzFont, buffer.get(), nullptr, 0);
+    hb_buffer_set_script(buffer.get(), hb_script_from_iso15924_tag(key.scriptTag));
+    hb_shape(font, buffer.get(), nullptr, 0);
 
     unsigned int glyphCount = 0;
     const auto* infos = hb_buffer_get_glyph_infos(buffer.get(), &glyphCount);
@@ -84,6 +233,11 @@ ShapedRun TextShaper::shape(
         });
     }
 
+    // HarfBuzz keeps cluster values monotonic in glyph order: ascending for LTR,
+    // descending for RTL. So one pass groups the glyphs, and a cluster ends where
+    // its logical successor starts, which is the next group for LTR and the
+    // previous one for RTL.
+    result.clusters.reserve(result.glyphs.size());
     size_t glyphStart = 0;
     while (glyphStart < result.glyphs.size()) {
         const auto byteOffset = result.glyphs[glyphStart].byteOffset;
@@ -95,17 +249,8 @@ ShapedRun TextShaper::shape(
             ++glyphEnd;
         }
 
-        size_t nextByteOffset = byteStart + byteLength;
-        for (const auto& glyph : result.glyphs) {
-            if (glyph.byteOffset > byteOffset) {
-                nextByteOffset = std::min(nextByteOffset, size_t(glyph.byteOffset));
-            }
-        }
-        const auto byteLength = nextByteOffset - byteOffset;
         result.clusters.push_back({
             .byteOffset = byteOffset,
-            .byteLength = byteLength,
-            .text = std::string{text.substr(byteOffset, byteLength)},
             .glyphStart = glyphStart,
             .glyphCount = glyphEnd - glyphStart,
             .advance = advance
@@ -113,5 +258,16 @@ ShapedRun TextShaper::shape(
         glyphStart = glyphEnd;
     }
 
+    size_t nextByteOffset = byteStart + byteLength;
+    auto close = [&](ShapedCluster& cluster) {
+        cluster.byteLength = nextByteOffset - cluster.byteOffset;
+        nextByteOffset = cluster.byteOffset;
+    };
+    if (key.direction == TextDirection::Rtl) {
+        std::for_each(result.clusters.begin(), result.clusters.end(), close);
+    } else {
+        std::for_each(result.clusters.rbegin(), result.clusters.rend(), close);
+    }
+
     return result;
 }
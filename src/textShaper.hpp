@@ -1,8 +1,9 @@
 #pragma once
 
-#include "freetype.hpp"
+#include "font_registry.hpp"
 #include <cstddef>
 #include <cstdint>
+#include <list>
 #include <mutex>
 #include <string>
 #include <string_view>
@@ -21,12 +22,12 @@ struct ShapedGlyph {
 struct ShapedCluster {
     size_t byteOffset{};
     size_t byteLength{};
-    std::string text;
     size_t glyphStart{};
     size_t glyphCount{};
     float advance{};
 
-    char32_t codepoint() const;
+    // first codepoint of the cluster in the text it was shaped from
+    char32_t codepoint(std::string_view source) const;
 };
 
 struct ShapedSubRun {
@@ -45,11 +46,19 @@ struct ShapedRun {
 
 enum class TextDirection { Ltr, Rtl };
 
+struct hb_face_t;
 struct hb_font_t;
 
+// Safe to call shape() from any thread. Each font is parsed once into a shared
+// immutable hb_face_t over the registry's mapping; every thread shapes with its own hb_font_t over it, so the
+// only locks are on first use of a font and around the shaped-run cache.
 class TextShaper {
 public:
-    TextShaper();
+    // upper bound on what the shaped-run cache may hold, estimated from its vectors
+    static constexpr size_t ShapeCacheBudgetBytes = 8 << 20;
+
+    // a budget of 0 turns the cache off
+    explicit TextShaper(size_t cacheBudgetBytes = ShapeCacheBudgetBytes);
     ~TextShaper();
 
     TextShaper(const TextShaper&) = delete;
@@ -59,20 +68,46 @@ public:
         std::string_view text,
         size_t byteStart,
         size_t byteLength,
-        const std::string& font,
+        FontId font,
         TextDirection direction,
         uint32_t scriptTag
     );
 
 private:
-    struct Font {
-        FT_Face face{};
-        hb_font_t* harfBuzzFont{};
+    // Everything HarfBuzz sees for one run: the run and the context around it, so
+    // equal keys shape identically wherever the run sits in its text.
+    struct ShapeKey {
+        std::string_view text;
+        FontId font{};
+        size_t itemOffset{};
+        size_t itemLength{};
+        TextDirection direction{};
+        uint32_t scriptTag{};
+
+        size_t hash() const;
     };
 
-    Font& getFont(const std::string& font);
+    // results are stored relative to the start of the key's text
+    struct CacheEntry {
+        std::string text;
+        ShapeKey key; // text views the string above
+        size_t hash{};
+        size_t bytes{};
+        ShapedRun run;
+    };
+
+    hb_font_t* threadFont(FontId font);
+    hb_face_t* sharedFace(FontId font);
+    ShapedRun shapeUncached(const ShapeKey& key, hb_font_t* font);
+    const ShapedRun* findCached(const ShapeKey& key, size_t hash);
+    void insertCached(const ShapeKey& key, size_t hash, ShapedRun run);
+
+    std::unordered_map<FontId, hb_face_t*> faces;
+    std::mutex faceMutex;
 
-    FT_Library ft{};
-    std::unordered_map<std::string, Font> fonts;
-    std::mutex mutex;
+    size_t cacheBudgetBytes;
+    std::list<CacheEntry> cacheEntries; // most recently used first
+    std::unordered_multimap<size_t, std::list<CacheEntry>::iterator> cacheIndex;
+    size_t cacheBytes{};
+    std::mutex cacheMutex;
 };
@@ -15,6 +15,7 @@ namespace bidi {
         uint32_t scriptTag{};
 
         bool isRtl() const { return (level & 1u) != 0; }
+        bool operator==(const TextShapingRun&) const = default;
     };
 
     class TextBidiContext {
@@ -50,5 +51,13 @@ namespace bidi {
         size_t paragraphByteStart{};
         size_t byteLength{};
         std::vector<TextShapingRun> runs;
+        // bumped whenever the runs a node receives actually change; see RenderTree::atomizePhase
+        uint64_t generation{};
+
+        bool sameRuns(const TextBidiInput& other) const {
+            return paragraphByteStart == other.paragraphByteStart &&
+                byteLength == other.byteLength &&
+                runs == other.runs;
+        }
     };
 }
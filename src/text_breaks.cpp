@@ -0,0 +1,128 @@
+#include "text_breaks.hpp"
+#include "element.hpp"
+#include <algorithm>
+#include <cassert>
+
+void collectRunPieces(
+    const ShapedRun& shapedRun,
+    const std::vector<Atom>& atoms,
+    size_t clusterStart,
+    size_t clusterEnd,
+    std::vector<TextRunPiece>& out
+) {
+    if (clusterStart == clusterEnd) return;
+
+    const auto& finalCluster = shapedRun.clusters[clusterEnd - 1];
+    const size_t finalByteEnd = finalCluster.byteOffset + finalCluster.byteLength;
+
+    // clusters are sorted by byte offset and runs are in logical order, so one
+    // cursor walks both
+    size_t runIndex = 0;
+    TextRunPiece* piece = nullptr;
+    size_t pieceRun = 0;
+    for (size_t i = clusterStart; i < clusterEnd; ++i) {
+        const auto& cluster = shapedRun.clusters[i];
+        while (runIndex < shapedRun.runs.size() &&
+               cluster.byteOffset >= shapedRun.runs[runIndex].byteStart + shapedRun.runs[runIndex].byteLength) {
+            ++runIndex;
+        }
+        if (runIndex == shapedRun.runs.size()) break;
+
+        const auto& run = shapedRun.runs[runIndex];
+        if (cluster.byteOffset < run.byteStart) continue;
+
+        if (!piece || pieceRun != runIndex) {
+            out.push_back({
+                .atomStart = cluster.glyphStart,
+                .byteStart = cluster.byteOffset,
+                .bidiLevel = run.bidiLevel
+            });
+            piece = &out.back();
+            pieceRun = runIndex;
+        }
+
+        size_t atomEnd = std::max(piece->atomStart + piece->atomCount, cluster.glyphStart + cluster.glyphCount);
+        piece->atomStart = std::min(piece->atomStart, cluster.glyphStart);
+        piece->atomCount = atomEnd - piece->atomStart;
+        piece->byteLength = cluster.byteOffset + cluster.byteLength - piece->byteStart;
+        for (size_t glyph = 0; glyph < cluster.glyphCount; ++glyph) {
+            piece->width += atoms[cluster.glyphStart + glyph].width;
+        }
+        piece->holdsRangeEnd = piece->byteStart + piece->byteLength == finalByteEnd;
+    }
+}
+
+TextBreaks buildTextBreaks(std::string_view text, const ShapedRun& shapedRun, const std::vector<Atom>& atoms) {
+    assert(std::ranges::is_sorted(shapedRun.runs, {}, &ShapedSubRun::byteStart));
+
+    TextBreaks breaks;
+    const size_t clusterCount = shapedRun.clusters.size();
+    breaks.clusterWidths.resize(clusterCount);
+    breaks.clusterWhitespace.resize(clusterCount);
+    for (size_t i = 0; i < clusterCount; ++i) {
+        const auto& cluster = shapedRun.clusters[i];
+        float width = 0.0f;
+        for (size_t glyph = 0; glyph < cluster.glyphCount; ++glyph) {
+            width += atoms[cluster.glyphStart + glyph].width;
+        }
+        breaks.clusterWidths[i] = width;
+        breaks.clusterWhitespace[i] = elements::isTextWhitespace(cluster.codepoint(text));
+    }
+
+    // a segment is a run of non-whitespace clusters and the whitespace after it
+    size_t idx = 0;
+    while (idx < clusterCount) {
+        TextSegment segment{.clusterStart = idx, .pieceStart = breaks.pieces.size()};
+        while (idx < clusterCount && !breaks.clusterWhitespace[idx]) ++idx;
+        while (idx < clusterCount && breaks.clusterWhitespace[idx]) {
+            ++idx;
+            segment.breakAfter = true;
+        }
+        segment.clusterEnd = idx;
+        segment.width = addSegmentWidth(0.0f, breaks, shapedRun, atoms, segment);
+        segment.glyphWidth = sumGlyphAdvances(shapedRun, atoms, segment.clusterStart, segment.clusterEnd);
+
+        collectRunPieces(shapedRun, atoms, segment.clusterStart, segment.clusterEnd, breaks.pieces);
+        segment.pieceCount = breaks.pieces.size() - segment.pieceStart;
+
+        breaks.segments.push_back(segment);
+    }
+    return breaks;
+}
+
+float addSegmentWidth(
+    float start,
+    const TextBreaks& breaks,
+    const ShapedRun& shapedRun,
+    const std::vector<Atom>& atoms,
+    const TextSegment& segment
+) {
+    float width = start;
+    for (size_t i = segment.clusterStart; i < segment.clusterEnd; ++i) {
+        if (!breaks.clusterWhitespace[i]) {
+            width += breaks.clusterWidths[i];
+            continue;
+        }
+        const auto& cluster = shapedRun.clusters[i];
+        for (size_t glyph = 0; glyph < cluster.glyphCount; ++glyph) {
+            width += atoms[cluster.glyphStart + glyph].width;
+        }
+    }
+    return width;
+}
+
+float sumGlyphAdvances(
+    const ShapedRun& shapedRun,
+    const std::vector<Atom>& atoms,
+    size_t clusterStart,
+    size_t clusterEnd
+) {
+    float width = 0.0f;
+    for (size_t i = clusterStart; i < clusterEnd; ++i) {
+        const auto& cluster = shapedRun.clusters[i];
+        for (size_t glyph = 0; glyph < cluster.glyphCount; ++glyph) {
+            width += atoms[cluster.glyphStart + glyph].width;
+        }
+    }
+    return width;
+}
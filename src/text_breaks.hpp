@@ -0,0 +1,76 @@
+#pragma once
+
+#include "fragment_types.hpp"
+#include "textShaper.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+// The part of a cluster range that falls in one bidi run; line breaking turns
+// each piece into a LineFragment.
+struct TextRunPiece {
+    size_t atomStart{};
+    size_t atomCount{};
+    size_t byteStart{};
+    size_t byteLength{};
+    float width{}; // glyph advances only
+    uint8_t bidiLevel{};
+    bool holdsRangeEnd{}; // contains the range's last byte, so it takes the trailing width
+};
+
+// A word and the whitespace after it: the unit soft wrapping moves between lines
+// when words may not be broken.
+struct TextSegment {
+    size_t clusterStart{};
+    size_t clusterEnd{};
+    size_t pieceStart{};
+    size_t pieceCount{};
+    float width{}; // addSegmentWidth from zero
+    float glyphWidth{}; // sumGlyphAdvances over the segment's clusters
+    bool breakAfter{}; // ends in whitespace
+};
+
+// Line-breaking data for one text node, derived once from its shaped run and
+// atoms after atomization. Wrapping at a new width reads widths and break
+// opportunities from here instead of decoding and summing clusters again.
+struct TextBreaks {
+    std::vector<float> clusterWidths;
+    std::vector<uint8_t> clusterWhitespace;
+    std::vector<TextSegment> segments;
+    std::vector<TextRunPiece> pieces;
+};
+
+TextBreaks buildTextBreaks(std::string_view text, const ShapedRun& shapedRun, const std::vector<Atom>& atoms);
+
+// Adds a segment's width to `start` the way the cluster walk in
+// appendTextLineFragments does: each word cluster's width, then each
+// whitespace glyph's advance, left to right. Float sums depend on their
+// order, so the segment walk breaks lines exactly where the cluster walk does
+// only if it adds up the same way.
+float addSegmentWidth(
+    float start,
+    const TextBreaks& breaks,
+    const ShapedRun& shapedRun,
+    const std::vector<Atom>& atoms,
+    const TextSegment& segment
+);
+
+// Every glyph advance in clusters [clusterStart, clusterEnd), in order; a line
+// fragment's trailing margin is its range's total width less this.
+float sumGlyphAdvances(
+    const ShapedRun& shapedRun,
+    const std::vector<Atom>& atoms,
+    size_t clusterStart,
+    size_t clusterEnd
+);
+
+// Appends one piece per bidi run that clusters [clusterStart, clusterEnd)
+// touch, in run order.
+void collectRunPieces(
+    const ShapedRun& shapedRun,
+    const std::vector<Atom>& atoms,
+    size_t clusterStart,
+    size_t clusterEnd,
+    std::vector<TextRunPiece>& out
+);
@@ -13,40 +13,53 @@ struct TextUniforms {
     float4 color;
     float fontSize;
     uint numClips;
+    uint scrollLayer;
 };
 
-struct TextVertexIn {
-    float2 position [[attribute(0)]];
-    int metadataIndex [[attribute(1)]];
-    int atom_id [[attribute(2)]];
-    float2 shapingOffset [[attribute(3)]];
+struct GlyphInstance {
+    float2 topLeft;
+    float2 bottomRight;
+    float2 shapingOffset;
+    int glyphIndex;
 };
 
 
 struct TextVertexOut {
     float4 position [[position]];
     float4 worldPosition;
-    float4 clipPosition;
-    int metadataIndex [[flat]];
+    float4 clipPosition; // window space
+    int glyphIndex [[flat]];
 };
 
 vertex TextVertexOut vertex_text(
-    TextVertexIn in [[stage_in]],
+    uint vertexId [[vertex_id]],
+    uint instanceId [[instance_id]],
+    constant GlyphInstance* glyphs [[buffer(0)]],
     constant float2* offsets [[buffer(1)]],
     constant FrameInfo* frameInfo [[buffer(2)]],
-    constant TextUniforms* uniforms [[buffer(3)]]
+    constant TextUniforms* uniforms [[buffer(3)]],
+    constant float2* scrollLayers [[buffer(4)]]
 )
 {
+    const float2 corners[6] = {
+        float2(0, 0), float2(1, 0), float2(0, 1),
+        float2(0, 1), float2(1, 0), float2(1, 1)
+    };
+
+    GlyphInstance glyph = glyphs[instanceId];
+    float2 position = mix(glyph.topLeft, glyph.bottomRight, corners[vertexId]);
+
     TextVertexOut out;
 
     float scale = uniforms->fontSize/BASE_PIXEL_HEIGHT;
 
-    float2 adjustedPos = ((in.position + in.shapingOffset) * scale)/64.0f + offsets[in.atom_id];
+    float2 adjustedPos = ((position + glyph.shapingOffset) * scale)/64.0f + offsets[instanceId];
+    adjustedPos += scrollLayers[uniforms->scrollLayer];
     float2 ndcPos = toNDC(adjustedPos, frameInfo->width, frameInfo->height);
     out.position = float4(ndcPos, 0.0, 1.0);
-    out.worldPosition = float4(in.position, 0.0, 1.0);
+    out.worldPosition = float4(position, 0.0, 1.0);
     out.clipPosition = float4(adjustedPos, 0.0, 1.0);
-    out.metadataIndex = in.metadataIndex;
+    out.glyphIndex = glyph.glyphIndex;
     
     return out;
 }
@@ -256,55 +269,92 @@ int countCubicIntersections(
 }
 
 
+// adds one curve's distance and +x ray crossings for the fragment
+inline void accumulate_curve(
+    constant float2* bezierPoints,
+    int pointIndex,
+    CurveType curveType,
+    float2 fragPt,
+    thread float& minDist,
+    thread int& intersections
+) {
+    auto p0 = bezierPoints[pointIndex];
+    auto p1 = bezierPoints[pointIndex+1];
+    auto p2 = bezierPoints[pointIndex+2];
+
+    if (curveType == CurveType::Cubic) {
+        auto p3 = bezierPoints[pointIndex+3];
+        minDist = min(
+            minDist,
+            approximateCubicDistance(p0, p1, p2, p3, fragPt)
+        );
+        intersections += countCubicIntersections(
+            p0, p1, p2, p3, fragPt.x, fragPt.y
+        );
+    } else {
+        minDist = min(
+            minDist,
+            approximateQuadraticDistance(p0, p1, p2, fragPt)
+        );
+        intersections += countQuadraticIntersections(
+            p0, p1, p2, fragPt.x, fragPt.y
+        );
+    }
+}
+
 fragment float4 fragment_text(
     TextVertexOut in [[stage_in]],
     constant float2* bezierPoints [[buffer(0)]],
-    constant int* glyphMeta [[buffer(1)]],
+    constant int* glyphTable [[buffer(1)]],
     constant TextUniforms* uniforms [[buffer(2)]],
-    constant ClipUniform* clips [[buffer(3)]]
+    constant ClipUniform* clips [[buffer(3)]],
+    constant float2* scrollLayers [[buffer(4)]]
 )
 {
-    if (outside_clips(in.clipPosition.xy, clips, uniforms->numClips)) {
+    float4 fragPt = in.worldPosition;
+    float px = fwidth(fragPt.x);
+
+    if (outside_clips(in.clipPosition.xy, clips, uniforms->numClips, scrollLayers)) {
         discard_fragment();
     }
 
-    float4 fragPt = in.worldPosition;
-
-    int metadataIndex = in.metadataIndex;
-    int bezierIndex = glyphMeta[metadataIndex];
-    CurveType curveType = CurveType(uint(glyphMeta[metadataIndex + 1]));
-    int numContours = glyphMeta[metadataIndex + 2];
+    // bezierPoints and glyphTable view the same buffer; see GlyphTable
+    int glyphIndex = in.glyphIndex;
+    int bezierIndex = glyphTable[glyphIndex];
+    CurveType curveType = CurveType(uint(glyphTable[glyphIndex + 1]));
+    int numContours = glyphTable[glyphIndex + 2];
+    int bandsIndex = glyphTable[glyphIndex + 3];
     int pointStride = curveType == CurveType::Cubic ? 4 : 3;
     float minDist = 1e20;
     
     int intersections = 0;
-    int coff = 0;
 
-    for (int ci = 0; ci < numContours; ++ci) {
-        int contourSize = glyphMeta[metadataIndex + 3 + ci];
-        
-        for (int cpi = 0; cpi < contourSize; cpi += pointStride, coff += pointStride) {
-            auto p0 = bezierPoints[bezierIndex+coff];
-            auto p1 = bezierPoints[bezierIndex+coff+1];
-            auto p2 = bezierPoints[bezierIndex+coff+2];
-
-            if (curveType == CurveType::Cubic) {
-                auto p3 = bezierPoints[bezierIndex+coff+3];
-                minDist = min(
-                    minDist,
-                    approximateCubicDistance(p0, p1, p2, p3, fragPt.xy)
-                );
-                intersections += countCubicIntersections(
-                    p0, p1, p2, p3, fragPt.x, fragPt.y
-                );
-            } else {
-                minDist = min(
-                    minDist,
-                    approximateQuadraticDistance(p0, p1, p2, fragPt.xy)
-                );
-                intersections += countQuadraticIntersections(
-                    p0, p1, p2, fragPt.x, fragPt.y
-                );
+    // Only curves in the fragment's band can cross its ray or come within the
+    // band margin of it. Past half a pixel the distance no longer changes the
+    // coverage, so the bands are exact while a pixel spans at most two margins;
+    // smaller text covers few pixels and takes the full loop.
+    float bandMargin = bandsIndex >= 0 ? as_type<float>(glyphTable[bandsIndex + 3]) : 0.0;
+    if (bandsIndex >= 0 && px <= 2.0 * bandMargin) {
+        int bandCount = glyphTable[bandsIndex];
+        float minY = as_type<float>(glyphTable[bandsIndex + 1]);
+        float bandHeight = as_type<float>(glyphTable[bandsIndex + 2]);
+        int band = int(clamp(floor((fragPt.y - minY) / bandHeight), 0.0, float(bandCount - 1)));
+        int curveStart = glyphTable[bandsIndex + 4 + band * 2];
+        int curveCount = glyphTable[bandsIndex + 4 + band * 2 + 1];
+
+        for (int i = 0; i < curveCount; ++i) {
+            int curve = curveStart + i * 2;
+            // sorted by maxX, descending: the rest are all too far left
+            if (as_type<float>(glyphTable[curve + 1]) + bandMargin < fragPt.x) break;
+            accumulate_curve(bezierPoints, bezierIndex + glyphTable[curve], curveType, fragPt.xy, minDist, intersections);
+        }
+    } else {
+        int coff = 0;
+        for (int ci = 0; ci < numContours; ++ci) {
+            int contourSize = glyphTable[glyphIndex + 4 + ci];
+
+            for (int cpi = 0; cpi < contourSize; cpi += pointStride, coff += pointStride) {
+                accumulate_curve(bezierPoints, bezierIndex + coff, curveType, fragPt.xy, minDist, intersections);
             }
         }
     }
@@ -313,8 +363,6 @@ fragment float4 fragment_text(
 
     float sd = inside ? -minDist : minDist;
 
-    float px = fwidth(fragPt.x);
-
     float coverage = clamp(0.5 - sd/px, 0.0, 1.0);
 
     float alpha = coverage * uniforms->color.w;
@@ -33,7 +33,6 @@ using runtime::Modifiers;
 using runtime::MouseButton;
 using runtime::MousePayload;
 using runtime::ScrollPayload;
-using tree::DirtyBits;
 
 using KeyCodeFunc = unsigned short(*)(id, SEL);
 using LocationFunc = CGPoint(*)(id, SEL);
@@ -144,7 +143,7 @@ void MTKViewDelegate::resizeWatcher() {
 
         ready = false;
         lock.unlock();
-        ContextManager::getContext().updateView();
+        ContextManager::getContext().updateFrameInfo(Renderer::frameInfoFor(view));
     }
 
 }
@@ -215,15 +214,20 @@ void AppDelegate::setFocused(tree::TreeNode* node) {
     }
 }
 
-tree::TreeNode* AppDelegate::hitTest(float x, float y, simd_float2& testPoint) {
+simd_float2 AppDelegate::viewPoint(float x, float y) {
     auto frameInfo = viewDelegate->renderer->getFrameInfo();
-    testPoint = toViewPoint(x, y, frameInfo.height);
+    return toViewPoint(x, y, frameInfo.height);
+}
 
-    auto& currTree = viewDelegate->renderer->rootTree;
-    auto* root = currTree.getRoot();
+tree::TreeNode* AppDelegate::hitTest(tree::RenderTree& tree, simd_float2 testPoint) {
+    auto* root = tree.getRoot();
     if (!root) return nullptr;
 
-    return currTree.hitTestRecursive(root, testPoint);
+    return tree.hitTestRecursive(root, testPoint);
+}
+
+void AppDelegate::post(tree::LayoutThread::Mutation mutation) {
+    viewDelegate->renderer->post(std::move(mutation));
 }
 
 void AppDelegate::applicationDidFinishLaunching(NS::Notification* notification)
@@ -253,7 +257,8 @@ void AppDelegate::applicationDidFinishLaunching(NS::Notification* notification)
     
     window->setContentView(view);
 
-    runtime::ContextManager::initContext(device, view);
+    gpuDevice = std::make_unique<gpu::MetalDevice>(device, view);
+    runtime::ContextManager::initContext(*gpuDevice, Renderer::frameInfoFor(view));
 
     viewDelegate = std::make_unique<MTKViewDelegate>(device,view);
 
@@ -269,6 +274,8 @@ void AppDelegate::applicationDidFinishLaunching(NS::Notification* notification)
     Class cls = object_getClass(objcInstance);
 
     
+    // Handlers only capture the event here. Hit testing, dispatch and whatever
+    // the node's listeners change run on the layout thread, which owns the tree.
     hs.keyDownHandler = [this](int keyCode, Modifiers modifiers){
         Event e;
         e.type = EventType::KeyDown;
@@ -277,13 +284,15 @@ void AppDelegate::applicationDidFinishLaunching(NS::Notification* notification)
             .modifiers = modifiers
         };
 
-        if (this->inspector) {
-            this->inspector->observe(e);
-        }
+        this->post([this, e](tree::RenderTree&) mutable {
+            if (this->inspector) {
+                this->inspector->observe(e);
+            }
 
-        if (this->focused) {
-            this->focused->dispatch(e);
-        }
+            if (this->focused) {
+                this->focused->dispatch(e);
+            }
+        });
     };
 
     hs.keyUpHandler = [this](int keyCode, Modifiers modifiers){
@@ -294,145 +303,152 @@ void AppDelegate::applicationDidFinishLaunching(NS::Notification* notification)
             .modifiers = modifiers
         };
 
-        if (this->inspector) {
-            this->inspector->observe(e);
-        }
+        this->post([this, e](tree::RenderTree&) mutable {
+            if (this->inspector) {
+                this->inspector->observe(e);
+            }
 
-        if (this->focused) {
-            this->focused->dispatch(e);
-        }
+            if (this->focused) {
+                this->focused->dispatch(e);
+            }
+        });
     };
     
     hs.mouseDownHandler = [this](float x, float y, MouseButton button, Modifiers modifiers){
-        simd_float2 testPoint{0.0f, 0.0f};
-        auto* htnode = this->hitTest(x, y, testPoint);
-        if (!htnode) {
-            this->mouseDownTarget = nullptr;
-            return;
-        }
+        auto testPoint = this->viewPoint(x, y);
+        this->post([this, testPoint, button, modifiers](tree::RenderTree& tree) {
+            auto* htnode = this->hitTest(tree, testPoint);
+            if (!htnode) {
+                this->mouseDownTarget = nullptr;
+                return;
+            }
 
-        Event e;
-        e.type = EventType::MouseDown;
-        e.payload = MousePayload{
-            .position = testPoint,
-            .button = button,
-            .modifiers = modifiers
-        };
+            Event e;
+            e.type = EventType::MouseDown;
+            e.payload = MousePayload{
+                .position = testPoint,
+                .button = button,
+                .modifiers = modifiers
+            };
 
-        if (this->inspector) {
-            this->inspector->observe(e);
-        }
-        
-        this->mouseDownTarget = htnode;
-        this->setFocused(htnode);
-        htnode->dispatch(e);
+            if (this->inspector) {
+                this->inspector->observe(e);
+            }
+
+            this->mouseDownTarget = htnode;
+            this->setFocused(htnode);
+            htnode->dispatch(e);
+        });
     };
 
     hs.mouseUpHandler = [this](float x, float y, MouseButton button, Modifiers modifiers){
-        simd_float2 testPoint{0.0f, 0.0f};
-        auto* htnode = this->hitTest(x, y, testPoint);
-        if (!htnode) {
-            this->mouseDownTarget = nullptr;
-            return;
-        }
+        auto testPoint = this->viewPoint(x, y);
+        this->post([this, testPoint, button, modifiers](tree::RenderTree& tree) {
+            auto* htnode = this->hitTest(tree, testPoint);
+            if (!htnode) {
+                this->mouseDownTarget = nullptr;
+                return;
+            }
 
-        MousePayload payload{
-            .position = testPoint,
-            .button = button,
-            .modifiers = modifiers
-        };
+            MousePayload payload{
+                .position = testPoint,
+                .button = button,
+                .modifiers = modifiers
+            };
 
-        Event e;
-        e.type = EventType::MouseUp;
-        e.payload = payload;
+            Event e;
+            e.type = EventType::MouseUp;
+            e.payload = payload;
 
-        if (this->inspector) {
-            this->inspector->observe(e);
-        }
+            if (this->inspector) {
+                this->inspector->observe(e);
+            }
 
-        htnode->dispatch(e);
+            htnode->dispatch(e);
 
-        if (this->mouseDownTarget == htnode) {
-            Event click;
-            click.type = EventType::Click;
-            click.payload = payload;
-            if (this->inspector) {
-                this->inspector->observe(click);
+            if (this->mouseDownTarget == htnode) {
+                Event click;
+                click.type = EventType::Click;
+                click.payload = payload;
+                if (this->inspector) {
+                    this->inspector->observe(click);
+                }
+                htnode->dispatch(click);
             }
-            htnode->dispatch(click);
-        }
 
-        this->mouseDownTarget = nullptr;
+            this->mouseDownTarget = nullptr;
+        });
     };
 
     hs.mouseMovedHandler = [this](float x, float y, Modifiers modifiers){
-        simd_float2 testPoint{0.0f, 0.0f};
-        auto* htnode = this->hitTest(x, y, testPoint);
-
-        MousePayload payload{
-            .position = testPoint,
-            .button = MouseButton::None,
-            .modifiers = modifiers
-        };
-
-        if (this->hovered != htnode) {
-            if (this->hovered) {
-                Event leave;
-                leave.type = EventType::MouseLeave;
-                leave.payload = payload;
-                this->hovered->dispatch(leave);
+        auto testPoint = this->viewPoint(x, y);
+        this->post([this, testPoint, modifiers](tree::RenderTree& tree) {
+            auto* htnode = this->hitTest(tree, testPoint);
+
+            MousePayload payload{
+                .position = testPoint,
+                .button = MouseButton::None,
+                .modifiers = modifiers
+            };
+
+            if (this->hovered != htnode) {
+                if (this->hovered) {
+                    Event leave;
+                    leave.type = EventType::MouseLeave;
+                    leave.payload = payload;
+                    this->hovered->dispatch(leave);
+                }
+
+                this->hovered = htnode;
+
+                if (this->hovered) {
+                    Event enter;
+                    enter.type = EventType::MouseEnter;
+                    enter.payload = payload;
+                    this->hovered->dispatch(enter);
+                }
             }
 
-            this->hovered = htnode;
-
             if (this->hovered) {
-                Event enter;
-                enter.type = EventType::MouseEnter;
-                enter.payload = payload;
-                this->hovered->dispatch(enter);
+                Event move;
+                move.type = EventType::MouseMove;
+                move.payload = payload;
+                if (this->inspector) {
+                    this->inspector->observe(move);
+                }
+                this->hovered->dispatch(move);
             }
-        }
-
-        if (this->hovered) {
-            Event move;
-            move.type = EventType::MouseMove;
-            move.payload = payload;
-            if (this->inspector) {
-                this->inspector->observe(move);
-            }
-            this->hovered->dispatch(move);
-        }
+        });
     };
 
     hs.scrollWheelHandler = [this](float dx, float dy, float x, float y, Modifiers modifiers) {
-        simd_float2 testPoint{0.0f, 0.0f};
-        auto* scrollNode = this->hitTest(x, y, testPoint);
-
-        auto& currTree = this->viewDelegate->renderer->rootTree;
-        auto* root = currTree.getRoot();
-        if (!root) return;
-
-        if (!scrollNode) {
-            scrollNode = root;
-        }
+        auto testPoint = this->viewPoint(x, y);
+        this->post([this, testPoint, dx, dy, modifiers](tree::RenderTree& tree) {
+            auto* root = tree.getRoot();
+            if (!root) return;
+
+            auto* scrollNode = this->hitTest(tree, testPoint);
+            if (!scrollNode) {
+                scrollNode = root;
+            }
 
-        Event e;
-        e.type = EventType::ScrollWheel;
-        e.payload = ScrollPayload{
-            .position = testPoint,
-            .dx = dx,
-            .dy = dy,
-            .modifiers = modifiers
-        };
+            Event e;
+            e.type = EventType::ScrollWheel;
+            e.payload = ScrollPayload{
+                .position = testPoint,
+                .dx = dx,
+                .dy = dy,
+                .modifiers = modifiers
+            };
 
-        if (this->inspector) {
-            this->inspector->observe(e);
-        }
+            if (this->inspector) {
+                this->inspector->observe(e);
+            }
 
-        if (auto* dirtyScrollNode = scrollNode->dispatch(e)) {
-            currTree.markDirty(dirtyScrollNode,
-                DirtyBits::PostLayout | DirtyBits::Place | DirtyBits::Finalize);
-        }
+            if (auto* scrolledNode = scrollNode->dispatch(e)) {
+                tree.markScrolled(scrolledNode);
+            }
+        });
     };
 
     class_addMethod(cls, sel_registerName("acceptsFirstResponder"),
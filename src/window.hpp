@@ -56,11 +56,16 @@ public:
     void applicationDidFinishLaunching(NS::Notification* notification) override;
     bool applicationShouldTerminateAfterLastWindowClosed(NS::Application* sender) override;
     void setFocused(tree::TreeNode* node);
-    tree::TreeNode* hitTest(float x, float y, simd_float2& testPoint);
+    simd_float2 viewPoint(float x, float y);
+    tree::TreeNode* hitTest(tree::RenderTree& tree, simd_float2 testPoint);
+    // event handling runs here, on the layout thread, in event order
+    void post(tree::LayoutThread::Mutation mutation);
     
     NS::Window* window;
     MTK::View* view;
     MTL::Device* device;
+    std::unique_ptr<gpu::MetalDevice> gpuDevice;
+    // touched only from posted mutations once the app has launched
     tree::TreeNode* focused = nullptr;
     tree::TreeNode* hovered = nullptr;
     tree::TreeNode* mouseDownTarget = nullptr;